@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+// Just enough test support for the unit tests: CHECK reports a failed condition and counts it, and each test
+// executable's main returns the count, which ctest turns into pass/fail.
+
+inline int& CheckFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			fprintf(stderr, "%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			CheckFailures()++; \
+		} \
+	} while (0)
+
+// Seed for the randomized tests, from TEST_SEED to replay a failure, else a fixed one so runs are reproducible
+inline unsigned int TestSeed()
+{
+	auto text = getenv("TEST_SEED");
+	auto seed = text ? (unsigned int)strtoul(text, nullptr, 10) : 20240601u;
+	printf("TEST_SEED=%u\n", seed);
+	return seed;
+}
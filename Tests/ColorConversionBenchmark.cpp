@@ -0,0 +1,86 @@
+#include "ColorConversionLevels.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Times the RGB32 conversions at each kernel level and common frame sizes, on the calling thread only and then in
+// bands on the slice pool. Not a test, run it by hand: ColorConversionBenchmark [milliseconds per measurement]
+
+struct Size
+{
+	UINT width;
+	UINT height;
+};
+
+static double Measure(ConvertFn convert, const std::vector<BYTE>& input, Size size, std::vector<BYTE>& output, LONG outputStride, int milliseconds)
+{
+	// best of several runs of as many conversions as fit the time, the minimum is what the code can do
+	using clock = std::chrono::steady_clock;
+	double best = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		int count = 0;
+		const auto start = clock::now();
+		auto elapsed = clock::duration::zero();
+		do
+		{
+			convert(input.data(), (ULONG)input.size(), size.width * 4, size.width, size.height, output.data(), (ULONG)output.size(), outputStride, YuvMatrix::BT709, YuvRange::Limited);
+			count++;
+			elapsed = clock::now() - start;
+		} while (elapsed < std::chrono::milliseconds(milliseconds) / 5);
+		best = std::min(best, std::chrono::duration<double, std::milli>(elapsed).count() / count);
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	const int milliseconds = argc > 1 ? atoi(argv[1]) : 500;
+	const Size sizes[] = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+	std::mt19937 rng(1);
+
+	for (auto banded : { false, true })
+	{
+		if (banded)
+		{
+			SlicePool::Instance().Acquire();
+			printf("\nin bands on %u slice pool workers and the calling thread\n", SlicePool::Instance().WorkerCount());
+		}
+		else
+		{
+			printf("on the calling thread\n");
+		}
+		printf("%-6s %-7s %10s %10s %10s %10s\n", "format", "level", "640x480", "1280x720", "1920x1080", "3840x2160");
+
+		for (const auto& format : { "NV12", "YUY2", "I420" })
+		{
+			for (const auto& level : ConversionLevels)
+			{
+				if (!level.supported)
+					continue;
+
+				auto convert = !strcmp(format, "NV12") ? level.nv12 : !strcmp(format, "YUY2") ? level.yuy2 : level.i420;
+				printf("%-6s %-7s", format, level.name);
+				for (auto size : sizes)
+				{
+					std::vector<BYTE> input((size_t)size.width * size.height * 4);
+					for (auto& b : input)
+					{
+						b = (BYTE)rng();
+					}
+
+					const LONG stride = !strcmp(format, "YUY2") ? size.width * 2 : size.width;
+					std::vector<BYTE> output((size_t)size.width * size.height * 2);
+					printf(" %8.3fms", Measure(convert, input, size, output, stride, milliseconds));
+				}
+				printf("\n");
+			}
+		}
+
+		if (banded)
+		{
+			SlicePool::Instance().Release();
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// ColorConversion.cpp compiled three more times, each in a namespace whose CpuFeatures only reports the
+// instruction sets of one kernel level, so the scalar, SSE4.1 and AVX2 code can run side by side in one process.
+// Everything the .cpp includes is included first: its own includes are then no-ops inside the namespaces.
+#include "pch.h"
+#include "ColorConversion.h"
+#include "SlicePool.h"
+#include "CpuFeatures.h"
+#include <cmath>
+#if defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace ScalarLevel
+{
+	struct CpuFeatures
+	{
+		bool sse2 = false;
+		bool sse41 = false;
+		bool avx2 = false;
+
+		static const CpuFeatures& Get()
+		{
+			static const CpuFeatures features;
+			return features;
+		}
+	};
+#include "ColorConversion.cpp"
+}
+
+namespace Sse41Level
+{
+	struct CpuFeatures
+	{
+		bool sse2 = ::CpuFeatures::Get().sse2;
+		bool sse41 = ::CpuFeatures::Get().sse41;
+		bool avx2 = false;
+
+		static const CpuFeatures& Get()
+		{
+			static const CpuFeatures features;
+			return features;
+		}
+	};
+#include "ColorConversion.cpp"
+}
+
+namespace Avx2Level
+{
+	using ::CpuFeatures;
+#include "ColorConversion.cpp"
+}
+
+typedef HRESULT(*ConvertFn)(const BYTE* input, ULONG inputSize, LONG inputStride, UINT width, UINT height, BYTE* output, ULONG outputSize, LONG outputStride, YuvMatrix matrix, YuvRange range);
+
+struct ConversionLevel
+{
+	const char* name;       // "scalar", "SSE4.1", "AVX2"
+	bool supported;         // by this CPU, the level is only run when it is
+	const char* (*kernel)();
+	ConvertFn nv12;
+	ConvertFn yuy2;
+	ConvertFn i420;
+};
+
+inline const ConversionLevel ConversionLevels[] =
+{
+	{ "scalar", true, ScalarLevel::RGB32ToNV12Kernel, ScalarLevel::RGB32ToNV12, ScalarLevel::RGB32ToYUY2, ScalarLevel::RGB32ToI420 },
+	{ "SSE4.1", CpuFeatures::Get().sse41, Sse41Level::RGB32ToNV12Kernel, Sse41Level::RGB32ToNV12, Sse41Level::RGB32ToYUY2, Sse41Level::RGB32ToI420 },
+	{ "AVX2", CpuFeatures::Get().avx2, Avx2Level::RGB32ToNV12Kernel, Avx2Level::RGB32ToNV12, Avx2Level::RGB32ToYUY2, Avx2Level::RGB32ToI420 },
+};
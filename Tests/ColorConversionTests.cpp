@@ -0,0 +1,289 @@
+#include "ColorConversionLevels.h"
+#include "Check.h"
+
+// Golden tests for the RGB32 to NV12, YUY2 and I420 conversions: every kernel level must produce exactly what the
+// scalar code does, for each matrix and range and for odd widths and heights, and the scalar code must be within
+// half a step of a floating point reference (plus what rounding the coefficients to 14 bits adds).
+
+static const double Tolerance = 0.5 + 0.04;
+static double _maxError = 0;
+
+struct Format
+{
+	const char* name;
+	ConvertFn ConversionLevel::*convert;
+	UINT rowBytesPerPixel; // Y plane or packed row
+};
+
+static const Format Formats[] =
+{
+	{ "NV12", &ConversionLevel::nv12, 1 },
+	{ "YUY2", &ConversionLevel::yuy2, 2 },
+	{ "I420", &ConversionLevel::i420, 1 },
+};
+
+struct Image
+{
+	UINT width;
+	UINT height;
+	LONG stride;
+	std::vector<BYTE> pixels;
+};
+
+static Image MakeImage(std::mt19937& rng, UINT width, UINT height, bool extremes)
+{
+	Image image{ width, height, (LONG)(width * 4 + (rng() % 3) * 4), {} };
+	image.pixels.resize((size_t)image.stride * height);
+	for (auto& b : image.pixels)
+	{
+		// saturated colors are where clamping and coefficient rounding show
+		b = extremes ? ((rng() & 1) ? 255 : 0) : (BYTE)rng();
+	}
+	return image;
+}
+
+static LONG OutputStride(const Format& format, UINT width, UINT padding)
+{
+	return (LONG)(((width + 1) & ~1) * format.rowBytesPerPixel + padding);
+}
+
+static size_t OutputSize(const Format& format, UINT height, LONG stride)
+{
+	if (format.rowBytesPerPixel == 2)
+		return (size_t)stride * height;
+
+	// NV12 chroma rows use the luma stride, I420 U and V rows half of it
+	const size_t chromaRows = (height + 1) / 2;
+	if (!strcmp(format.name, "NV12"))
+		return (size_t)stride * (height + chromaRows);
+
+	return (size_t)stride * height + (size_t)(stride / 2) * chromaRows * 2;
+}
+
+struct Yuv
+{
+	double y, u, v;
+};
+
+static Yuv Reference(double b, double g, double r, YuvMatrix matrix, YuvRange range)
+{
+	const double kr = matrix == YuvMatrix::BT709 ? 0.2126 : 0.299;
+	const double kb = matrix == YuvMatrix::BT709 ? 0.0722 : 0.114;
+	const bool full = range == YuvRange::Full;
+	const double luma = kr * r + (1 - kr - kb) * g + kb * b;
+	const double ys = full ? 1 : 219.0 / 255;
+	const double cs = full ? 1 : 224.0 / 255;
+	auto clamp = [](double value) { return std::clamp(value, 0.0, 255.0); };
+	return { clamp((full ? 0 : 16) + ys * luma), clamp(128 + cs * (b - luma) / (2 * (1 - kb))), clamp(128 + cs * (r - luma) / (2 * (1 - kr))) };
+}
+
+static void CheckValue(BYTE value, double reference)
+{
+	auto error = fabs(value - reference);
+	_maxError = std::max(_maxError, error);
+	CHECK(error <= Tolerance);
+}
+
+// Average of the 2x2 block (YUY2: the pair) at x, y; pixels past an odd edge repeat the last column or row
+static Yuv BlockReference(const Image& image, UINT x, UINT y, UINT rows, YuvMatrix matrix, YuvRange range)
+{
+	double b = 0, g = 0, r = 0;
+	for (UINT dy = 0; dy < 2; dy++)
+	{
+		for (UINT dx = 0; dx < 2; dx++)
+		{
+			auto row = rows == 2 && y + dy < image.height ? y + dy : y;
+			auto p = &image.pixels[(size_t)row * image.stride + (x + dx < image.width ? x + dx : x) * 4];
+			b += p[0];
+			g += p[1];
+			r += p[2];
+		}
+	}
+	return Reference(b / 4, g / 4, r / 4, matrix, range);
+}
+
+static void CheckAgainstReference(const Format& format, const Image& image, const std::vector<BYTE>& out, LONG stride, YuvMatrix matrix, YuvRange range)
+{
+	const auto w = image.width;
+	const auto h = image.height;
+	for (UINT y = 0; y < h; y++)
+	{
+		for (UINT x = 0; x < w; x++)
+		{
+			auto p = &image.pixels[(size_t)y * image.stride + x * 4];
+			auto luma = format.rowBytesPerPixel == 2 ? out[(size_t)y * stride + x * 2] : out[(size_t)y * stride + x];
+			CheckValue(luma, Reference(p[0], p[1], p[2], matrix, range).y);
+		}
+	}
+
+	const auto planes = out.data() + (size_t)h * stride;
+	for (UINT y = 0; y < h; y += format.rowBytesPerPixel == 2 ? 1 : 2)
+	{
+		for (UINT x = 0; x < w; x += 2)
+		{
+			if (format.rowBytesPerPixel == 2)
+			{
+				auto yuy2 = &out[(size_t)y * stride + x * 2];
+				auto reference = BlockReference(image, x, y, 1, matrix, range);
+				CheckValue(yuy2[1], reference.u);
+				CheckValue(yuy2[3], reference.v);
+				continue;
+			}
+
+			BYTE u, v;
+			if (!strcmp(format.name, "NV12"))
+			{
+				u = planes[(size_t)(y / 2) * stride + x];
+				v = planes[(size_t)(y / 2) * stride + x + 1];
+			}
+			else
+			{
+				const auto chromaStride = stride / 2;
+				u = planes[(size_t)(y / 2) * chromaStride + x / 2];
+				v = planes[(size_t)(y / 2) * chromaStride + x / 2 + (size_t)chromaStride * ((h + 1) / 2)];
+			}
+			auto reference = BlockReference(image, x, y, 2, matrix, range);
+			CheckValue(u, reference.u);
+			CheckValue(v, reference.v);
+		}
+	}
+}
+
+// Bytes of the output no conversion may write: row padding past the (even) width
+static void CheckPadding(const Format& format, const std::vector<BYTE>& out, UINT width, UINT height, LONG stride)
+{
+	auto check = [&](size_t offset, size_t rows, size_t used, size_t pitch)
+	{
+		for (size_t y = 0; y < rows; y++)
+		{
+			for (auto x = used; x < pitch; x++)
+			{
+				CHECK(out[offset + y * pitch + x] == 0xCD);
+			}
+		}
+	};
+
+	const size_t evenWidth = (width + 1) & ~1;
+	const size_t chromaRows = (height + 1) / 2;
+	check(0, height, evenWidth * format.rowBytesPerPixel, stride);
+	if (!strcmp(format.name, "NV12"))
+	{
+		check((size_t)height * stride, chromaRows, evenWidth, stride);
+	}
+	else if (!strcmp(format.name, "I420"))
+	{
+		check((size_t)height * stride, chromaRows * 2, evenWidth / 2, stride / 2);
+	}
+}
+
+static void CheckConversion(std::mt19937& rng, UINT width, UINT height, bool extremes)
+{
+	const auto image = MakeImage(rng, width, height, extremes);
+	for (const auto& format : Formats)
+	{
+		const auto stride = OutputStride(format, width, rng() % 5);
+		const auto size = OutputSize(format, height, stride);
+		for (auto matrix : { YuvMatrix::BT601, YuvMatrix::BT709 })
+		{
+			for (auto range : { YuvRange::Limited, YuvRange::Full })
+			{
+				std::vector<BYTE> golden(size, 0xCD);
+				CHECK(SUCCEEDED((ConversionLevels[0].*format.convert)(image.pixels.data(), (ULONG)image.pixels.size(), image.stride, width, height, golden.data(), (ULONG)size, stride, matrix, range)));
+				CheckAgainstReference(format, image, golden, stride, matrix, range);
+				CheckPadding(format, golden, width, height, stride);
+
+				for (const auto& level : ConversionLevels)
+				{
+					if (!level.supported)
+						continue;
+
+					std::vector<BYTE> out(size, 0xCD);
+					CHECK(SUCCEEDED((level.*format.convert)(image.pixels.data(), (ULONG)image.pixels.size(), image.stride, width, height, out.data(), (ULONG)size, stride, matrix, range)));
+					auto same = out == golden;
+					if (!same)
+					{
+						fprintf(stderr, "%s %s %ux%u matrix %d range %d differs from scalar\n", format.name, level.name, width, height, (int)matrix, (int)range);
+					}
+					CHECK(same);
+				}
+			}
+		}
+	}
+}
+
+static void TestSizes(std::mt19937& rng)
+{
+	// around the vector widths (4, 8, 16, 32 pixels) and the I420 chroma chunk (256)
+	for (UINT width : { 1u, 2u, 3u, 4u, 5u, 7u, 8u, 9u, 15u, 16u, 17u, 31u, 32u, 33u, 63u, 64u, 65u, 127u, 255u, 256u, 257u, 258u, 517u })
+	{
+		for (UINT height : { 1u, 2u, 3u, 4u, 7u })
+		{
+			CheckConversion(rng, width, height, false);
+			CheckConversion(rng, width, height, true);
+		}
+	}
+}
+
+static void TestBands(std::mt19937& rng)
+{
+	// large enough for the slice pool to convert in bands on several threads
+	SlicePool::Instance().Acquire();
+	CheckConversion(rng, 641, 363, false);
+	CheckConversion(rng, 1920, 1081, false);
+	SlicePool::Instance().Release();
+}
+
+static void TestNeutral()
+{
+	// grays have neutral chroma and black and white hit the ends of the range exactly, whatever the matrix
+	std::vector<BYTE> gray(256 * 4);
+	for (UINT i = 0; i < 256; i++)
+	{
+		gray[i * 4] = gray[i * 4 + 1] = gray[i * 4 + 2] = (BYTE)i;
+	}
+
+	for (auto matrix : { YuvMatrix::BT601, YuvMatrix::BT709 })
+	{
+		for (auto range : { YuvRange::Limited, YuvRange::Full })
+		{
+			std::vector<BYTE> out(256 * 2);
+			CHECK(SUCCEEDED(RGB32ToYUY2(gray.data(), (ULONG)gray.size(), 256 * 4, 256, 1, out.data(), (ULONG)out.size(), 256 * 2, matrix, range)));
+			CHECK(out[0] == (range == YuvRange::Full ? 0 : 16));
+			CHECK(out[255 * 2] == (range == YuvRange::Full ? 255 : 235));
+			for (UINT i = 0; i < 256; i += 2)
+			{
+				CHECK(out[i * 2 + 1] == 128 && out[i * 2 + 3] == 128);
+			}
+		}
+	}
+}
+
+static void TestArguments()
+{
+	std::vector<BYTE> in(64 * 4), out(64 * 2);
+	CHECK(RGB32ToNV12(nullptr, 0, 64, 16, 1, out.data(), (ULONG)out.size(), 16) == E_INVALIDARG);
+	CHECK(RGB32ToNV12(in.data(), (ULONG)in.size(), 60, 16, 1, out.data(), (ULONG)out.size(), 16) == E_INVALIDARG);
+	CHECK(RGB32ToNV12(in.data(), (ULONG)in.size(), 64, 16, 8, out.data(), (ULONG)out.size(), 16) == E_UNEXPECTED);
+	CHECK(RGB32ToYUY2(in.data(), (ULONG)in.size(), 64, 16, 1, out.data(), (ULONG)out.size(), 31) == E_INVALIDARG);
+	CHECK(RGB32ToI420(in.data(), (ULONG)in.size(), 64, 16, 4, out.data(), 16 * 4, 16) == E_UNEXPECTED);
+	CHECK(RGB32ToI420(in.data(), (ULONG)in.size(), 64, 0, 4, out.data(), 0, 16) == S_OK);
+}
+
+int main()
+{
+	printf("kernel: %s\n", RGB32ToNV12Kernel());
+	for (const auto& level : ConversionLevels)
+	{
+		printf("%s: %s\n", level.name, level.supported ? level.kernel() : "not supported by this CPU");
+		CHECK(!level.supported || !strcmp(level.kernel(), level.name));
+	}
+
+	std::mt19937 rng(TestSeed());
+	TestSizes(rng);
+	TestBands(rng);
+	TestNeutral();
+	TestArguments();
+	printf("largest difference from the reference: %.3f\n", _maxError);
+	printf("%d failure(s)\n", CheckFailures());
+	return CheckFailures() ? 1 : 0;
+}
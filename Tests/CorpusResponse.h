@@ -0,0 +1,104 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Camera server responses as stored in Corpus/Splitter: status line, headers, empty line, body, as they come off
+// the wire. A chunked body (Transfer-Encoding: chunked) is decoded the way WinHTTP does, keeping the chunks apart
+// since they are separate reads. An X-Test-Frames header gives the number of frames expected.
+
+struct Response
+{
+	std::string contentType;
+	std::vector<std::vector<BYTE>> chunks; // as the server sent them
+	int expectedFrames = -1;
+};
+
+inline std::string HeaderValue(const std::string& headers, const char* name)
+{
+	const auto len = strlen(name);
+	for (size_t pos = 0; pos < headers.size();)
+	{
+		auto eol = headers.find('\n', pos);
+		if (eol == std::string::npos)
+		{
+			eol = headers.size();
+		}
+
+		if (eol - pos > len && !_strnicmp(headers.c_str() + pos, name, len) && headers[pos + len] == ':')
+		{
+			auto value = headers.substr(pos + len + 1, eol - pos - len - 1);
+			value.erase(0, value.find_first_not_of(" \t"));
+			value.erase(value.find_last_not_of(" \t\r") + 1);
+			return value;
+		}
+		pos = eol + 1;
+	}
+	return std::string();
+}
+
+// false if the response doesn't parse, which only happens to fuzzed ones
+inline bool ParseResponse(const BYTE* data, size_t size, Response* response)
+{
+	const std::string text((const char*)data, size);
+	auto headersEnd = text.find("\r\n\r\n");
+	if (headersEnd == std::string::npos)
+		return false;
+
+	const auto headers = text.substr(0, headersEnd + 2);
+	response->contentType = HeaderValue(headers, "Content-Type");
+	auto frames = HeaderValue(headers, "X-Test-Frames");
+	response->expectedFrames = frames.empty() ? -1 : atoi(frames.c_str());
+
+	auto pos = headersEnd + 4;
+	if (_strnicmp(HeaderValue(headers, "Transfer-Encoding").c_str(), "chunked", 7))
+	{
+		response->chunks.emplace_back(data + pos, data + size);
+		return true;
+	}
+
+	// chunk-size [; extensions] CRLF data CRLF ... 0 CRLF [trailers] CRLF
+	while (true)
+	{
+		auto eol = text.find("\r\n", pos);
+		if (eol == std::string::npos)
+			return false;
+
+		char* end;
+		auto chunkSize = strtoull(text.c_str() + pos, &end, 16);
+		if (end == text.c_str() + pos || chunkSize > size - eol - 2)
+			return false;
+
+		if (!chunkSize)
+			return true;
+
+		pos = eol + 2;
+		response->chunks.emplace_back(data + pos, data + pos + chunkSize);
+		pos += chunkSize + 2;
+		if (pos > size)
+			return false;
+	}
+}
+
+inline std::vector<BYTE> ReadFileBytes(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<BYTE>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+// The .http (or other extension's) files of a corpus directory, sorted
+inline std::vector<std::filesystem::path> CorpusFiles(const char* directory, const char* extension = ".http")
+{
+	std::vector<std::filesystem::path> paths;
+	for (const auto& entry : std::filesystem::directory_iterator(directory))
+	{
+		if (entry.path().extension() == extension)
+		{
+			paths.push_back(entry.path());
+		}
+	}
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
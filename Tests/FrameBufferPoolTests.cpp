@@ -0,0 +1,213 @@
+#include "pch.h"
+#include "FrameBufferPool.h"
+#include "Check.h"
+#include <cstdint>
+#include <cstring>
+
+// FrameBufferPool: alignment, size classes and their free lists, handle refcounts, the free cap and Trim. The
+// pool is process-wide, so each test starts from an empty one and checks the stats as differences
+
+static FrameBufferPool& EmptyPool()
+{
+	auto& pool = FrameBufferPool::Instance();
+	pool.Trim();
+	return pool;
+}
+
+static void TestAlignment()
+{
+	auto& pool = EmptyPool();
+	for (size_t size : { (size_t)1, (size_t)63, (size_t)65, (size_t)4097, (size_t)100000, (size_t)1920 * 1080 * 4 + 3 })
+	{
+		auto buffer = pool.Get(size);
+		CHECK(buffer.Size() == size);
+		CHECK(!((uintptr_t)buffer.Data() % FrameBufferPool::Alignment));
+		memset(buffer.Data(), 0xA5, size); // all of it is there
+	}
+	CHECK(pool.Get(0).Empty() && !pool.Get(0).Data());
+}
+
+static void TestSizeClasses()
+{
+	// 100000 bytes is between 2^16 and 2^17, where the classes are 2^16 / 8 = 8192 apart: it gets 106496
+	auto& pool = EmptyPool();
+	auto before = pool.GetStats();
+	BYTE* data = nullptr;
+	{
+		auto buffer = pool.Get(100000);
+		data = buffer.Data();
+	}
+	auto stats = pool.GetStats();
+	CHECK(stats.misses == before.misses + 1);
+	CHECK(stats.freeBytes == 106496);
+	CHECK(stats.residentBytes == 106496);
+
+	// any size of the same class reuses it, the next class up doesn't
+	{
+		auto buffer = pool.Get(106496);
+		CHECK(buffer.Data() == data);
+		auto other = pool.Get(106497);
+		CHECK(other.Data() != data);
+	}
+	stats = pool.GetStats();
+	CHECK(stats.hits == before.hits + 1);
+	CHECK(stats.misses == before.misses + 2);
+	CHECK(stats.freeBytes == 106496 + 114688);
+
+	// everything up to MinSize is one class
+	{
+		auto small = pool.Get(1);
+		data = small.Data();
+	}
+	{
+		auto buffer = pool.Get(FrameBufferPool::MinSize);
+		CHECK(buffer.Data() == data);
+	}
+	CHECK(pool.GetStats().hits == before.hits + 2);
+
+	pool.Trim();
+}
+
+static void TestClassOverhead()
+{
+	// what a size costs shows in residentBytes: never more than 12.5% over the request
+	auto& pool = EmptyPool();
+	for (size_t size = FrameBufferPool::MinSize + 1; size < 64 * 1024 * 1024; size = size * 5 / 3 + 7)
+	{
+		auto before = pool.GetStats().residentBytes;
+		auto buffer = pool.Get(size);
+		auto capacity = pool.GetStats().residentBytes - before;
+		CHECK(capacity >= size && capacity <= size + size / 8);
+		CHECK(!(capacity % FrameBufferPool::Alignment));
+		buffer.Reset();
+		pool.Trim();
+	}
+}
+
+static void TestRefcounts()
+{
+	// copies share the memory, which goes back to the pool when the last one lets go
+	auto& pool = EmptyPool();
+	auto first = pool.Get(200000);
+	auto second = first;
+	FrameBuffer third;
+	third = second;
+	CHECK(second.Data() == first.Data() && third.Data() == first.Data());
+
+	first.Reset();
+	second = FrameBuffer();
+	CHECK(pool.GetStats().freeBytes == 0);
+
+	auto moved = std::move(third);
+	CHECK(third.Empty() && !third.Data());
+	CHECK(pool.GetStats().freeBytes == 0);
+
+	auto& alias = moved;
+	moved = alias; // self assignment keeps the reference
+	CHECK(pool.GetStats().freeBytes == 0);
+	moved.Reset();
+	CHECK(pool.GetStats().freeBytes == 212992);
+	pool.Trim();
+}
+
+static void TestResize()
+{
+	auto& pool = EmptyPool();
+	auto buffer = pool.Get(100000);
+	auto data = buffer.Data();
+	memset(data, 0x5A, buffer.Size());
+
+	// within the capacity and not shared: same memory, same contents
+	CHECK(buffer.Resize(106496));
+	CHECK(buffer.Data() == data && buffer.Size() == 106496);
+	CHECK(data[99999] == 0x5A);
+	CHECK(buffer.Resize(10));
+	CHECK(buffer.Data() == data && data[9] == 0x5A);
+
+	// shared: the handle moves to other memory, the other handle keeps its contents
+	auto shared = buffer;
+	CHECK(buffer.Resize(20));
+	CHECK(buffer.Data() != data && buffer.Size() == 20);
+	CHECK(shared.Data() == data && shared.Size() == 10 && data[9] == 0x5A);
+
+	// too large: other memory
+	CHECK(shared.Resize(106497));
+	CHECK(shared.Data() != data && shared.Size() == 106497);
+
+	CHECK(shared.Resize(0));
+	CHECK(shared.Empty());
+	buffer.Reset();
+	shared.Reset();
+	pool.Trim();
+}
+
+static void TestFreeCap()
+{
+	// released buffers beyond MaxFreeBytes are freed right away
+	auto& pool = EmptyPool();
+	constexpr size_t size = 64 * 1024 * 1024;
+	constexpr size_t count = FrameBufferPool::MaxFreeBytes / size + 2;
+	std::vector<FrameBuffer> buffers;
+	for (size_t i = 0; i < count; i++)
+	{
+		buffers.push_back(pool.Get(size));
+		CHECK(!buffers.back().Empty());
+	}
+	auto stats = pool.GetStats();
+	CHECK(stats.residentBytes == count * size);
+	CHECK(stats.peakResidentBytes >= count * size);
+
+	buffers.clear();
+	stats = pool.GetStats();
+	CHECK(stats.freeBytes == FrameBufferPool::MaxFreeBytes);
+	CHECK(stats.residentBytes == FrameBufferPool::MaxFreeBytes);
+	CHECK(stats.peakResidentBytes >= count * size);
+
+	// Trim frees the rest; the peak stays
+	pool.Trim();
+	stats = pool.GetStats();
+	CHECK(stats.freeBytes == 0 && stats.residentBytes == 0);
+	CHECK(stats.peakResidentBytes >= count * size);
+
+	// and what comes next is allocated again
+	auto misses = stats.misses;
+	auto buffer = pool.Get(size);
+	CHECK(pool.GetStats().misses == misses + 1);
+	buffer.Reset();
+	pool.Trim();
+}
+
+static void TestTrimKeepsBuffersInUse()
+{
+	auto& pool = EmptyPool();
+	auto used = pool.Get(300000);
+	pool.Get(300000); // released right away
+	memset(used.Data(), 1, used.Size());
+	auto stats = pool.GetStats();
+	CHECK(stats.residentBytes == 2 * 327680 && stats.freeBytes == 327680);
+
+	pool.Trim();
+	stats = pool.GetStats();
+	CHECK(stats.residentBytes == 327680 && stats.freeBytes == 0);
+	CHECK(used.Data()[used.Size() - 1] == 1);
+
+	// a buffer released after a Trim goes to the free list as usual
+	used.Reset();
+	CHECK(pool.GetStats().freeBytes == 327680);
+	pool.Trim();
+	CHECK(pool.GetStats().residentBytes == 0);
+}
+
+int main()
+{
+	TestAlignment();
+	TestSizeClasses();
+	TestClassOverhead();
+	TestRefcounts();
+	TestResize();
+	TestFreeCap();
+	TestTrimKeepsBuffersInUse();
+
+	printf("%d failure(s)\n", CheckFailures());
+	return CheckFailures() ? 1 : 0;
+}
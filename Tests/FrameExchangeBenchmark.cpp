@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "FrameExchange.h"
+#include <thread>
+
+// Latency of handing 1080p BGRA frames from a decoder thread to a consumer: FrameExchange against what it replaced,
+// a frame written and copied out under one mutex. Reports, per frame, the time from publishing to the consumer
+// holding the frame, and how long the producer waited for the consumer. Not a test, run it by hand:
+// FrameExchangeBenchmark [frames]
+
+static const UINT Width = 1920;
+static const UINT Height = 1080;
+static const size_t FrameSize = (size_t)Width * Height * 4;
+static const auto FrameInterval = std::chrono::milliseconds(4);
+
+struct Samples
+{
+	std::vector<double> latency;  // µs
+	std::vector<double> stall;    // µs
+
+	static void Print(const char* name, std::vector<double>& values)
+	{
+		std::sort(values.begin(), values.end());
+		auto at = [&](double q) { return values.empty() ? 0 : values[std::min(values.size() - 1, (size_t)(q * values.size()))]; };
+		printf("  %-14s median %9.1f us   p99 %9.1f us   max %9.1f us\n", name, at(0.5), at(0.99), values.empty() ? 0 : values.back());
+	}
+
+	void Print(const char* title)
+	{
+		printf("%s, %zu frames seen\n", title, latency.size());
+		Print("publish->held", latency);
+		Print("producer wait", stall);
+	}
+};
+
+static double Microseconds(MFTIME from, MFTIME to)
+{
+	return (to - from) / 10.0;
+}
+
+static Samples RunExchange(int frames, const std::vector<BYTE>& decoded)
+{
+	FrameExchange exchange;
+	Samples samples;
+	std::atomic<bool> done{ false };
+	std::thread producer([&]()
+	{
+		for (int i = 0; i < frames; i++)
+		{
+			auto& back = exchange.Back();
+			back.data.Resize(FrameSize);
+			memcpy(back.data.Data(), decoded.data(), FrameSize); // the decoder writing its output
+			auto start = MFGetSystemTime();
+			exchange.Publish();
+			samples.stall.push_back(Microseconds(start, MFGetSystemTime()));
+			std::this_thread::sleep_for(FrameInterval);
+		}
+		done = true;
+	});
+
+	ULONGLONG last = 0;
+	while (!done)
+	{
+		auto& frame = exchange.Latest();
+		if (frame.sequence != last)
+		{
+			last = frame.sequence;
+			samples.latency.push_back(Microseconds(frame.published, MFGetSystemTime()));
+		}
+		std::this_thread::yield();
+	}
+	producer.join();
+	return samples;
+}
+
+static Samples RunMutex(int frames, const std::vector<BYTE>& decoded)
+{
+	std::mutex lock;
+	std::vector<BYTE> shared(FrameSize), local(FrameSize);
+	ULONGLONG sequence = 0;
+	MFTIME published = 0;
+	Samples samples;
+	std::atomic<bool> done{ false };
+	std::thread producer([&]()
+	{
+		for (int i = 0; i < frames; i++)
+		{
+			auto start = MFGetSystemTime();
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				samples.stall.push_back(Microseconds(start, MFGetSystemTime()));
+				memcpy(shared.data(), decoded.data(), FrameSize); // the decoder writing under the lock
+				sequence++;
+				published = MFGetSystemTime();
+			}
+			std::this_thread::sleep_for(FrameInterval);
+		}
+		done = true;
+	});
+
+	ULONGLONG last = 0;
+	while (!done)
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (sequence != last)
+			{
+				memcpy(local.data(), shared.data(), FrameSize); // the consumer's copy
+				last = sequence;
+				samples.latency.push_back(Microseconds(published, MFGetSystemTime()));
+			}
+		}
+		std::this_thread::yield();
+	}
+	producer.join();
+	return samples;
+}
+
+int main(int argc, char** argv)
+{
+	const int frames = argc > 1 ? atoi(argv[1]) : 500;
+	std::vector<BYTE> decoded(FrameSize);
+	for (size_t i = 0; i < FrameSize; i++)
+	{
+		decoded[i] = (BYTE)(i * 31);
+	}
+
+	printf("%d frames of %ux%u BGRA, one every %lld ms\n", frames, Width, Height, (long long)FrameInterval.count());
+	RunExchange(frames, decoded).Print("FrameExchange");
+	RunMutex(frames, decoded).Print("mutex and copy");
+	return 0;
+}
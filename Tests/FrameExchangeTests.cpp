@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "FrameExchange.h"
+#include "Check.h"
+#include <thread>
+
+// FrameExchange: the slot handoff rules on one thread, then a producer publishing as fast as it can against a
+// consumer checking that every frame it holds is whole (all of it written by the same Publish) and stays so until
+// it asks for the next one, and that frames never go back in time.
+
+// Fills a frame so that any byte written for another frame shows
+static void Fill(DecodedFrame& frame, ULONGLONG id, size_t size)
+{
+	CHECK(frame.data.Resize(size));
+	auto words = (ULONGLONG*)frame.data.Data();
+	for (size_t i = 0; i < size / sizeof(ULONGLONG); i++)
+	{
+		words[i] = id * 0x9E3779B97F4A7C15ull + i;
+	}
+	frame.width = (UINT)id;
+	frame.timing.index = id;
+}
+
+static bool IsWhole(const DecodedFrame& frame, ULONGLONG id)
+{
+	if (frame.width != (UINT)id || frame.timing.index != id)
+		return false;
+
+	auto words = (const ULONGLONG*)frame.data.Data();
+	for (size_t i = 0; i < frame.data.Size() / sizeof(ULONGLONG); i++)
+	{
+		if (words[i] != id * 0x9E3779B97F4A7C15ull + i)
+			return false;
+	}
+	return true;
+}
+
+static void TestHandoff()
+{
+	FrameExchange exchange;
+	CHECK(exchange.Latest().sequence == 0); // nothing published yet
+	CHECK(exchange.Latest().data.Empty());
+
+	Fill(exchange.Back(), 1, 4096);
+	auto first = &exchange.Back();
+	exchange.Publish();
+	CHECK(&exchange.Back() != first);
+
+	auto& latest = exchange.Latest();
+	CHECK(&latest == first && latest.sequence == 1 && IsWhole(latest, 1));
+	CHECK(&exchange.Latest() == first); // no newer frame, the same one again
+
+	// two frames before the consumer looks: the first is replaced, its slot goes back to the producer
+	Fill(exchange.Back(), 2, 4096);
+	exchange.Publish();
+	Fill(exchange.Back(), 3, 8192);
+	exchange.Publish();
+	auto& third = exchange.Latest();
+	CHECK(third.sequence == 3 && IsWhole(third, 3));
+	CHECK(exchange.GetStats().published == 3);
+	CHECK(exchange.GetStats().overwritten == 1);
+
+	// slots keep their buffers, so a producer at a fixed size stops allocating
+	auto back = exchange.Back().data.Data();
+	CHECK(back && exchange.Back().data.Resize(4096) && exchange.Back().data.Data() == back);
+}
+
+static void TestConcurrent(ULONGLONG count, std::mt19937& rng)
+{
+	FrameExchange exchange;
+	std::atomic<bool> done{ false };
+	const auto seed = rng();
+	std::thread producer([&]()
+	{
+		std::mt19937 sizes(seed);
+		for (ULONGLONG id = 1; id <= count; id++)
+		{
+			Fill(exchange.Back(), id, 64 + sizes() % (64 * 1024));
+			exchange.Publish();
+			if (sizes() % 4 == 0)
+			{
+				// on few cores, give the consumer a chance to take frames in between
+				std::this_thread::yield();
+			}
+		}
+		done = true;
+	});
+
+	ULONGLONG last = 0;
+	ULONGLONG taken = 0;
+	ULONGLONG torn = 0;
+	while (true)
+	{
+		// read done first: if it was set, the last frame is published and the next Latest takes it
+		const bool finished = done;
+		auto& frame = exchange.Latest();
+		CHECK(frame.sequence >= last);
+		if (frame.sequence != last)
+		{
+			taken++;
+			last = frame.sequence;
+			torn += !IsWhole(frame, frame.sequence);
+			std::this_thread::yield(); // let the producer run while we hold the frame...
+			torn += !IsWhole(frame, frame.sequence); // ...which it must not touch
+		}
+
+		if (finished && last == count)
+			break;
+
+		CHECK(!finished || exchange.GetStats().published == count);
+	}
+	producer.join();
+
+	auto stats = exchange.GetStats();
+	printf("%llu frames published, %llu taken, %llu replaced before being taken\n", (unsigned long long)stats.published, (unsigned long long)taken, (unsigned long long)stats.overwritten);
+	CHECK(torn == 0);
+	CHECK(stats.published == count);
+	CHECK(taken + stats.overwritten == count); // each frame was either taken or replaced
+}
+
+int main()
+{
+	std::mt19937 rng(TestSeed());
+	TestHandoff();
+	TestConcurrent(20000, rng);
+
+	// the pool keeps released buffers for the process lifetime, hand them back so leak checkers stay quiet
+	FrameBufferPool::Instance().Trim();
+	CHECK(FrameBufferPool::Instance().GetStats().residentBytes == 0);
+	printf("%d failure(s)\n", CheckFailures());
+	return CheckFailures() ? 1 : 0;
+}
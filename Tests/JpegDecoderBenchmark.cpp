@@ -0,0 +1,78 @@
+#include "pch.h"
+#include "JpegDecoder.h"
+#include "ColorConversion.h"
+#include "CorpusResponse.h"
+#include "LibJpegDecoder.h"
+#include <chrono>
+#include <cstdio>
+
+// Times the two ways FrameGenerator gets NV12 out of a JPEG, for each 4:2:0 JPEG of a corpus at full size and each
+// IDCT scale: decoding the JPEG's own planes (DecodeNV12), and decoding to BGRA then converting with RGB32ToNV12.
+// Not a test, run it by hand: JpegDecoderBenchmark Corpus/Jpeg [milliseconds per measurement]
+
+template<typename Fn>
+static double Measure(Fn decode, int milliseconds)
+{
+	// best of several runs of as many decodes as fit the time, the minimum is what the code can do
+	using clock = std::chrono::steady_clock;
+	double best = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		int count = 0;
+		const auto start = clock::now();
+		auto elapsed = clock::duration::zero();
+		do
+		{
+			decode();
+			count++;
+			elapsed = clock::now() - start;
+		} while (elapsed < std::chrono::milliseconds(milliseconds) / 5);
+		best = std::min(best, std::chrono::duration<double, std::milli>(elapsed).count() / count);
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: JpegDecoderBenchmark corpus-directory [milliseconds]\n");
+		return 2;
+	}
+	const int milliseconds = argc > 2 ? atoi(argv[2]) : 500;
+
+	LibJpegDecoder decoder;
+	printf("%-28s %5s %11s %10s %14s %7s\n", "file", "scale", "size", "NV12 ms", "BGRA+conv ms", "ratio");
+	for (const auto& path : CorpusFiles(argv[1], ".jpg"))
+	{
+		const auto jpeg = ReadFileBytes(path);
+		FrameBuffer bgra;
+		FrameBuffer nv12;
+		UINT w = 0, h = 0, stride = 0;
+		if (FAILED(decoder.Decode(jpeg.data(), jpeg.size(), 0, 0, bgra, &w, &h, &stride)))
+			continue;
+
+		for (UINT denom = 1; denom <= 8; denom *= 2)
+		{
+			const UINT width = (w + denom - 1) / denom;
+			const UINT height = (h + denom - 1) / denom;
+			if (decoder.DecodeNV12(jpeg.data(), jpeg.size(), width, height, nv12) != S_OK)
+				continue;
+
+			std::vector<BYTE> converted((size_t)width * height * 3 / 2);
+			const double direct = Measure([&]
+			{
+				decoder.DecodeNV12(jpeg.data(), jpeg.size(), width, height, nv12);
+			}, milliseconds);
+			const double indirect = Measure([&]
+			{
+				UINT bw = 0, bh = 0, bstride = 0;
+				decoder.Decode(jpeg.data(), jpeg.size(), width, height, bgra, &bw, &bh, &bstride);
+				RGB32ToNV12(bgra.Data(), (ULONG)bgra.Size(), (LONG)bstride, bw, bh, converted.data(), (ULONG)converted.size(), (LONG)width);
+			}, milliseconds);
+			printf("%-28s %3s%-2u %5ux%-5u %10.3f %14.3f %7.2f\n", path.filename().string().c_str(), "1/", denom, width, height, direct, indirect, indirect / direct);
+		}
+	}
+	FrameBufferPool::Instance().Trim(); // for the leak checker
+	return 0;
+}
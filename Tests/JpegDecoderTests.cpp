@@ -0,0 +1,243 @@
+#include "pch.h"
+#include "JpegDecoder.h"
+#include "ColorConversion.h"
+#include "MjpegSplitter.h"
+#include "Check.h"
+#include "CorpusResponse.h"
+#include "TestImages.h"
+#include "LibJpegDecoder.h"
+
+// JpegDecoder, through a libjpeg backend: decoding straight to NV12 must come out close to decoding to BGRA and
+// converting that with RGB32ToNV12, at full size and each IDCT scale, for the 4:2:0 JPEGs in Corpus/Jpeg; other
+// subsamplings, odd sizes and sizes that aren't a scale fall back (S_FALSE); only successful decodes are counted,
+// and frames a backend leaves to its fallback only there.
+// Usage: JpegDecoderTests Corpus/Jpeg
+
+// Found on the corpus: Y 56-57 dB, UV 47-51 dB at full size and 55-57 dB scaled. The direct path keeps the JPEG's
+// chroma samples, the BGRA path upsamples them and averages them back, and both round through 8 bits once more.
+// A wrong range, matrix or chroma siting costs well over 10 dB.
+static const double MinLumaPsnr = 50;
+static const double MinChromaPsnr = 42;
+
+struct Picture
+{
+	std::vector<BYTE> jpeg;
+	UINT width = 0;
+	UINT height = 0;
+};
+
+static bool Load(const std::filesystem::path& path, LibJpegDecoder& decoder, Picture& picture)
+{
+	picture.jpeg = ReadFileBytes(path);
+	FrameBuffer bgra;
+	UINT stride = 0;
+	return SUCCEEDED(decoder.Decode(picture.jpeg.data(), picture.jpeg.size(), 0, 0, bgra, &picture.width, &picture.height, &stride));
+}
+
+static void TestDirectNV12(const std::filesystem::path& path, const Picture& picture, LibJpegDecoder& decoder)
+{
+	for (UINT denom = 1; denom <= 8; denom *= 2)
+	{
+		const UINT width = (picture.width + denom - 1) / denom;
+		const UINT height = (picture.height + denom - 1) / denom;
+
+		FrameBuffer nv12;
+		auto hr = decoder.DecodeNV12(picture.jpeg.data(), picture.jpeg.size(), width, height, nv12);
+		CHECK(SUCCEEDED(hr));
+		if ((width & 1) || (height & 1))
+		{
+			CHECK(hr == S_FALSE);
+			continue;
+		}
+		CHECK(hr == S_OK);
+		if (hr != S_OK)
+			continue;
+		CHECK(nv12.Size() == (size_t)width * height * 3 / 2);
+
+		// the smallest scale covering the size is the size itself
+		FrameBuffer bgra;
+		UINT w = 0, h = 0, stride = 0;
+		CHECK(SUCCEEDED(decoder.Decode(picture.jpeg.data(), picture.jpeg.size(), width, height, bgra, &w, &h, &stride)));
+		CHECK(w == width && h == height);
+		if (w != width || h != height)
+			continue;
+
+		std::vector<BYTE> reference(nv12.Size());
+		CHECK(SUCCEEDED(RGB32ToNV12(bgra.Data(), (ULONG)bgra.Size(), (LONG)stride, w, h, reference.data(), (ULONG)reference.size(), (LONG)w)));
+
+		const size_t lumaSize = (size_t)width * height;
+		const double luma = Psnr(nv12.Data(), width, reference.data(), width, width, height);
+		const double chroma = Psnr(nv12.Data() + lumaSize, width, reference.data() + lumaSize, width, width, height / 2);
+		printf("%s 1/%u %ux%u: Y %.2f dB, UV %.2f dB\n", path.filename().string().c_str(), denom, width, height, luma, chroma);
+		CHECK(luma >= MinLumaPsnr);
+		CHECK(chroma >= MinChromaPsnr);
+	}
+}
+
+static void TestFallbacks(const Picture& picture, bool yuv420, LibJpegDecoder& decoder)
+{
+	FrameBuffer nv12;
+	auto decode = [&](UINT width, UINT height)
+	{
+		return decoder.DecodeNV12(picture.jpeg.data(), picture.jpeg.size(), width, height, nv12);
+	};
+
+	if (!yuv420)
+	{
+		CHECK(decode(picture.width, picture.height) == S_FALSE);
+		CHECK(decode(picture.width / 2, picture.height / 2) == S_FALSE);
+	}
+	// not an IDCT scale
+	CHECK(decode(picture.width - 2, picture.height) == S_FALSE);
+	CHECK(decode((picture.width / 3) & ~1, (picture.height / 3) & ~1) == S_FALSE);
+	CHECK(decode(picture.width * 2, picture.height * 2) == S_FALSE);
+	// odd or empty
+	CHECK(decode(picture.width + 1, picture.height) == S_FALSE);
+	CHECK(decode(picture.width, picture.height - 1) == S_FALSE);
+	CHECK(decode(0, 0) == S_FALSE);
+}
+
+// the BGRA decode picks the smallest IDCT scale that still covers the target
+static void TestScaleChoice(const Picture& picture, LibJpegDecoder& decoder)
+{
+	struct Case
+	{
+		UINT targetWidth;
+		UINT targetHeight;
+		UINT denom;
+	};
+	const Case cases[] =
+	{
+		{ 0, 0, 1 },
+		{ picture.width, picture.height, 1 },
+		{ picture.width / 2 + 1, picture.height / 2, 1 },
+		{ picture.width / 2, picture.height / 2, 2 },
+		{ picture.width / 4, picture.height / 2 + 1, 1 },
+		{ picture.width / 3, picture.height / 3, 2 },
+		{ picture.width / 8, picture.height / 8, 8 },
+		{ 1, 1, 8 },
+	};
+	for (const auto& c : cases)
+	{
+		FrameBuffer bgra;
+		UINT w = 0, h = 0, stride = 0;
+		CHECK(SUCCEEDED(decoder.Decode(picture.jpeg.data(), picture.jpeg.size(), c.targetWidth, c.targetHeight, bgra, &w, &h, &stride)));
+		CHECK(w == (picture.width + c.denom - 1) / c.denom);
+		CHECK(h == (picture.height + c.denom - 1) / c.denom);
+		CHECK(stride == w * 4);
+		CHECK(bgra.Size() >= (size_t)stride * h);
+	}
+}
+
+static void TestBadInput(const Picture& picture, LibJpegDecoder& decoder)
+{
+	FrameBuffer buffer;
+	UINT w = 0, h = 0, stride = 0;
+	const auto& jpeg = picture.jpeg;
+	CHECK(decoder.Decode(nullptr, 100, 0, 0, buffer, &w, &h, &stride) == E_INVALIDARG);
+	CHECK(decoder.Decode(jpeg.data(), 3, 0, 0, buffer, &w, &h, &stride) == E_INVALIDARG);
+	CHECK(decoder.Decode(jpeg.data(), jpeg.size(), 0, 0, buffer, nullptr, &h, &stride) == E_POINTER);
+	CHECK(decoder.DecodeNV12(nullptr, 100, 64, 64, buffer) == E_INVALIDARG);
+
+	// cut in the headers: the backend's error goes through
+	CHECK(FAILED(decoder.Decode(jpeg.data(), 100, 0, 0, buffer, &w, &h, &stride)));
+	CHECK(FAILED(decoder.DecodeNV12(jpeg.data(), 100, picture.width, picture.height, buffer)));
+
+	std::vector<BYTE> garbage(4096, 0x5A);
+	CHECK(FAILED(decoder.Decode(garbage.data(), garbage.size(), 0, 0, buffer, &w, &h, &stride)));
+}
+
+static void TestStats(const Picture& picture)
+{
+	LibJpegDecoder decoder;
+	FrameBuffer buffer;
+	UINT w = 0, h = 0, stride = 0;
+	const auto& jpeg = picture.jpeg;
+	CHECK(SUCCEEDED(decoder.Decode(jpeg.data(), jpeg.size(), 0, 0, buffer, &w, &h, &stride)));
+	CHECK(SUCCEEDED(decoder.Decode(jpeg.data(), jpeg.size(), w / 2, h / 2, buffer, &w, &h, &stride)));
+	CHECK(FAILED(decoder.Decode(jpeg.data(), 100, 0, 0, buffer, &w, &h, &stride)));
+	CHECK(decoder.DecodeNV12(jpeg.data(), jpeg.size(), picture.width, picture.height, buffer) == S_OK);
+	CHECK(decoder.DecodeNV12(jpeg.data(), jpeg.size(), picture.width + 2, picture.height, buffer) == S_FALSE);
+	CHECK(FAILED(decoder.DecodeNV12(jpeg.data(), 100, picture.width, picture.height, buffer)));
+
+	auto stats = decoder.GetStats();
+	CHECK(stats.frames == 2);
+	CHECK(stats.nv12Frames == 1);
+}
+
+// Leaves EXIF JPEGs to its fallback, as TurboJpegDecoder does
+class ExifFallbackDecoder : public LibJpegDecoder
+{
+protected:
+	HRESULT DecodeFrame(const BYTE* jpeg, size_t size, UINT targetWidth, UINT targetHeight, FrameBuffer& bgra, UINT* width, UINT* height, UINT* stride) override
+	{
+		if (MjpegSplitter::HasExif(jpeg, size))
+			return S_FALSE;
+		return LibJpegDecoder::DecodeFrame(jpeg, size, targetWidth, targetHeight, bgra, width, height, stride);
+	}
+
+public:
+	using LibJpegDecoder::LibJpegDecoder;
+};
+
+static void TestFallback(const Picture& picture)
+{
+	// the same JPEG with an EXIF block after SOI
+	auto exif = picture.jpeg;
+	const BYTE segment[] = { 0xFF, 0xE1, 0, 12, 'E', 'x', 'i', 'f', 0, 0, 'I', 'I', 42, 0 };
+	exif.insert(exif.begin() + 2, std::begin(segment), std::end(segment));
+
+	LibJpegDecoder fallback;
+	ExifFallbackDecoder decoder(&fallback);
+	FrameBuffer buffer;
+	UINT w = 0, h = 0, stride = 0;
+	CHECK(decoder.Decode(picture.jpeg.data(), picture.jpeg.size(), 0, 0, buffer, &w, &h, &stride) == S_OK);
+	CHECK(decoder.Decode(exif.data(), exif.size(), 0, 0, buffer, &w, &h, &stride) == S_OK);
+	CHECK(w == picture.width && h == picture.height);
+	CHECK(decoder.Decode(exif.data(), exif.size(), picture.width / 2, picture.height / 2, buffer, &w, &h, &stride) == S_OK);
+	CHECK(w == (picture.width + 1) / 2 && h == (picture.height + 1) / 2);
+	CHECK(decoder.GetStats().frames == 1);
+	CHECK(fallback.GetStats().frames == 2);
+
+	// without a fallback, the frame can't be decoded
+	ExifFallbackDecoder alone;
+	CHECK(FAILED(alone.Decode(exif.data(), exif.size(), 0, 0, buffer, &w, &h, &stride)));
+	CHECK(alone.GetStats().frames == 0);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: JpegDecoderTests corpus-directory\n");
+		return 2;
+	}
+
+	LibJpegDecoder decoder;
+	int yuv420Files = 0;
+	for (const auto& path : CorpusFiles(argv[1], ".jpg"))
+	{
+		Picture picture;
+		CHECK(Load(path, decoder, picture));
+		if (picture.jpeg.empty() || !picture.width)
+			continue;
+
+		// the file names start with the subsampling
+		const bool yuv420 = path.filename().string().starts_with("yuv420");
+		if (yuv420)
+		{
+			yuv420Files++;
+			TestDirectNV12(path, picture, decoder);
+			TestStats(picture);
+			TestFallback(picture);
+		}
+		TestFallbacks(picture, yuv420, decoder);
+		TestScaleChoice(picture, decoder);
+		TestBadInput(picture, decoder);
+	}
+	CHECK(yuv420Files >= 2);
+	FrameBufferPool::Instance().Trim(); // for the leak checker
+
+	printf("%d failure(s)\n", CheckFailures());
+	return CheckFailures() ? 1 : 0;
+}
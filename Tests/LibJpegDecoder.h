@@ -0,0 +1,201 @@
+#pragma once
+
+#include <csetjmp>
+#include <cstdio>
+#include <vector>
+#include <jpeglib.h>
+#include "JpegDecoder.h"
+
+// JpegDecoder backend on the libjpeg API for the tests, standing in for the WIC and TurboJPEG backends outside
+// Windows. Mirrors TurboJpegDecoder: the same scale choice, fast integer IDCT and fancy upsampling to BGRA, and
+// the JPEG's own planes for NV12, so the base class and what callers do with both outputs can be tested here.
+class LibJpegDecoder : public JpegDecoder
+{
+	// libjpeg reports fatal errors through error_exit, which must not return: jump back to the decode
+	struct ErrorManager
+	{
+		jpeg_error_mgr manager;
+		jmp_buf exit;
+	};
+
+	struct Decompress
+	{
+		jpeg_decompress_struct info{};
+		ErrorManager error{};
+
+		Decompress(const BYTE* jpeg, size_t size)
+		{
+			info.err = jpeg_std_error(&error.manager);
+			error.manager.error_exit = [](j_common_ptr common)
+			{
+				longjmp(reinterpret_cast<ErrorManager*>(common->err)->exit, 1);
+			};
+			error.manager.output_message = [](j_common_ptr) {}; // warnings are for recoverable corruption, as in turbo
+			jpeg_create_decompress(&info);
+			jpeg_mem_src(&info, jpeg, (unsigned long)size);
+		}
+		~Decompress() { jpeg_destroy_decompress(&info); }
+	};
+
+protected:
+	HRESULT DecodeFrame(const BYTE* jpeg, size_t size, UINT targetWidth, UINT targetHeight, FrameBuffer& bgra, UINT* width, UINT* height, UINT* stride) override
+	{
+		Decompress decompress(jpeg, size);
+		auto& info = decompress.info;
+		if (setjmp(decompress.error.exit))
+			return E_FAIL;
+
+		jpeg_read_header(&info, TRUE);
+		info.out_color_space = JCS_EXT_BGRA;
+		info.dct_method = JDCT_IFAST;
+		if (targetWidth && targetHeight)
+		{
+			for (UINT denom = 8; denom > 1; denom /= 2)
+			{
+				if ((info.image_width + denom - 1) / denom >= targetWidth && (info.image_height + denom - 1) / denom >= targetHeight)
+				{
+					info.scale_denom = denom;
+					break;
+				}
+			}
+		}
+
+		jpeg_start_decompress(&info);
+		const UINT w = info.output_width, h = info.output_height;
+		if (!bgra.Resize((size_t)w * 4 * h))
+		{
+			jpeg_abort_decompress(&info);
+			return E_OUTOFMEMORY;
+		}
+
+		while (info.output_scanline < h)
+		{
+			JSAMPROW row = bgra.Data() + (size_t)info.output_scanline * w * 4;
+			jpeg_read_scanlines(&info, &row, 1);
+		}
+		jpeg_finish_decompress(&info);
+
+		*width = w;
+		*height = h;
+		*stride = w * 4;
+		return S_OK;
+	}
+
+	HRESULT DecodeFrameNV12(const BYTE* jpeg, size_t size, UINT width, UINT height, FrameBuffer& nv12) override
+	{
+		// nothing with a destructor may be created between the setjmp and a longjmp
+		std::vector<JSAMPROW> rowPointers[3];
+		Decompress decompress(jpeg, size);
+		auto& info = decompress.info;
+		if (setjmp(decompress.error.exit))
+			return E_FAIL;
+
+		jpeg_read_header(&info, TRUE);
+		const auto* comp = info.comp_info;
+		if (info.jpeg_color_space != JCS_YCbCr || info.num_components != 3 ||
+			comp[0].h_samp_factor != 2 || comp[0].v_samp_factor != 2 ||
+			comp[1].h_samp_factor != 1 || comp[1].v_samp_factor != 1 ||
+			comp[2].h_samp_factor != 1 || comp[2].v_samp_factor != 1)
+		{
+			jpeg_abort_decompress(&info);
+			return S_FALSE;
+		}
+
+		bool scaled = false;
+		for (UINT denom = 1; denom <= 8; denom *= 2)
+		{
+			if ((info.image_width + denom - 1) / denom == width && (info.image_height + denom - 1) / denom == height)
+			{
+				info.scale_denom = denom;
+				scaled = true;
+				break;
+			}
+		}
+		if (!scaled)
+		{
+			jpeg_abort_decompress(&info);
+			return S_FALSE;
+		}
+
+		info.raw_data_out = TRUE;
+		info.dct_method = JDCT_IFAST;
+		jpeg_start_decompress(&info);
+
+		// the planes come out in whole blocks, decode them to padded scratch planes and crop
+		static thread_local std::vector<BYTE> scratch[3];
+		UINT strides[3], rows[3];
+		const UINT groupRows = info.max_v_samp_factor * info.min_DCT_scaled_size;
+		for (int c = 0; c < 3; c++)
+		{
+			strides[c] = comp[c].width_in_blocks * comp[c].DCT_scaled_size;
+			rows[c] = info.total_iMCU_rows * comp[c].v_samp_factor * comp[c].DCT_scaled_size;
+			scratch[c].resize((size_t)strides[c] * rows[c]);
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			rowPointers[c].resize(comp[c].v_samp_factor * comp[c].DCT_scaled_size);
+		}
+		for (UINT mcuRow = 0; info.output_scanline < info.output_height; mcuRow++)
+		{
+			JSAMPARRAY planes[3];
+			for (int c = 0; c < 3; c++)
+			{
+				const size_t first = (size_t)mcuRow * rowPointers[c].size();
+				for (size_t i = 0; i < rowPointers[c].size(); i++)
+				{
+					rowPointers[c][i] = scratch[c].data() + (first + i) * strides[c];
+				}
+				planes[c] = rowPointers[c].data();
+			}
+			jpeg_read_raw_data(&info, planes, groupRows);
+		}
+		const bool fullChroma = comp[1].DCT_scaled_size != comp[0].DCT_scaled_size;
+		jpeg_finish_decompress(&info); // frees comp_info
+
+		if (!nv12.Resize((size_t)width * height * 3 / 2))
+			return E_OUTOFMEMORY;
+
+		for (UINT y = 0; y < height; y++)
+		{
+			memcpy(nv12.Data() + (size_t)y * width, scratch[0].data() + (size_t)y * strides[0], width);
+		}
+		// scaled down, libjpeg runs the chroma IDCT at twice the luma's scale rather than upsample it afterwards,
+		// which leaves chroma planes at the luma's size: average those back to 4:2:0, as turbo's YUV output is
+		auto uv = nv12.Data() + (size_t)width * height;
+		if (!fullChroma)
+		{
+			for (UINT y = 0; y < height / 2; y++)
+			{
+				const BYTE* cb = scratch[1].data() + (size_t)y * strides[1];
+				const BYTE* cr = scratch[2].data() + (size_t)y * strides[2];
+				for (UINT x = 0; x < width / 2; x++)
+				{
+					*uv++ = cb[x];
+					*uv++ = cr[x];
+				}
+			}
+		}
+		else
+		{
+			for (UINT y = 0; y < height / 2; y++)
+			{
+				for (int c = 1; c < 3; c++)
+				{
+					const BYTE* top = scratch[c].data() + (size_t)y * 2 * strides[c];
+					const BYTE* bottom = top + strides[c];
+					for (UINT x = 0; x < width / 2; x++)
+					{
+						uv[x * 2 + c - 1] = (BYTE)((top[x * 2] + top[x * 2 + 1] + bottom[x * 2] + bottom[x * 2 + 1] + 2) / 4);
+					}
+				}
+				uv += width;
+			}
+		}
+		return S_OK;
+	}
+
+public:
+	explicit LibJpegDecoder(JpegDecoder* fallback = nullptr) : JpegDecoder(fallback) {}
+	const wchar_t* Name() const override { return L"libjpeg"; }
+};
@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "MarkerScan.h"
+#include "Check.h"
+#include <memory>
+
+// Marker byte kernels: every variant the CPU runs must find the first 0xFF in [p, end) like a plain loop, wherever
+// the range starts relative to vector alignment, wherever it ends, with the 0xFF at either end, in runs, or past
+// end where it must not be seen. Ranges end at the end of their allocation, so reading past end shows under
+// AddressSanitizer.
+
+static const BYTE* Reference(const BYTE* p, const BYTE* end)
+{
+	for (; p < end; p++)
+	{
+		if (*p == 0xFF)
+			return p;
+	}
+	return end;
+}
+
+// Bytes that are anything but 0xFF, 0xFE and 0x7F (one bit off) included
+static void Fill(BYTE* p, size_t size, std::mt19937& rng)
+{
+	static const BYTE nearMisses[] = { 0xFE, 0x7F, 0xEF, 0xF7, 0xFB, 0xFD, 0xBF, 0xDF, 0x00 };
+	for (size_t i = 0; i < size; i++)
+	{
+		p[i] = rng() % 4 ? nearMisses[rng() % sizeof(nearMisses)] : (BYTE)(rng() % 255);
+	}
+}
+
+struct Range
+{
+	std::unique_ptr<BYTE, decltype(&free)> memory{ nullptr, free };
+	BYTE* begin = nullptr;
+	BYTE* end = nullptr;
+};
+
+// size bytes starting offset bytes past a 64-byte boundary, at the end of their allocation
+static Range MakeRange(size_t offset, size_t size, std::mt19937& rng)
+{
+	Range range;
+	void* memory = nullptr;
+	CHECK(!posix_memalign(&memory, 64, std::max<size_t>(1, offset + size)));
+	range.memory.reset((BYTE*)memory);
+	range.begin = range.memory.get() + offset;
+	range.end = range.begin + size;
+	Fill(range.memory.get(), offset + size, rng);
+	return range;
+}
+
+static void Check(const MarkerScanKernel& kernel, const BYTE* begin, const BYTE* end, const char* what, size_t a, size_t b)
+{
+	auto expected = Reference(begin, end);
+	auto found = kernel.find(begin, end);
+	if (found != expected)
+	{
+		printf("%s: %s (%zu, %zu): found %td, expected %td\n", kernel.name, what, a, b, found - begin, expected - begin);
+		CHECK(false);
+	}
+}
+
+static void TestPositions(const MarkerScanKernel& kernel, std::mt19937& rng)
+{
+	// every size up to a few AVX2 iterations, every start alignment, a 0xFF at every position or none
+	for (size_t size = 0; size <= 200; size++)
+	{
+		for (size_t align = 0; align < 64; align += size > 70 ? 7 : 1)
+		{
+			auto range = MakeRange(align, size, rng);
+			Check(kernel, range.begin, range.end, "none", size, align);
+			for (size_t pos = 0; pos < size; pos++)
+			{
+				range.begin[pos] = 0xFF;
+				Check(kernel, range.begin, range.end, "one", size, pos);
+				range.begin[pos] = 0xFE;
+			}
+		}
+	}
+}
+
+static void TestEnds(const MarkerScanKernel& kernel, std::mt19937& rng)
+{
+	for (size_t size = 1; size <= 300; size++)
+	{
+		// at the first and the last byte
+		auto range = MakeRange(1 + size % 63, size, rng);
+		range.begin[size - 1] = 0xFF;
+		Check(kernel, range.begin, range.end, "last", size, 0);
+		range.begin[0] = 0xFF;
+		Check(kernel, range.begin, range.end, "first", size, 0);
+
+		// a 0xFF just past end isn't seen, nor one just before begin
+		range.begin[0] = 0x00;
+		range.begin[size - 1] = 0xFF;
+		Check(kernel, range.begin, range.end - 1, "past end", size, 0);
+		range.begin[-1] = 0xFF;
+		range.begin[size - 1] = 0x00;
+		Check(kernel, range.begin, range.end, "before begin", size, 0);
+	}
+
+	BYTE empty = 0xFF;
+	CHECK(kernel.find(&empty, &empty) == &empty);
+}
+
+static void TestRuns(const MarkerScanKernel& kernel, std::mt19937& rng)
+{
+	// runs of 0xFF, as fill bytes before a marker: the first one counts, whatever follows in the vector
+	for (int i = 0; i < 20000; i++)
+	{
+		const size_t size = 1 + rng() % 300;
+		auto range = MakeRange(rng() % 64, size, rng);
+		const size_t runs = 1 + rng() % 4;
+		for (size_t r = 0; r < runs; r++)
+		{
+			const size_t start = rng() % size;
+			const size_t length = std::min<size_t>(size - start, 1 + rng() % 70);
+			memset(range.begin + start, 0xFF, length);
+		}
+		Check(kernel, range.begin, range.end, "runs", size, runs);
+
+		// and from inside a run
+		const size_t from = rng() % size;
+		Check(kernel, range.begin + from, range.end, "from", size, from);
+	}
+
+	// all 0xFF
+	std::vector<BYTE> ff(256, 0xFF);
+	for (size_t from = 0; from < ff.size(); from++)
+	{
+		CHECK(kernel.find(ff.data() + from, ff.data() + ff.size()) == ff.data() + from);
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(TestSeed());
+	const auto& kernels = MarkerScanKernels();
+	CHECK(!strcmp(kernels.front().name, "scalar"));
+	for (const auto& kernel : kernels)
+	{
+		printf("%s\n", kernel.name);
+		TestPositions(kernel, rng);
+		TestEnds(kernel, rng);
+		TestRuns(kernel, rng);
+	}
+	printf("%d failure(s)\n", CheckFailures());
+	return CheckFailures() ? 1 : 0;
+}
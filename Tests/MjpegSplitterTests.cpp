@@ -0,0 +1,213 @@
+#include "pch.h"
+#include "MjpegSplitter.h"
+#include "Check.h"
+#include "TestJpeg.h"
+
+// Feeds MjpegSplitter complete streams in random chunk sizes, the way the transports hand it network reads, and
+// checks it returns exactly the frames that went in, whatever the chunking.
+
+struct Stream
+{
+	std::string contentType;
+	std::vector<BYTE> bytes;
+	std::vector<std::vector<BYTE>> frames;
+};
+
+struct Result
+{
+	std::vector<std::vector<BYTE>> frames;
+	ULONGLONG lengthFrames = 0;
+};
+
+enum class Feed
+{
+	WriteBuffer, // GetWriteBuffer/CommitWrite, like the transports
+	Append,
+};
+
+static Result Split(const Stream& stream, std::mt19937& rng, size_t maxChunk, Feed feed)
+{
+	MjpegSplitter splitter;
+	splitter.SetContentType(stream.contentType);
+	std::uniform_int_distribution<size_t> chunk(1, maxChunk);
+	Result result;
+	for (size_t pos = 0; pos < stream.bytes.size();)
+	{
+		auto size = std::min(chunk(rng), stream.bytes.size() - pos);
+		if (feed == Feed::Append)
+		{
+			splitter.Append(stream.bytes.data() + pos, size);
+		}
+		else
+		{
+			// ask for more room than we fill, as a reader does when it doesn't know how much is coming
+			auto buffer = splitter.GetWriteBuffer(size + 4096);
+			memcpy(buffer, stream.bytes.data() + pos, size);
+			splitter.CommitWrite(size);
+		}
+		pos += size;
+
+		const BYTE* data;
+		size_t frameSize;
+		while (splitter.NextFrame(&data, &frameSize))
+		{
+			result.frames.emplace_back(data, data + frameSize);
+		}
+		CHECK(splitter.BufferedSize() <= splitter.Capacity());
+	}
+	CHECK(splitter.FrameCount() == result.frames.size());
+	result.lengthFrames = splitter.LengthFrameCount();
+	return result;
+}
+
+static std::vector<std::vector<BYTE>> MakeFrames(std::mt19937& rng, int count, bool thumbnails)
+{
+	std::uniform_int_distribution<size_t> entropy(0, 60000);
+	std::vector<std::vector<BYTE>> frames;
+	for (int i = 0; i < count; i++)
+	{
+		frames.push_back(MakeTestJpeg(rng, 640 + i, 480 + i, entropy(rng), thumbnails && i % 2 == 0));
+	}
+	return frames;
+}
+
+static void AppendText(std::vector<BYTE>& bytes, const std::string& text)
+{
+	bytes.insert(bytes.end(), text.begin(), text.end());
+}
+
+static Stream MakeRawStream(std::mt19937& rng, bool thumbnails)
+{
+	Stream stream;
+	stream.contentType = "image/jpeg";
+	stream.frames = MakeFrames(rng, 12, thumbnails);
+	for (const auto& frame : stream.frames)
+	{
+		stream.bytes.insert(stream.bytes.end(), frame.begin(), frame.end());
+	}
+	return stream;
+}
+
+static Stream MakeMultipartStream(std::mt19937& rng, bool contentLength, bool thumbnails, const std::string& declared, const std::string& delimiter)
+{
+	Stream stream;
+	stream.contentType = "multipart/x-mixed-replace; boundary=" + declared;
+	stream.frames = MakeFrames(rng, 12, thumbnails);
+	for (const auto& frame : stream.frames)
+	{
+		AppendText(stream.bytes, "--" + delimiter + "\r\nContent-Type: image/jpeg\r\n");
+		if (contentLength)
+		{
+			AppendText(stream.bytes, "Content-Length: " + std::to_string(frame.size()) + "\r\n");
+		}
+		AppendText(stream.bytes, "\r\n");
+		stream.bytes.insert(stream.bytes.end(), frame.begin(), frame.end());
+		AppendText(stream.bytes, "\r\n");
+	}
+	AppendText(stream.bytes, "--" + delimiter + "--\r\n");
+	return stream;
+}
+
+static void CheckStream(const char* name, const Stream& stream, std::mt19937& rng, bool contentLength)
+{
+	for (auto maxChunk : { (size_t)1, (size_t)7, (size_t)1500, (size_t)65536, (size_t)1024 * 1024 })
+	{
+		for (auto feed : { Feed::WriteBuffer, Feed::Append })
+		{
+			auto result = Split(stream, rng, maxChunk, feed);
+			auto ok = result.frames == stream.frames;
+			if (!ok)
+			{
+				fprintf(stderr, "%s, chunks up to %zu bytes: %zu frames out of %zu\n", name, maxChunk, result.frames.size(), stream.frames.size());
+			}
+			CHECK(ok);
+			CHECK(result.lengthFrames == (contentLength ? stream.frames.size() : 0));
+		}
+	}
+}
+
+static void TestRaw(std::mt19937& rng)
+{
+	CheckStream("raw", MakeRawStream(rng, false), rng, false);
+	CheckStream("raw with thumbnails", MakeRawStream(rng, true), rng, false);
+}
+
+static void TestMultipart(std::mt19937& rng)
+{
+	for (auto contentLength : { true, false })
+	{
+		for (auto thumbnails : { false, true })
+		{
+			auto name = std::string("multipart") + (contentLength ? " with" : " without") + " Content-Length" + (thumbnails ? " with thumbnails" : "");
+			CheckStream(name.c_str(), MakeMultipartStream(rng, contentLength, thumbnails, "myboundary", "myboundary"), rng, contentLength);
+		}
+	}
+
+	// some servers declare the boundary with the leading "--" or quote it
+	CheckStream("multipart, boundary declared with dashes", MakeMultipartStream(rng, true, true, "--frame", "frame"), rng, true);
+	CheckStream("multipart, quoted boundary", MakeMultipartStream(rng, false, true, "\"frame\"", "frame"), rng, false);
+}
+
+static void TestLargeFrames(std::mt19937& rng)
+{
+	// frames bigger than the initial ingest buffer make it grow while a frame is in flight
+	Stream stream;
+	stream.contentType = "multipart/x-mixed-replace;boundary=b";
+	for (int i = 0; i < 3; i++)
+	{
+		stream.frames.push_back(MakeTestJpeg(rng, 3840, 2160, MjpegSplitter::InitialCapacity + 100000 * i, true));
+		AppendText(stream.bytes, "--b\r\n\r\n");
+		stream.bytes.insert(stream.bytes.end(), stream.frames.back().begin(), stream.frames.back().end());
+		AppendText(stream.bytes, "\r\n");
+	}
+	CheckStream("large frames", stream, rng, false);
+}
+
+static void TestJunk(std::mt19937& rng)
+{
+	// bytes before the first frame and between frames of a raw stream are skipped
+	Stream stream;
+	stream.contentType = "image/jpeg";
+	stream.frames = MakeFrames(rng, 4, true);
+	for (const auto& frame : stream.frames)
+	{
+		AppendText(stream.bytes, "\xFF\xFF junk \xFF");
+		stream.bytes.insert(stream.bytes.end(), frame.begin(), frame.end());
+	}
+	CheckStream("junk between frames", stream, rng, false);
+}
+
+static void TestFrameSize(std::mt19937& rng)
+{
+	for (auto thumbnail : { false, true })
+	{
+		auto jpeg = MakeTestJpeg(rng, 1920, 1080, 1000, thumbnail);
+		UINT width = 0, height = 0;
+		CHECK(MjpegSplitter::ReadFrameSize(jpeg.data(), jpeg.size(), &width, &height));
+		CHECK(width == 1920 && height == 1080);
+		CHECK(!MjpegSplitter::ReadFrameSize(jpeg.data(), 20, &width, &height));
+
+		// the thumbnail comes in an EXIF block; cut before it, there is none
+		CHECK(MjpegSplitter::HasExif(jpeg.data(), jpeg.size()) == thumbnail);
+		CHECK(!MjpegSplitter::HasExif(jpeg.data(), 22));
+	}
+
+	// "Exif" in another segment doesn't count
+	std::vector<BYTE> jpeg{ 0xFF, 0xD8 };
+	AppendSegment(jpeg, 0xE2, { 'E', 'x', 'i', 'f', 0, 0, 'I', 'I', 42, 0 });
+	AppendSegment(jpeg, 0xDA, { 'E', 'x', 'i', 'f', 0, 0, 'I', 'I', 42, 0 });
+	CHECK(!MjpegSplitter::HasExif(jpeg.data(), jpeg.size()));
+}
+
+int main()
+{
+	printf("marker scanner: %s\n", MjpegSplitter::MarkerScanner());
+	std::mt19937 rng(TestSeed());
+	TestRaw(rng);
+	TestMultipart(rng);
+	TestLargeFrames(rng);
+	TestJunk(rng);
+	TestFrameSize(rng);
+	printf("%d failure(s)\n", CheckFailures());
+	return CheckFailures() ? 1 : 0;
+}
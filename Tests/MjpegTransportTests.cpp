@@ -0,0 +1,441 @@
+#include "pch.h"
+#include "PosixSocketTransport.h"
+#include "MjpegSplitter.h"
+#include "FrameBufferPool.h"
+#include "Check.h"
+#include "CorpusResponse.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+// PosixSocketTransport against a loopback HTTP server: the responses in Corpus/Splitter, served as stored and
+// ended by closing the connection, must give the splitter the frames it finds in them read from the file; snapshot
+// responses with Content-Length or chunked come one after the other over a single kept-alive connection; a 404 and
+// an empty 200 are errors the transport backs off from; and Stop returns at once, in the middle of a response or
+// of a backoff.
+// Usage: MjpegTransportTests Corpus/Splitter
+
+using namespace std::chrono_literals;
+
+// Accepts connections on 127.0.0.1 one at a time and hands each to the handler, on a thread of its own
+class LoopbackServer
+{
+	int _listen = -1;
+	WORD _port = 0;
+	std::atomic<bool> _stop{ false };
+	std::atomic<int> _connections{ 0 };
+	std::thread _thread;
+
+public:
+	// returns when the connection is done with, the server closes it
+	using Handler = std::function<void(int client)>;
+
+	explicit LoopbackServer(Handler handler)
+	{
+		_listen = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t size = sizeof(address);
+		CHECK(!bind(_listen, (sockaddr*)&address, size));
+		CHECK(!listen(_listen, 8));
+		CHECK(!getsockname(_listen, (sockaddr*)&address, &size));
+		_port = ntohs(address.sin_port);
+
+		_thread = std::thread([this, handler]()
+		{
+			while (!_stop)
+			{
+				pollfd fd{ _listen, POLLIN, 0 };
+				if (poll(&fd, 1, 20) <= 0)
+					continue;
+
+				int client = accept4(_listen, nullptr, nullptr, SOCK_CLOEXEC);
+				if (client == -1)
+					continue;
+
+				// responses go out in several writes, which must not wait for acknowledgments
+				int noDelay = 1;
+				setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+				_connections++;
+				handler(client);
+				close(client);
+			}
+		});
+	}
+
+	~LoopbackServer()
+	{
+		_stop = true;
+		_thread.join();
+		close(_listen);
+	}
+
+	WORD Port() const { return _port; }
+	int Connections() const { return _connections; }
+	bool Stopping() const { return _stop; }
+
+	// reads a request's headers, false when the client closed the connection or the server stops
+	bool ReadRequest(int client)
+	{
+		std::string request;
+		while (request.find("\r\n\r\n") == std::string::npos)
+		{
+			pollfd fd{ client, POLLIN, 0 };
+			if (poll(&fd, 1, 20) <= 0)
+			{
+				if (_stop)
+					return false;
+				continue;
+			}
+
+			char buffer[1024];
+			auto received = recv(client, buffer, sizeof(buffer), 0);
+			if (received <= 0)
+				return false;
+			request.append(buffer, received);
+		}
+		CHECK(request.starts_with("GET /"));
+		CHECK(request.find("\r\nHost: 127.0.0.1:") != std::string::npos);
+		return true;
+	}
+
+	static void Send(int client, const void* data, size_t size)
+	{
+		auto bytes = (const char*)data;
+		while (size)
+		{
+			auto sent = send(client, bytes, size, MSG_NOSIGNAL);
+			if (sent <= 0)
+				return;
+			bytes += sent;
+			size -= sent;
+		}
+	}
+
+	static void Send(int client, const std::string& text) { Send(client, text.data(), text.size()); }
+};
+
+// Feeds a splitter as FrameGenerator does, and keeps what came out of each response
+class TestSink : public MjpegTransportSink
+{
+	MjpegSplitter _splitter;
+	std::mutex _lock;
+	std::condition_variable _changed;
+
+public:
+	struct Response
+	{
+		DWORD statusCode;
+		std::string contentType;
+		std::vector<std::vector<BYTE>> frames;
+		MFTIME time;
+	};
+	std::vector<Response> responses;
+	std::vector<HRESULT> errors;
+
+	void OnResponse(DWORD statusCode, const std::string& contentType) override
+	{
+		_splitter.SetContentType(contentType);
+		std::lock_guard lock(_lock);
+		responses.push_back({ statusCode, contentType, {}, MFGetSystemTime() });
+		_changed.notify_all();
+	}
+
+	BYTE* GetReadBuffer(DWORD size) override { return _splitter.GetWriteBuffer(size); }
+
+	bool OnData(DWORD size) override
+	{
+		_splitter.CommitWrite(size);
+		bool frame = false;
+		const BYTE* data;
+		size_t frameSize;
+		std::lock_guard lock(_lock);
+		while (_splitter.NextFrame(&data, &frameSize))
+		{
+			CHECK(!responses.empty());
+			responses.back().frames.emplace_back(data, data + frameSize);
+			frame = true;
+		}
+		_changed.notify_all();
+		return frame;
+	}
+
+	void OnError(HRESULT hr) override
+	{
+		std::lock_guard lock(_lock);
+		errors.push_back(hr);
+		_changed.notify_all();
+	}
+
+	// waits up to 10 s for the condition, checked under the lock
+	bool WaitFor(const std::function<bool()>& condition)
+	{
+		std::unique_lock lock(_lock);
+		return _changed.wait_for(lock, 10s, condition);
+	}
+
+	std::unique_lock<std::mutex> Lock() { return std::unique_lock(_lock); }
+};
+
+static MjpegEndpoint Loopback(WORD port, const wchar_t* path)
+{
+	MjpegEndpoint endpoint;
+	endpoint.host = L"127.0.0.1";
+	endpoint.port = port;
+	endpoint.path = path;
+	return endpoint;
+}
+
+// the frames the splitter finds in the response read from the file, the body in one piece
+static std::vector<std::vector<BYTE>> ExpectedFrames(const ::Response& response)
+{
+	MjpegSplitter splitter;
+	splitter.SetContentType(response.contentType);
+	for (const auto& chunk : response.chunks)
+	{
+		splitter.Append(chunk.data(), chunk.size());
+	}
+
+	std::vector<std::vector<BYTE>> frames;
+	const BYTE* data;
+	size_t size;
+	while (splitter.NextFrame(&data, &size))
+	{
+		frames.emplace_back(data, data + size);
+	}
+	return frames;
+}
+
+static void TestCorpusFile(const std::filesystem::path& path)
+{
+	const auto bytes = ReadFileBytes(path);
+	::Response parsed;
+	CHECK(ParseResponse(bytes.data(), bytes.size(), &parsed));
+	const auto expected = ExpectedFrames(parsed);
+
+	// the stored response in small writes, so reads end anywhere
+	LoopbackServer server([&](int client)
+	{
+		if (!server.ReadRequest(client))
+			return;
+		for (size_t pos = 0; pos < bytes.size(); pos += 1000)
+		{
+			LoopbackServer::Send(client, bytes.data() + pos, std::min<size_t>(1000, bytes.size() - pos));
+		}
+	});
+
+	TestSink sink;
+	PosixSocketTransport transport;
+	CHECK(SUCCEEDED(transport.Start(Loopback(server.Port(), L"/video"), &sink)));
+	// the first response is over once the transport opened a second one, or failed
+	CHECK(sink.WaitFor([&] { return sink.responses.size() >= 2 || !sink.errors.empty(); }));
+	transport.Stop();
+
+	auto lock = sink.Lock();
+	CHECK(!sink.responses.empty());
+	if (sink.responses.empty())
+		return;
+
+	const auto& first = sink.responses[0];
+	CHECK(first.statusCode == 200);
+	CHECK(first.contentType == parsed.contentType);
+	CHECK(first.frames == expected);
+	if (parsed.expectedFrames >= 0)
+	{
+		CHECK(first.frames.size() == (size_t)parsed.expectedFrames);
+	}
+	// a response without frames is an error, one with frames is reopened at once
+	CHECK(sink.errors.empty() == !expected.empty());
+	printf("%s: %zu frames, %zu responses\n", path.filename().string().c_str(), first.frames.size(), sink.responses.size());
+}
+
+static void TestSnapshots(const std::vector<BYTE>& jpeg, bool chunked)
+{
+	std::atomic<int> requests{ 0 };
+	LoopbackServer server([&](int client)
+	{
+		while (server.ReadRequest(client))
+		{
+			requests++;
+			if (chunked)
+			{
+				LoopbackServer::Send(client, "HTTP/1.1 200 OK\r\nContent-Type: image/jpeg\r\nTransfer-Encoding: chunked\r\n\r\n");
+				const size_t half = jpeg.size() / 2;
+				char size[32];
+				snprintf(size, sizeof(size), "%zx;name=value\r\n", half);
+				LoopbackServer::Send(client, size);
+				LoopbackServer::Send(client, jpeg.data(), half);
+				snprintf(size, sizeof(size), "\r\n%zX\r\n", jpeg.size() - half);
+				LoopbackServer::Send(client, size);
+				LoopbackServer::Send(client, jpeg.data() + half, jpeg.size() - half);
+				LoopbackServer::Send(client, "\r\n0\r\nX-Trailer: 1\r\n\r\n");
+			}
+			else
+			{
+				LoopbackServer::Send(client, "HTTP/1.1 200 OK\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(jpeg.size()) + "\r\n\r\n");
+				LoopbackServer::Send(client, jpeg.data(), jpeg.size());
+			}
+		}
+	});
+
+	TestSink sink;
+	PosixSocketTransport transport;
+	auto endpoint = Loopback(server.Port(), L"/snapshot.jpg");
+	endpoint.snapshot = true;
+	endpoint.pollIntervalMs = 10;
+	CHECK(SUCCEEDED(transport.Start(endpoint, &sink)));
+	CHECK(sink.WaitFor([&] { return sink.responses.size() >= 6; }));
+	transport.Stop();
+
+	auto lock = sink.Lock();
+	CHECK(sink.errors.empty());
+	CHECK(server.Connections() == 1);
+	CHECK(requests >= (int)sink.responses.size());
+	for (size_t i = 0; i + 1 < sink.responses.size(); i++) // the last one may have been cut by Stop
+	{
+		const auto& response = sink.responses[i];
+		CHECK(response.statusCode == 200);
+		CHECK(response.frames.size() == 1 && response.frames[0] == jpeg);
+	}
+	CHECK(transport.GetStats().reconnects >= 5);
+
+	// polled no faster than the interval, give or take how long the first response took to come
+	const auto elapsed = sink.responses.back().time - sink.responses.front().time;
+	CHECK(elapsed >= (LONGLONG)((sink.responses.size() - 1) * 10 - 5) * 10000);
+}
+
+// a response that delivers no frame fails, and the next request waits for the backoff
+static void TestErrorResponse(const std::string& response, DWORD statusCode, HRESULT error)
+{
+	LoopbackServer server([&](int client)
+	{
+		while (server.ReadRequest(client))
+		{
+			LoopbackServer::Send(client, response);
+		}
+	});
+
+	TestSink sink;
+	PosixSocketTransport transport;
+	CHECK(SUCCEEDED(transport.Start(Loopback(server.Port(), L"/"), &sink)));
+	CHECK(sink.WaitFor([&] { return sink.errors.size() >= 2 && sink.responses.size() >= 2; }));
+	transport.Stop();
+
+	auto lock = sink.Lock();
+	for (auto hr : sink.errors)
+	{
+		CHECK(hr == error);
+	}
+	CHECK(sink.responses.size() >= 2 && sink.responses[0].statusCode == statusCode);
+	if (sink.responses.size() >= 2)
+	{
+		CHECK(sink.responses[0].frames.empty());
+		CHECK(sink.responses[1].time - sink.responses[0].time >= (LONGLONG)ReconnectBackoff::MinDelayMs / 2 * 10000);
+	}
+}
+
+static void TestStop()
+{
+	// in the middle of a response that stalls
+	LoopbackServer server([&](int client)
+	{
+		if (!server.ReadRequest(client))
+			return;
+		LoopbackServer::Send(client, "HTTP/1.1 200 OK\r\nContent-Type: image/jpeg\r\n\r\n\xFF\xD8");
+		while (!server.Stopping())
+		{
+			std::this_thread::sleep_for(10ms);
+		}
+	});
+
+	TestSink sink;
+	{
+		PosixSocketTransport transport;
+		CHECK(SUCCEEDED(transport.Start(Loopback(server.Port(), L"/"), &sink)));
+		CHECK(sink.WaitFor([&] { return !sink.responses.empty(); }));
+		auto start = MFGetSystemTime();
+		transport.Stop();
+		CHECK(MFGetSystemTime() - start < 1000 * 10000);
+		CHECK(transport.GetStats().waits >= 1);
+	}
+
+	// in a backoff: nothing listens on the port any more once its server is gone
+	WORD port = 0;
+	{
+		LoopbackServer closed([](int) {});
+		port = closed.Port();
+	}
+	TestSink refused;
+	PosixSocketTransport transport;
+	CHECK(SUCCEEDED(transport.Start(Loopback(port, L"/"), &refused)));
+	CHECK(refused.WaitFor([&] { return refused.errors.size() >= 3; }));
+	auto start = MFGetSystemTime();
+	transport.Stop();
+	CHECK(MFGetSystemTime() - start < 1000 * 10000);
+	CHECK(refused.responses.empty());
+
+	// and again: a stopped transport can be started anew
+	CHECK(SUCCEEDED(transport.Start(Loopback(port, L"/"), &refused)));
+	transport.Stop();
+}
+
+static void TestInvalidEndpoints()
+{
+	TestSink sink;
+	PosixSocketTransport transport;
+	auto endpoint = Loopback(80, L"/");
+	CHECK(transport.Start(endpoint, nullptr) == E_POINTER);
+	endpoint.https = true;
+	CHECK(transport.Start(endpoint, &sink) == E_NOTIMPL);
+	endpoint = Loopback(80, L"/a path");
+	CHECK(transport.Start(endpoint, &sink) == E_INVALIDARG);
+	endpoint.host.clear();
+	endpoint.path = L"/";
+	CHECK(transport.Start(endpoint, &sink) == E_INVALIDARG);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: MjpegTransportTests corpus-directory\n");
+		return 2;
+	}
+
+	std::vector<BYTE> jpeg;
+	for (const auto& path : CorpusFiles(argv[1]))
+	{
+		TestCorpusFile(path);
+
+		// any frame of the corpus will do for the snapshots
+		::Response parsed;
+		auto bytes = ReadFileBytes(path);
+		if (jpeg.empty() && ParseResponse(bytes.data(), bytes.size(), &parsed))
+		{
+			auto frames = ExpectedFrames(parsed);
+			if (!frames.empty())
+			{
+				jpeg = frames[0];
+			}
+		}
+	}
+	CHECK(!jpeg.empty());
+
+	TestSnapshots(jpeg, false);
+	TestSnapshots(jpeg, true);
+	TestErrorResponse("HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 9\r\n\r\nnot found", 404, HTTP_E_STATUS_UNEXPECTED);
+	TestErrorResponse("HTTP/1.1 200 OK\r\nContent-Type: image/jpeg\r\nContent-Length: 0\r\n\r\n", 200, HRESULT_FROM_WIN32(ERROR_NO_DATA));
+	TestStop();
+	TestInvalidEndpoints();
+	FrameBufferPool::Instance().Trim(); // for the leak checker
+
+	printf("%d failure(s)\n", CheckFailures());
+	return CheckFailures() ? 1 : 0;
+}
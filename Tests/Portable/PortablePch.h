@@ -0,0 +1,81 @@
+#pragma once
+
+// Stand-in for framework.h when the platform independent sources are built for the unit tests with GCC or Clang:
+// just the Windows types, HRESULTs and WIL macros those sources use, nothing that needs the Windows SDK.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <strings.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+typedef unsigned char BYTE;
+typedef uint16_t WORD;
+typedef uint16_t UINT16;
+typedef int16_t INT16;
+typedef uint32_t DWORD;
+typedef uint32_t UINT;
+typedef uint32_t UINT32;
+typedef uint32_t ULONG;
+typedef int32_t LONG;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef int BOOL;
+typedef int32_t HRESULT;
+typedef LONGLONG MFTIME;
+
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_NOTIMPL ((HRESULT)0x80004001)
+#define E_ABORT ((HRESULT)0x80004004)
+#define E_FAIL ((HRESULT)0x80004005)
+#define E_POINTER ((HRESULT)0x80004003)
+#define E_UNEXPECTED ((HRESULT)0x8000FFFF)
+#define E_INVALIDARG ((HRESULT)0x80070057)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000E)
+#define WINCODEC_ERR_BADIMAGE ((HRESULT)0x88982F60)
+#define WINCODEC_ERR_BADHEADER ((HRESULT)0x88982F61)
+#define HTTP_E_STATUS_UNEXPECTED ((HRESULT)0x80190001)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define HRESULT_FROM_WIN32(x) ((HRESULT)(x) <= 0 ? (HRESULT)(x) : (HRESULT)(((x) & 0x0000FFFF) | (7 << 16) | 0x80000000))
+#define ERROR_INVALID_DATA 13L
+#define ERROR_NO_DATA 232L
+#define MAXDWORD 0xFFFFFFFFu
+
+#define RETURN_HR_IF(hr, condition) do { if (condition) return (hr); } while (0)
+#define RETURN_HR_IF_NULL(hr, ptr) do { if (!(ptr)) return (hr); } while (0)
+#define RETURN_IF_FAILED(expr) do { const HRESULT _hr = (expr); if (FAILED(_hr)) return _hr; } while (0)
+
+#define WINTRACE(...) ((void)0)
+#define _strnicmp strncasecmp
+
+// 100 ns units, like Media Foundation's clock
+inline MFTIME MFGetSystemTime()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() / 100;
+}
+
+inline void* _aligned_malloc(size_t size, size_t alignment)
+{
+	return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+inline void _aligned_free(void* p)
+{
+	free(p);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// the sources test the MSVC target macros to enable their SSE/AVX paths, see intrin.h next to this file
+#if defined(__x86_64__)
+#define _M_X64 1
+#else
+#define _M_IX86 1
+#endif
+#endif
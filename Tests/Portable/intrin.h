@@ -0,0 +1,24 @@
+#pragma once
+
+// MSVC's <intrin.h> for GCC and Clang: the x86 intrinsics plus the CPUID helpers CpuFeatures uses
+
+#include <immintrin.h>
+#include <cpuid.h>
+
+// <cpuid.h> has a __cpuid macro with another signature, and a __cpuidex only in newer versions
+static inline void PortableCpuid(int info[4], int leaf, int subleaf)
+{
+	__cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+}
+
+static inline unsigned long long PortableXgetbv(unsigned int index)
+{
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+	return ((unsigned long long)edx << 32) | eax;
+}
+
+#undef __cpuid
+#define __cpuid(info, leaf) PortableCpuid(info, leaf, 0)
+#define __cpuidex(info, leaf, subleaf) PortableCpuid(info, leaf, subleaf)
+#define _xgetbv(index) PortableXgetbv(index)
@@ -0,0 +1,143 @@
+#include "pch.h"
+#include "Resampler.h"
+#include "TestImages.h"
+#include <chrono>
+#include <cstdio>
+
+// Times the resampler per filter and kernel level on the calling thread, for BGRA and NV12, and measures each
+// filter's quality: the PSNR of a smooth picture scaled against the same picture drawn at the target size. The
+// Fant scaler WIC offers is an area average; a floating point area average is measured alongside as the
+// baseline the filters replace. Not a test, run it by hand: ResamplerBenchmark [milliseconds per measurement]
+
+struct Size
+{
+	UINT width;
+	UINT height;
+};
+
+static const char* FilterName(ResampleFilter filter)
+{
+	switch (filter)
+	{
+	case ResampleFilter::Bicubic:
+		return "bicubic";
+	case ResampleFilter::Lanczos3:
+		return "Lanczos3";
+	default:
+		return "bilinear";
+	}
+}
+
+template<typename F>
+static double Measure(F scale, int milliseconds)
+{
+	// best of several runs of as many frames as fit the time
+	using clock = std::chrono::steady_clock;
+	double best = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		int count = 0;
+		const auto start = clock::now();
+		auto elapsed = clock::duration::zero();
+		do
+		{
+			scale();
+			count++;
+			elapsed = clock::now() - start;
+		} while (elapsed < std::chrono::milliseconds(milliseconds) / 5);
+		best = std::min(best, std::chrono::duration<double, std::milli>(elapsed).count() / count);
+	}
+	return best;
+}
+
+// Each destination pixel the average of the source area it covers, partial pixels weighted by how much of them
+// is covered
+static std::vector<BYTE> AreaAverage(const std::vector<BYTE>& src, Size from, Size to)
+{
+	std::vector<BYTE> dst((size_t)to.width * to.height * 4);
+	const double sx = (double)from.width / to.width;
+	const double sy = (double)from.height / to.height;
+	for (UINT y = 0; y < to.height; y++)
+	{
+		const double top = y * sy, bottom = top + sy;
+		for (UINT x = 0; x < to.width; x++)
+		{
+			const double left = x * sx, right = left + sx;
+			double sum[4]{}, area = 0;
+			for (UINT j = (UINT)top; j < from.height && j < bottom; j++)
+			{
+				const double h = std::min<double>(bottom, j + 1) - std::max<double>(top, j);
+				for (UINT i = (UINT)left; i < from.width && i < right; i++)
+				{
+					const double a = h * (std::min<double>(right, i + 1) - std::max<double>(left, i));
+					auto p = &src[((size_t)j * from.width + i) * 4];
+					for (UINT c = 0; c < 4; c++)
+					{
+						sum[c] += a * p[c];
+					}
+					area += a;
+				}
+			}
+			for (UINT c = 0; c < 4; c++)
+			{
+				dst[((size_t)y * to.width + x) * 4 + c] = (BYTE)lround(sum[c] / area);
+			}
+		}
+	}
+	return dst;
+}
+
+int main(int argc, char** argv)
+{
+	const int milliseconds = argc > 1 ? atoi(argv[1]) : 500;
+	const Size pairs[][2] =
+	{
+		{ { 1920, 1080 }, { 1280, 720 } },
+		{ { 3840, 2160 }, { 1920, 1080 } },
+		{ { 1920, 1080 }, { 640, 360 } },
+		{ { 1280, 720 }, { 1920, 1080 } },
+	};
+	const ResampleFilter filters[] = { ResampleFilter::Bilinear, ResampleFilter::Bicubic, ResampleFilter::Lanczos3 };
+	Resampler resampler;
+	for (auto& pair : pairs)
+	{
+		const auto src = pair[0];
+		const auto dst = pair[1];
+		const double frequency = std::min(src.width, dst.width) / 4.0;
+		const auto bgra = DrawPattern(src.width, src.height, 4, (size_t)src.width * 4, frequency);
+		const auto reference = DrawPattern(dst.width, dst.height, 4, (size_t)dst.width * 4, frequency);
+		const auto nv12 = DrawPattern(src.width, src.height + src.height / 2, 1, src.width, frequency);
+		std::vector<BYTE> out((size_t)dst.width * dst.height * 4);
+		printf("%ux%u -> %ux%u\n", src.width, src.height, dst.width, dst.height);
+
+		for (auto filter : filters)
+		{
+			resampler.SetFilter(filter);
+			resampler.SetKernel(Resampler::Kernel());
+			resampler.ScaleBGRA(bgra.data(), src.width, src.height, src.width * 4, out.data(), dst.width, dst.height, dst.width * 4);
+			printf("  %-9s PSNR %6.2f dB", FilterName(filter), Psnr(out.data(), dst.width * 4, reference.data(), dst.width * 4, (size_t)dst.width * 4, dst.height));
+
+			for (auto kernel : Resampler::Kernels())
+			{
+				resampler.SetKernel(kernel);
+				const auto timeBgra = Measure([&]()
+				{
+					resampler.ScaleBGRA(bgra.data(), src.width, src.height, src.width * 4, out.data(), dst.width, dst.height, dst.width * 4);
+				}, milliseconds);
+				const auto timeNv12 = Measure([&]()
+				{
+					resampler.ScaleNV12(nv12.data(), nv12.data() + (size_t)src.width * src.height, src.width, src.height, src.width, out.data(), out.data() + (size_t)dst.width * dst.height, dst.width, dst.height, dst.width);
+				}, milliseconds);
+				printf("   %s BGRA %7.3f ms NV12 %7.3f ms", kernel, timeBgra, timeNv12);
+			}
+			printf("\n");
+		}
+
+		if (dst.width <= src.width && dst.height <= src.height)
+		{
+			const auto area = AreaAverage(bgra, src, dst);
+			printf("  %-9s PSNR %6.2f dB\n", "area", Psnr(area.data(), dst.width * 4, reference.data(), dst.width * 4, (size_t)dst.width * 4, dst.height));
+		}
+	}
+	return 0;
+}
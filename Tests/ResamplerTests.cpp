@@ -0,0 +1,210 @@
+#include "pch.h"
+#include "Resampler.h"
+#include "SlicePool.h"
+#include "Check.h"
+#include "TestImages.h"
+
+// Resampler: every kernel level must produce exactly what the scalar code does, for BGRA and both NV12 planes,
+// growing and shrinking, odd sizes and padded strides; running in bands on the slice pool must not change a
+// byte; and flat pictures stay flat while smooth ones come out close to the same picture drawn at the target size.
+
+static const ResampleFilter Filters[] = { ResampleFilter::Bilinear, ResampleFilter::Bicubic, ResampleFilter::Lanczos3 };
+
+struct Size
+{
+	UINT width;
+	UINT height;
+};
+
+static const Size Sizes[][2] =
+{
+	{ { 1920, 1080 }, { 1280, 720 } },
+	{ { 1280, 720 }, { 1920, 1080 } },
+	{ { 640, 480 }, { 641, 479 } },
+	{ { 333, 251 }, { 97, 75 } },
+	{ { 3840, 2160 }, { 320, 180 } },   // wide filters
+	{ { 17, 9 }, { 1001, 3 } },
+	{ { 640, 480 }, { 640, 360 } },     // vertical pass only
+	{ { 640, 360 }, { 853, 360 } },     // horizontal pass only
+	{ { 7, 5 }, { 1, 1 } },
+	{ { 1, 1 }, { 9, 6 } },
+};
+
+struct Scaled
+{
+	LONG stride;
+	std::vector<BYTE> bgra;
+	std::vector<BYTE> nv12;
+};
+
+static std::vector<BYTE> Random(std::mt19937& rng, size_t size)
+{
+	std::vector<BYTE> bytes(size);
+	for (auto& b : bytes)
+	{
+		b = (BYTE)rng();
+	}
+	return bytes;
+}
+
+// Scales both formats with the given kernels; output padding is filled with 0xCD, which must survive
+static Scaled Scale(Resampler& resampler, Size src, Size dst, LONG srcStride, const std::vector<BYTE>& bgra, LONG nv12Stride, const std::vector<BYTE>& nv12, LONG padding)
+{
+	Scaled out;
+	out.stride = (LONG)dst.width * 4 + padding;
+	out.bgra.assign((size_t)out.stride * dst.height, 0xCD);
+	CHECK(SUCCEEDED(resampler.ScaleBGRA(bgra.data(), src.width, src.height, srcStride, out.bgra.data(), dst.width, dst.height, out.stride)));
+
+	const LONG dstNv12Stride = (LONG)((dst.width + 1) & ~1) + padding;
+	const size_t dstLuma = (size_t)dstNv12Stride * dst.height;
+	out.nv12.assign(dstLuma + (size_t)dstNv12Stride * ((dst.height + 1) / 2), 0xCD);
+	const size_t srcLuma = (size_t)nv12Stride * src.height;
+	CHECK(SUCCEEDED(resampler.ScaleNV12(nv12.data(), nv12.data() + srcLuma, src.width, src.height, nv12Stride, out.nv12.data(), out.nv12.data() + dstLuma, dst.width, dst.height, dstNv12Stride)));
+	return out;
+}
+
+static void CheckPadding(const std::vector<BYTE>& bytes, LONG stride, size_t rowBytes)
+{
+	UINT wrong = 0;
+	for (size_t offset = 0; offset < bytes.size(); offset += stride)
+	{
+		for (auto x = rowBytes; x < (size_t)stride && offset + x < bytes.size(); x++)
+		{
+			wrong += bytes[offset + x] != 0xCD;
+		}
+	}
+	CHECK(!wrong);
+}
+
+static void TestLevelsAndBands(std::mt19937& rng)
+{
+	const auto kernels = Resampler::Kernels();
+	printf("kernels:");
+	for (auto name : kernels)
+	{
+		printf(" %s", name);
+	}
+	printf(" (default %s)\n", Resampler::Kernel());
+	CHECK(!strcmp(kernels.front(), "scalar") && !strcmp(kernels.back(), Resampler::Kernel()));
+
+	Resampler resampler;
+	CHECK(!resampler.SetKernel("MMX"));
+	for (auto& pair : Sizes)
+	{
+		const auto src = pair[0];
+		const auto dst = pair[1];
+		const LONG padding = rng() % 3 * 4;
+		const LONG srcStride = (LONG)src.width * 4 + padding;
+		const auto bgra = Random(rng, (size_t)srcStride * src.height);
+		const LONG nv12Stride = (LONG)((src.width + 1) & ~1) + padding;
+		const auto nv12 = Random(rng, (size_t)nv12Stride * (src.height + (src.height + 1) / 2));
+		for (auto filter : Filters)
+		{
+			resampler.SetFilter(filter);
+			CHECK(resampler.SetKernel("scalar"));
+			const auto golden = Scale(resampler, src, dst, srcStride, bgra, nv12Stride, nv12, padding);
+			CheckPadding(golden.bgra, golden.stride, (size_t)dst.width * 4);
+			const LONG nv12DstStride = (LONG)((dst.width + 1) & ~1) + padding;
+			CheckPadding(golden.nv12, nv12DstStride, ((dst.width + 1) / 2) * 2);
+
+			for (auto name : kernels)
+			{
+				CHECK(resampler.SetKernel(name));
+				auto out = Scale(resampler, src, dst, srcStride, bgra, nv12Stride, nv12, padding);
+				if (out.bgra != golden.bgra || out.nv12 != golden.nv12)
+				{
+					printf("%s, filter %u: %ux%u -> %ux%u differs from scalar\n", name, (UINT)filter, src.width, src.height, dst.width, dst.height);
+					CHECK(false);
+				}
+
+				// the same in bands on the pool
+				SlicePool::Instance().Acquire();
+				out = Scale(resampler, src, dst, srcStride, bgra, nv12Stride, nv12, padding);
+				SlicePool::Instance().Release();
+				if (out.bgra != golden.bgra || out.nv12 != golden.nv12)
+				{
+					printf("%s, filter %u: %ux%u -> %ux%u in bands differs from scalar\n", name, (UINT)filter, src.width, src.height, dst.width, dst.height);
+					CHECK(false);
+				}
+			}
+		}
+	}
+}
+
+static void TestFlat()
+{
+	// weights add up to exactly one: a flat picture stays flat, whatever the filter and ratio
+	Resampler resampler;
+	for (auto filter : Filters)
+	{
+		resampler.SetFilter(filter);
+		for (auto& pair : Sizes)
+		{
+			const auto src = pair[0];
+			const auto dst = pair[1];
+			for (BYTE value : { (BYTE)0, (BYTE)1, (BYTE)127, (BYTE)254, (BYTE)255 })
+			{
+				std::vector<BYTE> in((size_t)src.width * 4 * src.height, value);
+				std::vector<BYTE> out((size_t)dst.width * 4 * dst.height);
+				CHECK(SUCCEEDED(resampler.ScaleBGRA(in.data(), src.width, src.height, src.width * 4, out.data(), dst.width, dst.height, dst.width * 4)));
+				CHECK(std::all_of(out.begin(), out.end(), [value](BYTE b) { return b == value; }));
+			}
+		}
+	}
+}
+
+static void TestQuality()
+{
+	// a smooth picture scaled comes out close to the same picture drawn at the target size; the sharper filters
+	// don't do worse than bilinear
+	const Size pairs[][2] = { { { 1920, 1080 }, { 1280, 720 } }, { { 1280, 720 }, { 1920, 1080 } }, { { 3840, 2160 }, { 960, 540 } } };
+	Resampler resampler;
+	for (auto& pair : pairs)
+	{
+		const auto src = pair[0];
+		const auto dst = pair[1];
+		const double frequency = std::min(src.width, dst.width) / 4.0; // half the lower Nyquist frequency
+		const auto in = DrawPattern(src.width, src.height, 4, (size_t)src.width * 4, frequency);
+		const auto reference = DrawPattern(dst.width, dst.height, 4, (size_t)dst.width * 4, frequency);
+		double bilinear = 0;
+		for (auto filter : Filters)
+		{
+			resampler.SetFilter(filter);
+			std::vector<BYTE> out((size_t)dst.width * 4 * dst.height);
+			CHECK(SUCCEEDED(resampler.ScaleBGRA(in.data(), src.width, src.height, src.width * 4, out.data(), dst.width, dst.height, dst.width * 4)));
+			const auto psnr = Psnr(out.data(), dst.width * 4, reference.data(), dst.width * 4, (size_t)dst.width * 4, dst.height);
+			printf("%ux%u -> %ux%u filter %u: %.2f dB\n", src.width, src.height, dst.width, dst.height, (UINT)filter, psnr);
+			CHECK(psnr >= 30);
+			if (filter == ResampleFilter::Bilinear)
+			{
+				bilinear = psnr;
+			}
+			CHECK(psnr >= bilinear - 0.5);
+		}
+	}
+}
+
+static void TestInvalid()
+{
+	Resampler resampler;
+	BYTE pixels[64]{};
+	CHECK(resampler.ScaleBGRA(nullptr, 2, 2, 8, pixels, 2, 2, 8) == E_INVALIDARG);
+	CHECK(resampler.ScaleBGRA(pixels, 0, 2, 8, pixels, 2, 2, 8) == E_INVALIDARG);
+	CHECK(resampler.ScaleBGRA(pixels, 2, 2, 7, pixels, 2, 2, 8) == E_INVALIDARG);
+	CHECK(resampler.ScaleBGRA(pixels, 2, 2, 8, pixels, 2, 2, -8) == E_INVALIDARG);
+	CHECK(resampler.ScaleNV12(pixels, nullptr, 2, 2, 2, pixels, pixels, 2, 2, 2) == E_INVALIDARG);
+	CHECK(resampler.ScaleNV12(pixels, pixels, 3, 2, 3, pixels, pixels, 2, 2, 2) == E_INVALIDARG);
+}
+
+int main()
+{
+	std::mt19937 rng(TestSeed());
+	SlicePool::Instance().SetWorkerCount(3);
+	TestLevelsAndBands(rng);
+	TestFlat();
+	TestQuality();
+	TestInvalid();
+	FrameBufferPool::Instance().Trim();
+	printf("%d failure(s)\n", CheckFailures());
+	return CheckFailures() ? 1 : 0;
+}
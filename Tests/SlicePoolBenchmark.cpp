@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "ColorConversion.h"
+#include "SlicePool.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Scaling of the banded stages with the number of pool workers: the RGB32 conversions at 1080p and 4K, on the
+// calling thread alone and then with 1, 2, 4 and 8 workers, with the speedup and the share of bands the workers
+// took. Worker counts past the machine's cores only add handoffs. Not a test, run it by hand:
+// SlicePoolBenchmark [milliseconds per measurement]
+
+typedef HRESULT(*ConvertFn)(const BYTE*, ULONG, LONG, UINT, UINT, BYTE*, ULONG, LONG, YuvMatrix, YuvRange);
+
+struct Stage
+{
+	const char* name;
+	ConvertFn convert;
+	UINT width;
+	UINT height;
+};
+
+static double Measure(const Stage& stage, const std::vector<BYTE>& input, std::vector<BYTE>& output, int milliseconds)
+{
+	// best of several runs of as many conversions as fit the time
+	using clock = std::chrono::steady_clock;
+	double best = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		int count = 0;
+		const auto start = clock::now();
+		auto elapsed = clock::duration::zero();
+		do
+		{
+			stage.convert(input.data(), (ULONG)input.size(), stage.width * 4, stage.width, stage.height, output.data(), (ULONG)output.size(), stage.width * 2, YuvMatrix::BT709, YuvRange::Limited);
+			count++;
+			elapsed = clock::now() - start;
+		} while (elapsed < std::chrono::milliseconds(milliseconds) / 5);
+		best = std::min(best, std::chrono::duration<double, std::milli>(elapsed).count() / count);
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	const int milliseconds = argc > 1 ? atoi(argv[1]) : 500;
+	const Stage stages[] =
+	{
+		{ "RGB32ToNV12 1080p", RGB32ToNV12, 1920, 1080 },
+		{ "RGB32ToNV12 4K", RGB32ToNV12, 3840, 2160 },
+		{ "RGB32ToYUY2 1080p", RGB32ToYUY2, 1920, 1080 },
+		{ "RGB32ToI420 4K", RGB32ToI420, 3840, 2160 },
+	};
+	const UINT workerCounts[] = { 1, 2, 4, 8 };
+	auto& pool = SlicePool::Instance();
+	printf("%u hardware threads, %s kernel\n", std::thread::hardware_concurrency(), RGB32ToNV12Kernel());
+
+	std::mt19937 rng(1);
+	for (auto& stage : stages)
+	{
+		std::vector<BYTE> input((size_t)stage.width * stage.height * 4);
+		for (auto& b : input)
+		{
+			b = (BYTE)rng();
+		}
+		std::vector<BYTE> output((size_t)stage.width * 2 * stage.height * 2);
+
+		// without users the pool runs everything on the calling thread
+		const auto single = Measure(stage, input, output, milliseconds);
+		printf("%-18s no workers %8.3f ms\n", stage.name, single);
+		for (auto workers : workerCounts)
+		{
+			pool.SetWorkerCount(workers);
+			pool.Acquire();
+			auto before = pool.GetStats();
+			const auto time = Measure(stage, input, output, milliseconds);
+			auto stats = pool.GetStats();
+			pool.Release();
+
+			const auto bands = stats.bands - before.bands;
+			printf("%-18s %u worker%s %8.3f ms  x%.2f  %4.1f%% of bands stolen\n", "", workers, workers > 1 ? "s" : " ", time, single / time, bands ? 100.0 * (stats.stolenBands - before.stolenBands) / bands : 0.0);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,222 @@
+#include "pch.h"
+#include "SlicePool.h"
+#include "Check.h"
+#include <atomic>
+#include <chrono>
+
+// SlicePool: every row in exactly one band, bands on the alignment, workers taking the bands of a caller stuck in
+// one of its own, and workers stopping with the last user and starting again with the next one. The pool is
+// started with a fixed worker count, so the tests don't depend on the machine's cores.
+
+static const UINT Workers = 3;
+
+// Runs a job and checks its bands cover [0, rows) once each, each starting on a multiple of alignment
+static void CheckCoverage(SlicePool& pool, UINT rows, UINT alignment)
+{
+	std::vector<std::atomic<int>> hits(rows);
+	std::atomic<bool> aligned{ true };
+	pool.Run(rows, alignment, [&](UINT first, UINT last)
+	{
+		if (first % std::max<UINT>(1, alignment) || first >= last || last > rows)
+		{
+			aligned = false;
+			return;
+		}
+		for (auto row = first; row < last; row++)
+		{
+			hits[row]++;
+		}
+	});
+
+	CHECK(aligned);
+	UINT wrong = 0;
+	for (auto& count : hits)
+	{
+		wrong += count != 1;
+	}
+	CHECK(!wrong);
+}
+
+static void TestCoverage()
+{
+	auto& pool = SlicePool::Instance();
+	pool.Acquire();
+	CHECK(pool.WorkerCount() == Workers);
+	for (UINT rows : { 1u, 2u, 31u, 32u, 33u, 64u, 65u, 479u, 1080u, 1081u, 2160u, 4097u })
+	{
+		for (UINT alignment : { 0u, 1u, 2u, 16u, 100u })
+		{
+			CheckCoverage(pool, rows, alignment);
+		}
+	}
+
+	// small jobs aren't split: one band, on the calling thread
+	auto before = pool.GetStats();
+	const auto caller = std::this_thread::get_id();
+	bool onCaller = false;
+	pool.Run(SlicePool::MinBandRows, 1, [&](UINT first, UINT last)
+	{
+		onCaller = first == 0 && last == SlicePool::MinBandRows && std::this_thread::get_id() == caller;
+	});
+	auto stats = pool.GetStats();
+	CHECK(onCaller);
+	CHECK(stats.jobs == before.jobs + 1 && stats.bands == before.bands + 1);
+
+	// nothing to do, not even a job
+	pool.Run(0, 1, [&](UINT, UINT) { CHECK(false); });
+	CHECK(pool.GetStats().jobs == stats.jobs);
+	pool.Release();
+}
+
+static void TestConcurrentJobs()
+{
+	// several cameras converting at once share the workers, each job still sees all its rows
+	auto& pool = SlicePool::Instance();
+	pool.Acquire();
+	std::vector<std::thread> callers;
+	for (UINT i = 0; i < 4; i++)
+	{
+		callers.emplace_back([&pool, i]()
+		{
+			for (int job = 0; job < 200; job++)
+			{
+				CheckCoverage(pool, 720 + i * 97 + job % 7, i % 2 ? 2 : 1);
+			}
+		});
+	}
+	for (auto& caller : callers)
+	{
+		caller.join();
+	}
+	pool.Release();
+}
+
+static void TestStalledBand()
+{
+	// the caller takes the first band and stays in it until the others are done: only the workers can run them
+	auto& pool = SlicePool::Instance();
+	pool.Acquire();
+	const UINT rows = 1080;
+	std::atomic<UINT> done{ 0 };
+	std::atomic<UINT> bands{ 0 };
+	bool stalled = false;
+	bool othersDone = false;
+	auto before = pool.GetStats();
+	pool.Run(rows, 1, [&](UINT first, UINT last)
+	{
+		bands++;
+		if (first)
+		{
+			done += last - first;
+			return;
+		}
+
+		stalled = true;
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (done != rows - last && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::yield();
+		}
+		othersDone = done == rows - last;
+	});
+	auto stats = pool.GetStats();
+	CHECK(stalled && othersDone);
+	CHECK(stats.bands - before.bands == bands);
+	CHECK(stats.stolenBands - before.stolenBands == bands - 1);
+	pool.Release();
+}
+
+static void TestRestart()
+{
+	auto& pool = SlicePool::Instance();
+	CHECK(pool.WorkerCount() == 0);
+
+	// without users, Run calls body once, on the calling thread
+	UINT calls = 0;
+	pool.Run(4096, 1, [&](UINT first, UINT last)
+	{
+		calls++;
+		CHECK(first == 0 && last == 4096);
+	});
+	CHECK(calls == 1);
+
+	// workers run as long as someone holds the pool
+	pool.Acquire();
+	pool.Acquire();
+	CHECK(pool.WorkerCount() == Workers);
+	pool.Release();
+	CHECK(pool.WorkerCount() == Workers);
+	pool.Release();
+	CHECK(pool.WorkerCount() == 0);
+	pool.Release(); // one too many is ignored
+	CHECK(pool.WorkerCount() == 0);
+
+	// the next user starts a new set, which takes bands like the first one did
+	for (int cycle = 0; cycle < 20; cycle++)
+	{
+		pool.Acquire();
+		CHECK(pool.WorkerCount() == Workers);
+		auto before = pool.GetStats();
+		for (int job = 0; job < 5; job++)
+		{
+			CheckCoverage(pool, 1080, 2);
+		}
+		CHECK(pool.GetStats().bands - before.bands > 5);
+		pool.Release();
+		CHECK(pool.WorkerCount() == 0);
+	}
+
+	// a new worker count applies to the next set
+	pool.SetWorkerCount(1);
+	pool.Acquire();
+	CHECK(pool.WorkerCount() == 1);
+	pool.SetWorkerCount(Workers);
+	CHECK(pool.WorkerCount() == 1);
+	pool.Release();
+	pool.Acquire();
+	CHECK(pool.WorkerCount() == Workers);
+	pool.Release();
+}
+
+static void TestReleaseWhileRunning()
+{
+	// the last user leaving while other threads are in Run: their jobs finish, on their own threads if need be
+	auto& pool = SlicePool::Instance();
+	pool.Acquire();
+	std::atomic<bool> stop{ false };
+	std::vector<std::thread> callers;
+	for (int i = 0; i < 2; i++)
+	{
+		callers.emplace_back([&]()
+		{
+			while (!stop)
+			{
+				CheckCoverage(pool, 1080, 2);
+			}
+		});
+	}
+	for (int cycle = 0; cycle < 50; cycle++)
+	{
+		pool.Release();
+		pool.Acquire();
+	}
+	stop = true;
+	for (auto& caller : callers)
+	{
+		caller.join();
+	}
+	pool.Release();
+	CHECK(pool.WorkerCount() == 0);
+}
+
+int main()
+{
+	SlicePool::Instance().SetWorkerCount(Workers);
+	TestCoverage();
+	TestConcurrentJobs();
+	TestStalledBand();
+	TestRestart();
+	TestReleaseWhileRunning();
+	printf("%d failure(s)\n", CheckFailures());
+	return CheckFailures() ? 1 : 0;
+}
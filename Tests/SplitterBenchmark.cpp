@@ -0,0 +1,184 @@
+#include "pch.h"
+#include "MjpegSplitter.h"
+#include "CorpusResponse.h"
+#include "TestJpeg.h"
+#include <chrono>
+#include <cstdio>
+
+// Bytes copied per frame by the reader the splitter replaced, which appended reads to a vector, copied each frame
+// out of it and erased the consumed prefix, against MjpegSplitter, whose frames are spans into its ingest buffer
+// and which only moves the partial frame in flight when the buffer fills up. Both get the responses of
+// Corpus/Splitter, repeated, in reads of a TCP segment, 16 KB and 64 KB, then a stream of 1080p-sized frames.
+// Copying reads off the network is the same for both and isn't counted. The vector reader cuts frames at the first
+// 0xFF 0xD9, which EXIF thumbnails and table bytes can hold, so some of its frames come out short and its copies
+// per frame can be under the frame size. Not a test, run it by hand:
+// SplitterBenchmark <corpus directory> [frames per stream]
+
+// The reader before MjpegSplitter, minus the network
+class VectorSplitter
+{
+	std::vector<BYTE> _buffer;
+	std::vector<BYTE> _lastJpeg;
+
+	static bool FindJpeg(const std::vector<BYTE>& buf, size_t& start, size_t& end)
+	{
+		start = end = std::string::npos;
+		size_t i = 0;
+		for (; i + 1 < buf.size(); ++i)
+		{
+			if (buf[i] == 0xFF && buf[i + 1] == 0xD8) { start = i; break; }
+		}
+		if (start == std::string::npos)
+			return false;
+		for (i = start + 2; i + 1 < buf.size(); ++i)
+		{
+			if (buf[i] == 0xFF && buf[i + 1] == 0xD9) { end = i + 2; break; }
+		}
+		return end != std::string::npos;
+	}
+
+public:
+	ULONGLONG copied = 0;
+	ULONGLONG frames = 0;
+
+	void Append(const BYTE* data, size_t size)
+	{
+		const auto oldSize = _buffer.size();
+		const auto oldCapacity = _buffer.capacity();
+		_buffer.resize(oldSize + size);
+		if (_buffer.capacity() != oldCapacity)
+		{
+			copied += oldSize; // reallocation
+		}
+		memcpy(_buffer.data() + oldSize, data, size);
+
+		size_t start, end;
+		while (FindJpeg(_buffer, start, end))
+		{
+			_lastJpeg.assign(_buffer.begin() + start, _buffer.begin() + end);
+			_buffer.erase(_buffer.begin(), _buffer.begin() + end);
+			copied += (end - start) + _buffer.size();
+			frames++;
+		}
+	}
+};
+
+struct Result
+{
+	ULONGLONG frames = 0;
+	ULONGLONG frameBytes = 0;
+	ULONGLONG copied = 0;
+	double milliseconds = 0;
+};
+
+// Body chunks repeated until the stream holds at least frames frames
+static std::vector<std::vector<BYTE>> Stream(const Response& response, int frames, int framesPerResponse)
+{
+	std::vector<std::vector<BYTE>> chunks;
+	for (int count = 0; count < frames; count += std::max(1, framesPerResponse))
+	{
+		chunks.insert(chunks.end(), response.chunks.begin(), response.chunks.end());
+	}
+	return chunks;
+}
+
+template<typename F>
+static void ForEachRead(const std::vector<std::vector<BYTE>>& chunks, size_t readSize, F read)
+{
+	for (const auto& chunk : chunks)
+	{
+		for (size_t pos = 0; pos < chunk.size(); pos += readSize)
+		{
+			read(chunk.data() + pos, std::min(readSize, chunk.size() - pos));
+		}
+	}
+}
+
+static Result RunVector(const std::vector<std::vector<BYTE>>& chunks, size_t readSize)
+{
+	VectorSplitter splitter;
+	const auto start = std::chrono::steady_clock::now();
+	ForEachRead(chunks, readSize, [&](const BYTE* data, size_t size) { splitter.Append(data, size); });
+	Result result;
+	result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	result.frames = splitter.frames;
+	result.copied = splitter.copied;
+	return result;
+}
+
+static Result RunSplitter(const Response& response, const std::vector<std::vector<BYTE>>& chunks, size_t readSize)
+{
+	MjpegSplitter splitter;
+	splitter.SetContentType(response.contentType);
+	Result result;
+	const auto start = std::chrono::steady_clock::now();
+	ForEachRead(chunks, readSize, [&](const BYTE* data, size_t size)
+	{
+		memcpy(splitter.GetWriteBuffer(size), data, size);
+		splitter.CommitWrite(size);
+		const BYTE* frame;
+		size_t frameSize;
+		while (splitter.NextFrame(&frame, &frameSize))
+		{
+			result.frameBytes += frameSize;
+		}
+	});
+	result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	result.frames = splitter.FrameCount();
+	result.copied = splitter.BytesMoved();
+	return result;
+}
+
+static void Compare(const char* name, const Response& response, int frames, int framesPerResponse)
+{
+	const auto chunks = Stream(response, frames, framesPerResponse);
+	for (size_t readSize : { (size_t)1460, (size_t)16384, (size_t)65536 })
+	{
+		const auto before = RunVector(chunks, readSize);
+		const auto after = RunSplitter(response, chunks, readSize);
+		const auto frameSize = after.frames ? (double)after.frameBytes / after.frames : 0.0;
+		auto perFrame = [](const Result& result) { return result.frames ? (double)result.copied / result.frames : 0.0; };
+		printf("%-40s %5zu B reads, %6.0f B frames  vector: %6llu frames, copied %9.0f B/frame (%5.1f%%) %8.3f ms  splitter: %6llu frames, copied %8.0f B/frame (%5.1f%%) %8.3f ms\n",
+			name, readSize, frameSize,
+			(unsigned long long)before.frames, perFrame(before), frameSize ? 100 * perFrame(before) / frameSize : 0.0, before.milliseconds,
+			(unsigned long long)after.frames, perFrame(after), frameSize ? 100 * perFrame(after) / frameSize : 0.0, after.milliseconds);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: SplitterBenchmark <corpus directory> [frames per stream]\n");
+		return 2;
+	}
+
+	const int frames = argc > 2 ? atoi(argv[2]) : 2000;
+	for (const auto& path : CorpusFiles(argv[1]))
+	{
+		const auto bytes = ReadFileBytes(path);
+		Response response;
+		if (!ParseResponse(bytes.data(), bytes.size(), &response))
+		{
+			fprintf(stderr, "%s: doesn't parse\n", path.filename().string().c_str());
+			continue;
+		}
+		Compare(path.filename().string().c_str(), response, frames, response.expectedFrames);
+	}
+
+	// camera-sized frames: 1080p MJPEG at around 150 KB a frame, with Content-Length
+	std::mt19937 rng(1);
+	Response response;
+	response.contentType = "multipart/x-mixed-replace; boundary=frame";
+	for (int i = 0; i < 16; i++)
+	{
+		auto jpeg = MakeTestJpeg(rng, 1920, 1080, 140000 + rng() % 20000, false);
+		auto header = "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(jpeg.size()) + "\r\n\r\n";
+		std::vector<BYTE> part(header.begin(), header.end());
+		part.insert(part.end(), jpeg.begin(), jpeg.end());
+		part.insert(part.end(), { '\r', '\n' });
+		response.chunks.push_back(std::move(part));
+	}
+	Compare("1080p frames", response, frames / 4, 16);
+	return 0;
+}
@@ -0,0 +1,159 @@
+#include "pch.h"
+#include "MjpegSplitter.h"
+#include "Check.h"
+#include "CorpusResponse.h"
+
+// Replays HTTP responses from camera servers (Corpus/Splitter) through MjpegSplitter, and fuzzes it with mutated
+// copies. The chunks of a chunked body are handed over as separate reads, further split at random.
+//
+// Built with -DVCAM_FUZZER=ON (Clang), the same code is a libFuzzer target: run it on a copy of the corpus.
+
+// Splits each server chunk into reads of at most maxRead bytes; returns the frames, checks what holds for any input
+static std::vector<std::vector<BYTE>> Replay(const Response& response, std::mt19937& rng, size_t maxRead)
+{
+	MjpegSplitter splitter;
+	splitter.SetContentType(response.contentType);
+	std::uniform_int_distribution<size_t> read(1, maxRead);
+	std::vector<std::vector<BYTE>> frames;
+	for (const auto& chunk : response.chunks)
+	{
+		for (size_t pos = 0; pos < chunk.size();)
+		{
+			auto size = std::min(read(rng), chunk.size() - pos);
+			auto buffer = splitter.GetWriteBuffer(size);
+			memcpy(buffer, chunk.data() + pos, size);
+			splitter.CommitWrite(size);
+			pos += size;
+
+			const BYTE* data;
+			size_t frameSize;
+			while (splitter.NextFrame(&data, &frameSize))
+			{
+				CHECK(frameSize >= 2 && data[0] == 0xFF && data[1] == 0xD8);
+				frames.emplace_back(data, data + frameSize);
+			}
+			CHECK(splitter.BufferedSize() <= splitter.Capacity());
+		}
+	}
+	return frames;
+}
+
+static void Fuzz(const BYTE* data, size_t size, std::mt19937& rng)
+{
+	Response response;
+	if (!ParseResponse(data, size, &response))
+		return;
+
+	for (auto maxRead : { (size_t)7, (size_t)4096 })
+	{
+		Replay(response, rng, maxRead);
+	}
+}
+
+#ifdef VCAM_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	std::mt19937 rng((unsigned int)size);
+	Fuzz(data, size, rng);
+	if (CheckFailures())
+	{
+		abort();
+	}
+	return 0;
+}
+#else
+static bool IsJpeg(const std::vector<BYTE>& frame)
+{
+	return frame.size() >= 4 && frame[0] == 0xFF && frame[1] == 0xD8 && frame[frame.size() - 2] == 0xFF && frame.back() == 0xD9;
+}
+
+static void ReplayFile(const std::filesystem::path& path, std::mt19937& rng)
+{
+	auto bytes = ReadFileBytes(path);
+	Response response;
+	auto parsed = ParseResponse(bytes.data(), bytes.size(), &response);
+	CHECK(parsed);
+	if (!parsed)
+		return;
+
+	// the frames can't depend on how the body was cut into reads
+	auto reference = Replay(response, rng, SIZE_MAX);
+	for (auto maxRead : { (size_t)1, (size_t)3, (size_t)64, (size_t)1460, (size_t)16384 })
+	{
+		auto frames = Replay(response, rng, maxRead);
+		CHECK(frames == reference);
+	}
+
+	printf("%s: %zu chunk(s), %zu frame(s)\n", path.filename().string().c_str(), response.chunks.size(), reference.size());
+	if (response.expectedFrames >= 0)
+	{
+		CHECK(reference.size() == (size_t)response.expectedFrames);
+		for (const auto& frame : reference)
+		{
+			CHECK(IsJpeg(frame));
+		}
+	}
+}
+
+// Random edits of a response: flipped, inserted, deleted and duplicated bytes, in the headers too
+static std::vector<BYTE> Mutate(std::vector<BYTE> bytes, std::mt19937& rng)
+{
+	std::uniform_int_distribution<int> edits(1, 8);
+	for (int count = edits(rng); count > 0 && !bytes.empty(); count--)
+	{
+		std::uniform_int_distribution<size_t> position(0, bytes.size() - 1);
+		auto pos = position(rng);
+		auto len = std::min<size_t>(std::uniform_int_distribution<size_t>(1, 64)(rng), bytes.size() - pos);
+		switch (rng() % 5)
+		{
+		case 0:
+			bytes[pos] ^= (BYTE)(1 << (rng() % 8));
+			break;
+		case 1:
+			bytes[pos] = (rng() & 1) ? 0xFF : (BYTE)rng();
+			break;
+		case 2:
+			bytes.erase(bytes.begin() + pos, bytes.begin() + pos + len);
+			break;
+		case 3:
+			bytes.insert(bytes.begin() + pos, len, (BYTE)rng());
+			break;
+		default:
+		{
+			std::vector<BYTE> copy(bytes.begin() + pos, bytes.begin() + pos + len);
+			bytes.insert(bytes.begin() + position(rng), copy.begin(), copy.end());
+			break;
+		}
+		}
+	}
+	return bytes;
+}
+
+// SplitterReplay <corpus directory> [mutations per file]
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: SplitterReplay <corpus directory> [mutations per file]\n");
+		return 2;
+	}
+
+	const int mutations = argc > 2 ? atoi(argv[2]) : 200;
+	std::mt19937 rng(TestSeed());
+	const auto paths = CorpusFiles(argv[1]);
+	CHECK(!paths.empty());
+
+	for (const auto& path : paths)
+	{
+		ReplayFile(path, rng);
+		auto bytes = ReadFileBytes(path);
+		for (int i = 0; i < mutations; i++)
+		{
+			auto mutated = Mutate(bytes, rng);
+			Fuzz(mutated.data(), mutated.size(), rng);
+		}
+	}
+	printf("%d failure(s)\n", CheckFailures());
+	return CheckFailures() ? 1 : 0;
+}
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+// Smooth synthetic pictures for the quality checks: each sample is a function of where the pixel's center is in
+// the picture, so the same picture can be drawn at any size and a scaled copy compared to one drawn at the
+// target size. A low frequency wave and a chirp whose frequency grows to maxFrequency cycles per picture width
+// at the right and bottom edges; keep that under the Nyquist frequency of both sizes.
+inline double PatternValue(double u, double v, UINT channel, double maxFrequency)
+{
+	const double pi = 3.14159265358979323846;
+	return 128 + 45 * sin(2 * pi * (3 * u + 2 * v + channel * 0.25)) + 45 * sin(pi * maxFrequency * (u * u + 0.5 * v * v) + channel);
+}
+
+// Picture of width x height pixels of channels interleaved bytes, at stride
+inline std::vector<BYTE> DrawPattern(UINT width, UINT height, UINT channels, size_t stride, double maxFrequency)
+{
+	std::vector<BYTE> pixels(stride * height);
+	for (UINT y = 0; y < height; y++)
+	{
+		for (UINT x = 0; x < width; x++)
+		{
+			for (UINT c = 0; c < channels; c++)
+			{
+				pixels[y * stride + (size_t)x * channels + c] = (BYTE)lround(PatternValue((x + 0.5) / width, (y + 0.5) / height, c, maxFrequency));
+			}
+		}
+	}
+	return pixels;
+}
+
+// Peak signal to noise ratio in dB of rowBytes wide rows, 99 for identical pictures
+inline double Psnr(const BYTE* a, size_t aStride, const BYTE* b, size_t bStride, size_t rowBytes, size_t rows)
+{
+	double sum = 0;
+	for (size_t y = 0; y < rows; y++)
+	{
+		for (size_t x = 0; x < rowBytes; x++)
+		{
+			const double d = (double)a[y * aStride + x] - b[y * bStride + x];
+			sum += d * d;
+		}
+	}
+	return sum ? 10 * log10(255.0 * 255.0 * rowBytes * rows / sum) : 99.0;
+}
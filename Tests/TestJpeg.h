@@ -0,0 +1,62 @@
+#pragma once
+
+#include <random>
+#include <vector>
+
+// Synthetic JPEGs with the structure the splitter walks: APP0, optionally an APP1 EXIF block carrying a
+// thumbnail with its own SOI/EOI, tables whose payloads contain 0xFF bytes, a frame header, and entropy-coded
+// data with stuffed 0xFF 0x00 pairs, fill bytes and restart markers. They don't decode to a picture.
+inline void AppendSegment(std::vector<BYTE>& jpeg, BYTE marker, const std::vector<BYTE>& payload)
+{
+	const auto len = payload.size() + 2;
+	jpeg.insert(jpeg.end(), { 0xFF, marker, (BYTE)(len >> 8), (BYTE)len });
+	jpeg.insert(jpeg.end(), payload.begin(), payload.end());
+}
+
+inline void AppendEntropy(std::vector<BYTE>& jpeg, std::mt19937& rng, size_t size)
+{
+	std::uniform_int_distribution<int> byte(0, 255);
+	for (size_t i = 0; i < size; i++)
+	{
+		auto b = (BYTE)byte(rng);
+		jpeg.push_back(b);
+		if (b == 0xFF)
+		{
+			// stuffed zero, now and then a restart marker or a fill byte instead
+			static const BYTE follow[] = { 0x00, 0x00, 0x00, 0x00, 0xD0, 0xD5, 0xFF };
+			auto next = follow[byte(rng) % sizeof(follow)];
+			jpeg.push_back(next);
+			if (next == 0xFF)
+			{
+				jpeg.push_back(0x00);
+			}
+		}
+	}
+}
+
+inline std::vector<BYTE> MakeTestJpeg(std::mt19937& rng, UINT width, UINT height, size_t entropySize, bool thumbnail)
+{
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::vector<BYTE> jpeg{ 0xFF, 0xD8 };
+	AppendSegment(jpeg, 0xE0, { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 });
+	if (thumbnail)
+	{
+		std::vector<BYTE> exif{ 'E', 'x', 'i', 'f', 0, 0, 'I', 'I', 42, 0 };
+		auto thumb = MakeTestJpeg(rng, 160, 120, 300, false);
+		exif.insert(exif.end(), thumb.begin(), thumb.end());
+		AppendSegment(jpeg, 0xE1, exif);
+	}
+
+	std::vector<BYTE> table{ 0 };
+	for (int i = 0; i < 64; i++)
+	{
+		table.push_back(i % 9 ? (BYTE)byte(rng) : 0xFF); // 0xFF inside a segment isn't a marker
+	}
+	AppendSegment(jpeg, 0xDB, table);
+	AppendSegment(jpeg, 0xC0, { 8, (BYTE)(height >> 8), (BYTE)height, (BYTE)(width >> 8), (BYTE)width, 3, 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1 });
+	AppendSegment(jpeg, 0xC4, { 0x00, 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 1, 2, 3 });
+	AppendSegment(jpeg, 0xDA, { 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 });
+	AppendEntropy(jpeg, rng, entropySize);
+	jpeg.insert(jpeg.end(), { 0xFF, 0xD9 });
+	return jpeg;
+}
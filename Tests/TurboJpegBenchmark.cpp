@@ -0,0 +1,94 @@
+#include "pch.h"
+#include "TurboJpegDecoder.h"
+#include "CorpusResponse.h"
+#include "LibJpegDecoder.h"
+#include <chrono>
+#include <cstdio>
+
+// Times the TurboJPEG backend side by side with libjpeg's own API, which is how most decoders (WIC's included)
+// run the IDCT and color conversion, for each JPEG of a corpus at full size and each IDCT scale: to BGRA, and to
+// NV12 for 4:2:0 JPEGs. Not a test, run it by hand: TurboJpegBenchmark Corpus/Jpeg [milliseconds per measurement]
+
+template<typename Fn>
+static double Measure(Fn decode, int milliseconds)
+{
+	// best of several runs of as many decodes as fit the time, the minimum is what the code can do
+	using clock = std::chrono::steady_clock;
+	double best = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		int count = 0;
+		const auto start = clock::now();
+		auto elapsed = clock::duration::zero();
+		do
+		{
+			decode();
+			count++;
+			elapsed = clock::now() - start;
+		} while (elapsed < std::chrono::milliseconds(milliseconds) / 5);
+		best = std::min(best, std::chrono::duration<double, std::milli>(elapsed).count() / count);
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: TurboJpegBenchmark corpus-directory [milliseconds]\n");
+		return 2;
+	}
+	const int milliseconds = argc > 2 ? atoi(argv[2]) : 500;
+
+	LibJpegDecoder libjpeg;
+	TurboJpegDecoder turbo(&libjpeg);
+	printf("%-28s %5s %11s %6s %11s %9s %7s\n", "file", "scale", "size", "output", "libjpeg ms", "turbo ms", "speedup");
+	for (const auto& path : CorpusFiles(argv[1], ".jpg"))
+	{
+		const auto jpeg = ReadFileBytes(path);
+		FrameBuffer buffer;
+		UINT w = 0, h = 0, stride = 0;
+		if (FAILED(libjpeg.Decode(jpeg.data(), jpeg.size(), 0, 0, buffer, &w, &h, &stride)))
+			continue;
+
+		for (UINT denom = 1; denom <= 8; denom *= 2)
+		{
+			const UINT width = (w + denom - 1) / denom;
+			const UINT height = (h + denom - 1) / denom;
+			auto bgra = [&](JpegDecoder& decoder)
+			{
+				return Measure([&]
+				{
+					UINT bw = 0, bh = 0, bstride = 0;
+					decoder.Decode(jpeg.data(), jpeg.size(), width, height, buffer, &bw, &bh, &bstride);
+				}, milliseconds);
+			};
+			const double libjpegBgra = bgra(libjpeg);
+			const double turboBgra = bgra(turbo);
+			printf("%-28s %3s%-2u %5ux%-5u %6s %11.3f %9.3f %7.2f\n", path.filename().string().c_str(), "1/", denom, width, height, "BGRA", libjpegBgra, turboBgra, libjpegBgra / turboBgra);
+
+			if (libjpeg.DecodeNV12(jpeg.data(), jpeg.size(), width, height, buffer) != S_OK ||
+				turbo.DecodeNV12(jpeg.data(), jpeg.size(), width, height, buffer) != S_OK)
+				continue;
+
+			auto nv12 = [&](JpegDecoder& decoder)
+			{
+				return Measure([&]
+				{
+					decoder.DecodeNV12(jpeg.data(), jpeg.size(), width, height, buffer);
+				}, milliseconds);
+			};
+			const double libjpegNv12 = nv12(libjpeg);
+			const double turboNv12 = nv12(turbo);
+			printf("%-28s %3s%-2u %5ux%-5u %6s %11.3f %9.3f %7.2f\n", path.filename().string().c_str(), "1/", denom, width, height, "NV12", libjpegNv12, turboNv12, libjpegNv12 / turboNv12);
+		}
+	}
+
+	// EXIF JPEGs go to the fallback, counted there only
+	const auto turboStats = turbo.GetStats();
+	const auto libjpegStats = libjpeg.GetStats();
+	printf("\nframes: libjpeg %llu BGRA %llu NV12, turbo %llu BGRA %llu NV12\n", (unsigned long long)libjpegStats.frames, (unsigned long long)libjpegStats.nv12Frames,
+		(unsigned long long)turboStats.frames, (unsigned long long)turboStats.nv12Frames);
+	FrameBufferPool::Instance().Trim(); // for the leak checker
+	return 0;
+}
@@ -0,0 +1,95 @@
+#include "pch.h"
+#include "UploadSlots.h"
+#include "Check.h"
+
+// UploadSlots: which bitmap a frame is drawn from and when it has to be created or uploaded
+
+static bool Is(const UploadSlots::Plan& plan, UINT slot, bool create, bool upload)
+{
+	return plan.slot == slot && plan.create == create && plan.upload == upload;
+}
+
+static void TestSameFrame()
+{
+	// a frame drawn again, as when Generate runs faster than the camera, needs no upload
+	UploadSlots slots;
+	auto first = slots.Next(640, 480, 1);
+	CHECK(first.create && first.upload);
+	for (int i = 0; i < 3; i++)
+	{
+		CHECK(Is(slots.Next(640, 480, 1), first.slot, false, false));
+	}
+}
+
+static void TestAlternating()
+{
+	// new frames go to the slots in turn, never to the one drawn from last; each slot is created once
+	UploadSlots slots;
+	UINT previous = UploadSlots::Count;
+	for (ULONGLONG sequence = 1; sequence <= 8; sequence++)
+	{
+		auto plan = slots.Next(1920, 1080, sequence);
+		CHECK(plan.slot < UploadSlots::Count && plan.slot != previous);
+		CHECK(plan.upload);
+		CHECK(plan.create == (sequence <= UploadSlots::Count));
+		previous = plan.slot;
+	}
+}
+
+static void TestSizeChange()
+{
+	// only a size change recreates a slot, and each slot is recreated when its turn comes
+	UploadSlots slots;
+	slots.Next(640, 480, 1);
+	slots.Next(640, 480, 2);
+	CHECK(!slots.Next(640, 480, 3).create);
+	CHECK(slots.Next(1280, 720, 4).create);
+	CHECK(slots.Next(1280, 720, 5).create);
+	CHECK(!slots.Next(1280, 720, 6).create);
+	auto portrait = slots.Next(720, 1280, 7);
+	CHECK(portrait.create); // same area, other shape
+
+	// a size that doesn't match the bitmap drawn last is never drawn from it, whatever the sequence; the other
+	// slot still has that size
+	CHECK(Is(slots.Next(1280, 720, 7), 1 - portrait.slot, false, true));
+}
+
+static void TestInvalidate()
+{
+	// a slot whose create or upload failed holds nothing: the frame is uploaded again, into a new bitmap
+	UploadSlots slots;
+	slots.Next(640, 480, 1);
+	auto plan = slots.Next(640, 480, 2);
+	slots.Invalidate(plan.slot);
+	auto retry = slots.Next(640, 480, 2);
+	CHECK(retry.upload && retry.slot != plan.slot);
+	CHECK(!retry.create);
+
+	auto again = slots.Next(640, 480, 3);
+	CHECK(Is(again, plan.slot, true, true));
+}
+
+static void TestReset()
+{
+	// new render target: every slot is created again, and a frame already uploaded is uploaded again
+	UploadSlots slots;
+	slots.Next(640, 480, 1);
+	slots.Next(640, 480, 2);
+	slots.Reset();
+	auto first = slots.Next(640, 480, 2);
+	CHECK(first.create && first.upload);
+	auto second = slots.Next(640, 480, 3);
+	CHECK(second.create && second.upload && second.slot != first.slot);
+	CHECK(Is(slots.Next(640, 480, 4), first.slot, false, true));
+}
+
+int main()
+{
+	TestSameFrame();
+	TestAlternating();
+	TestSizeChange();
+	TestInvalidate();
+	TestReset();
+	printf("%d failure(s)\n", CheckFailures());
+	return CheckFailures() ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+#include "pch.h"
+#include "VideoModes.h"
+#include "Check.h"
+
+// VideoModes: the default ladder under the configured size, with widths at its aspect ratio rounded to the nearest
+// even number, and the Resolutions and FrameRates registry lists, where anything odd, out of range, repeated or
+// unparseable is skipped and the rest keeps its order.
+
+static bool Equal(const std::vector<VideoModes::Size>& sizes, std::initializer_list<VideoModes::Size> expected)
+{
+	return std::equal(sizes.begin(), sizes.end(), expected.begin(), expected.end(), [](const VideoModes::Size& a, const VideoModes::Size& b)
+	{
+		return a.width == b.width && a.height == b.height;
+	});
+}
+
+static bool Equal(const std::vector<UINT>& rates, std::initializer_list<UINT> expected)
+{
+	return std::equal(rates.begin(), rates.end(), expected.begin(), expected.end());
+}
+
+static void TestDefault()
+{
+	auto modes = VideoModes::Default(1920, 1080);
+	CHECK(Equal(modes.sizes, { { 1920, 1080 }, { 1280, 720 }, { 960, 540 }, { 640, 360 } }));
+	CHECK(Equal(modes.rates, { 30, 60, 24, 15 }));
+
+	// 4K gets the whole ladder
+	CHECK(Equal(VideoModes::Default(4096, 2160).sizes, { { 4096, 2160 }, { 2730, 1440 }, { 2048, 1080 }, { 1366, 720 }, { 1024, 540 }, { 682, 360 } }));
+
+	// 1923.84, 1442.88 and 961.92 wide: the nearest even widths, not the truncated ones
+	CHECK(Equal(VideoModes::Default(2672, 1000).sizes, { { 2672, 1000 }, { 1924, 720 }, { 1442, 540 }, { 962, 360 } }));
+
+	// nothing under 360
+	CHECK(Equal(VideoModes::Default(640, 360).sizes, { { 640, 360 } }));
+	CHECK(Equal(VideoModes::Default(320, 240).sizes, { { 320, 240 } }));
+
+	// so narrow the ladder's widths round to nothing
+	CHECK(Equal(VideoModes::Default(2, 8000).sizes, { { 2, 8000 } }));
+}
+
+static void TestDefaultConfiguredSize()
+{
+	// odd sizes lose a row or column, the 4:2:0 formats can't have them
+	CHECK(Equal(VideoModes::Default(1281, 721).sizes, { { 1280, 720 }, { 960, 540 }, { 640, 360 } }));
+	CHECK(Equal(VideoModes::Default(641, 360).sizes, { { 640, 360 } }));
+	CHECK(Equal(VideoModes::Default(640, 361).sizes, { { 640, 360 } }));
+
+	// empty or too large: 1080p
+	for (auto size : { VideoModes::Size{ 0, 0 }, { 0, 720 }, { 1280, 0 }, { 1, 1 }, { 1, 720 }, { 8194, 4320 }, { 4096, 8194 } })
+	{
+		CHECK(Equal(VideoModes::Default(size.width, size.height).sizes, { { 1920, 1080 }, { 1280, 720 }, { 960, 540 }, { 640, 360 } }));
+	}
+	CHECK(VideoModes::Default(8192, 8192).sizes[0].width == 8192);
+}
+
+static void TestParseSizes()
+{
+	CHECK(Equal(VideoModes::ParseSizes(L"1920x1080,1280x720"), { { 1920, 1080 }, { 1280, 720 } }));
+	CHECK(Equal(VideoModes::ParseSizes(L"640x480, 1280X720"), { { 640, 480 }, { 1280, 720 } }));
+	CHECK(Equal(VideoModes::ParseSizes(L"8192x8192,2x2"), { { 8192, 8192 }, { 2, 2 } }));
+
+	// odd
+	CHECK(Equal(VideoModes::ParseSizes(L"1281x720,640x481,640x480"), { { 640, 480 } }));
+
+	// repeated
+	CHECK(Equal(VideoModes::ParseSizes(L"640x480,320x240,640x480,320x240"), { { 640, 480 }, { 320, 240 } }));
+
+	// out of range, including values that don't fit 32 bits
+	CHECK(Equal(VideoModes::ParseSizes(L"0x0,0x480,640x0,8194x4320,4320x8194,-640x480,640x-480,4294967298x2,2x4294967298,640x480"), { { 640, 480 } }));
+
+	// garbage
+	CHECK(VideoModes::ParseSizes(nullptr).empty());
+	CHECK(VideoModes::ParseSizes(L"").empty());
+	CHECK(VideoModes::ParseSizes(L",,,").empty());
+	CHECK(VideoModes::ParseSizes(L"hd,x480,640x,640*480,640 x 480,1080p").empty());
+	CHECK(Equal(VideoModes::ParseSizes(L"abc,,1280x720,,"), { { 1280, 720 } }));
+}
+
+static void TestParseRates()
+{
+	CHECK(Equal(VideoModes::ParseRates(L"30,15"), { 30, 15 }));
+	CHECK(Equal(VideoModes::ParseRates(L" 60, 24 ,5"), { 60, 24, 5 }));
+	CHECK(Equal(VideoModes::ParseRates(L"0,241,240,1,30,30,-5,4294967326,60"), { 240, 1, 30, 60 }));
+
+	CHECK(VideoModes::ParseRates(nullptr).empty());
+	CHECK(VideoModes::ParseRates(L"").empty());
+	CHECK(VideoModes::ParseRates(L"fast,,x").empty());
+}
+
+int main()
+{
+	TestDefault();
+	TestDefaultConfiguredSize();
+	TestParseSizes();
+	TestParseRates();
+	printf("%d failure(s)\n", CheckFailures());
+	return CheckFailures() ? 1 : 0;
+}
@@ -14,6 +14,13 @@ struct CameraConfig
 	UINT width;
 	UINT height;
 	bool enabled;
+	DWORD asyncTransport = 1; // not editable in the UI, preserved across saves
+	DWORD snapshot = 0;
+	DWORD jpegDecoder = 0;
+	DWORD scaleFilter = 0;
+	DWORD fitMode = 0;
+	std::wstring resolutions; // advertised sizes and frame rates, empty for the source's defaults
+	std::wstring frameRates;
 };
 
 HINSTANCE _instance;
@@ -174,6 +181,52 @@ HRESULT LoadCamerasFromRegistry()
 						camera.enabled = true;
 					}
 			
+			// Read transport selection
+			dataSize = sizeof(DWORD);
+			DWORD asyncTransport = 1;
+			if (RegQueryValueExW(hCameraKey, L"AsyncTransport", nullptr, nullptr, (LPBYTE)&asyncTransport, &dataSize) == ERROR_SUCCESS)
+			{
+				camera.asyncTransport = asyncTransport;
+			}
+			dataSize = sizeof(DWORD);
+			DWORD snapshot = 0;
+			if (RegQueryValueExW(hCameraKey, L"Snapshot", nullptr, nullptr, (LPBYTE)&snapshot, &dataSize) == ERROR_SUCCESS)
+			{
+				camera.snapshot = snapshot;
+			}
+			dataSize = sizeof(DWORD);
+			DWORD jpegDecoder = 0;
+			if (RegQueryValueExW(hCameraKey, L"JpegDecoder", nullptr, nullptr, (LPBYTE)&jpegDecoder, &dataSize) == ERROR_SUCCESS)
+			{
+				camera.jpegDecoder = jpegDecoder;
+			}
+			dataSize = sizeof(DWORD);
+			DWORD scaleFilter = 0;
+			if (RegQueryValueExW(hCameraKey, L"ScaleFilter", nullptr, nullptr, (LPBYTE)&scaleFilter, &dataSize) == ERROR_SUCCESS)
+			{
+				camera.scaleFilter = scaleFilter;
+			}
+			dataSize = sizeof(DWORD);
+			DWORD fitMode = 0;
+			if (RegQueryValueExW(hCameraKey, L"FitMode", nullptr, nullptr, (LPBYTE)&fitMode, &dataSize) == ERROR_SUCCESS)
+			{
+				camera.fitMode = fitMode;
+			}
+
+			// Read advertised modes
+			std::vector<WCHAR> listBuffer(512);
+			dataSize = (DWORD)((listBuffer.size() - 1) * sizeof(WCHAR));
+			if (RegQueryValueExW(hCameraKey, L"Resolutions", nullptr, nullptr, (LPBYTE)listBuffer.data(), &dataSize) == ERROR_SUCCESS)
+			{
+				camera.resolutions = listBuffer.data();
+			}
+			std::fill(listBuffer.begin(), listBuffer.end(), L'\0');
+			dataSize = (DWORD)((listBuffer.size() - 1) * sizeof(WCHAR));
+			if (RegQueryValueExW(hCameraKey, L"FrameRates", nullptr, nullptr, (LPBYTE)listBuffer.data(), &dataSize) == ERROR_SUCCESS)
+			{
+				camera.frameRates = listBuffer.data();
+			}
+			
 			// Read Friendly Name
 			dataSize = 256 * sizeof(WCHAR);
 			std::vector<WCHAR> nameBuffer(256);
@@ -231,6 +284,23 @@ HRESULT SaveCamerasToRegistry()
 			// Save Enabled flag
 			DWORD enabled = camera.enabled ? 1 : 0;
 			RegSetValueExW(hKey, L"Enabled", 0, REG_DWORD, (LPBYTE)&enabled, sizeof(DWORD));
+
+			// Save transport selection
+			RegSetValueExW(hKey, L"AsyncTransport", 0, REG_DWORD, (LPBYTE)&camera.asyncTransport, sizeof(DWORD));
+			RegSetValueExW(hKey, L"Snapshot", 0, REG_DWORD, (LPBYTE)&camera.snapshot, sizeof(DWORD));
+			RegSetValueExW(hKey, L"JpegDecoder", 0, REG_DWORD, (LPBYTE)&camera.jpegDecoder, sizeof(DWORD));
+			RegSetValueExW(hKey, L"ScaleFilter", 0, REG_DWORD, (LPBYTE)&camera.scaleFilter, sizeof(DWORD));
+			RegSetValueExW(hKey, L"FitMode", 0, REG_DWORD, (LPBYTE)&camera.fitMode, sizeof(DWORD));
+
+			// Save advertised modes, absent means the source's defaults
+			if (!camera.resolutions.empty())
+			{
+				RegSetValueExW(hKey, L"Resolutions", 0, REG_SZ, (LPBYTE)camera.resolutions.c_str(), (DWORD)((camera.resolutions.length() + 1) * sizeof(WCHAR)));
+			}
+			if (!camera.frameRates.empty())
+			{
+				RegSetValueExW(hKey, L"FrameRates", 0, REG_SZ, (LPBYTE)camera.frameRates.c_str(), (DWORD)((camera.frameRates.length() + 1) * sizeof(WCHAR)));
+			}
 		}
 		else
 		{
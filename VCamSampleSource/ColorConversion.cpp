@@ -0,0 +1,506 @@
+#include "pch.h"
+#include "ColorConversion.h"
+#include "SlicePool.h"
+#include "CpuFeatures.h"
+#include <cmath>
+#if defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+// 14-bit fixed point coefficients, laid out B, G, R, A (A is always 0) to match the pixels in memory
+struct YuvCoefficients
+{
+	INT16 y[4];
+	INT16 u[4];
+	INT16 v[4];
+	int yOffset; // luma offset plus rounding, at 14 bits
+};
+
+static const int ChromaOffset = (128 << 16) + (1 << 15); // chroma is computed from 4 pixel sums, at 16 bits
+
+static YuvCoefficients MakeCoefficients(double kr, double kb, bool full)
+{
+	const double one = 1 << 14;
+	const double ys = full ? 1.0 : 219.0 / 255.0;
+	const double cs = full ? 1.0 : 224.0 / 255.0;
+
+	YuvCoefficients c{};
+	c.y[0] = (INT16)lround(ys * kb * one);
+	c.y[2] = (INT16)lround(ys * kr * one);
+	c.y[1] = (INT16)(lround(ys * one) - c.y[0] - c.y[2]); // white stays exactly white
+
+	c.u[0] = (INT16)lround(cs * 0.5 * one);
+	c.u[2] = (INT16)lround(-cs * 0.5 * kr / (1.0 - kb) * one);
+	c.u[1] = (INT16)(-c.u[0] - c.u[2]); // grays stay exactly neutral
+
+	c.v[2] = (INT16)lround(cs * 0.5 * one);
+	c.v[0] = (INT16)lround(-cs * 0.5 * kb / (1.0 - kr) * one);
+	c.v[1] = (INT16)(-c.v[0] - c.v[2]);
+
+	c.yOffset = ((full ? 0 : 16) << 14) + (1 << 13);
+	return c;
+}
+
+static const YuvCoefficients& GetCoefficients(YuvMatrix matrix, YuvRange range)
+{
+	static const YuvCoefficients table[2][2] =
+	{
+		{ MakeCoefficients(0.299, 0.114, false), MakeCoefficients(0.299, 0.114, true) },
+		{ MakeCoefficients(0.2126, 0.0722, false), MakeCoefficients(0.2126, 0.0722, true) },
+	};
+	return table[matrix == YuvMatrix::BT709][range == YuvRange::Full];
+}
+
+static inline BYTE Clamp(int value)
+{
+	return (BYTE)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+static inline BYTE Luma(const BYTE* p, const YuvCoefficients& c)
+{
+	return Clamp((c.y[0] * p[0] + c.y[1] * p[1] + c.y[2] * p[2] + c.yOffset) >> 14);
+}
+
+// Converts a pair of rows from column x on. row1 can be row0 (and y1 y0) for the last row of an odd height,
+// the chroma then only averages horizontally.
+static void ConvertRowPairScalar(const BYTE* row0, const BYTE* row1, BYTE* y0, BYTE* y1, BYTE* uv, UINT x, UINT width, const YuvCoefficients& c)
+{
+	for (; x < width; x += 2)
+	{
+		auto p0 = row0 + x * 4;
+		auto p1 = row1 + x * 4;
+		y0[x] = Luma(p0, c);
+		y1[x] = Luma(p1, c);
+
+		int b = p0[0] + p1[0];
+		int g = p0[1] + p1[1];
+		int r = p0[2] + p1[2];
+		if (x + 1 < width)
+		{
+			y0[x + 1] = Luma(p0 + 4, c);
+			y1[x + 1] = Luma(p1 + 4, c);
+			b += p0[4] + p1[4];
+			g += p0[5] + p1[5];
+			r += p0[6] + p1[6];
+		}
+		else
+		{
+			// last column of an odd width, weigh the pixels there are as a full block
+			b *= 2;
+			g *= 2;
+			r *= 2;
+		}
+
+		uv[x] = Clamp((c.u[0] * b + c.u[1] * g + c.u[2] * r + ChromaOffset) >> 16);
+		uv[x + 1] = Clamp((c.v[0] * b + c.v[1] * g + c.v[2] * r + ChromaOffset) >> 16);
+	}
+}
+
+// Vector kernels convert as many columns as fit their width and return where the scalar code should take over
+typedef UINT(*ConvertRowPairFn)(const BYTE* row0, const BYTE* row1, BYTE* y0, BYTE* y1, BYTE* uv, UINT width, const YuvCoefficients& c);
+
+static UINT ConvertRowPairNone(const BYTE*, const BYTE*, BYTE*, BYTE*, BYTE*, UINT, const YuvCoefficients&)
+{
+	return 0;
+}
+
+#if defined(_M_X64) || defined(_M_IX86)
+static inline __m128i LumaSse41(__m128i pixels, __m128i coefficients, __m128i offset)
+{
+	// 4 pixels in, 4 32-bit lumas out
+	auto lo = _mm_madd_epi16(_mm_cvtepu8_epi16(pixels), coefficients);
+	auto hi = _mm_madd_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(pixels, 8)), coefficients);
+	return _mm_srai_epi32(_mm_add_epi32(_mm_hadd_epi32(lo, hi), offset), 14);
+}
+
+static inline __m128i BlockSumsSse41(__m128i pixels0, __m128i pixels1)
+{
+	// 4 pixels of two rows in, 2 sums of 2x2 blocks out as 16-bit B, G, R, A
+	auto s01 = _mm_add_epi16(_mm_cvtepu8_epi16(pixels0), _mm_cvtepu8_epi16(pixels1));
+	auto s23 = _mm_add_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(pixels0, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(pixels1, 8)));
+	return _mm_add_epi16(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+}
+
+static UINT ConvertRowPairSse41(const BYTE* row0, const BYTE* row1, BYTE* y0, BYTE* y1, BYTE* uv, UINT width, const YuvCoefficients& c)
+{
+	const auto yc = _mm_set_epi16(c.y[3], c.y[2], c.y[1], c.y[0], c.y[3], c.y[2], c.y[1], c.y[0]);
+	const auto uc = _mm_set_epi16(c.u[3], c.u[2], c.u[1], c.u[0], c.u[3], c.u[2], c.u[1], c.u[0]);
+	const auto vc = _mm_set_epi16(c.v[3], c.v[2], c.v[1], c.v[0], c.v[3], c.v[2], c.v[1], c.v[0]);
+	const auto yOffset = _mm_set1_epi32(c.yOffset);
+	const auto uvOffset = _mm_set1_epi32(ChromaOffset);
+
+	UINT x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		auto a0 = _mm_loadu_si128((const __m128i*)(row0 + x * 4));
+		auto b0 = _mm_loadu_si128((const __m128i*)(row0 + x * 4 + 16));
+		auto a1 = _mm_loadu_si128((const __m128i*)(row1 + x * 4));
+		auto b1 = _mm_loadu_si128((const __m128i*)(row1 + x * 4 + 16));
+
+		auto luma0 = _mm_packs_epi32(LumaSse41(a0, yc, yOffset), LumaSse41(b0, yc, yOffset));
+		auto luma1 = _mm_packs_epi32(LumaSse41(a1, yc, yOffset), LumaSse41(b1, yc, yOffset));
+		_mm_storel_epi64((__m128i*)(y0 + x), _mm_packus_epi16(luma0, luma0));
+		_mm_storel_epi64((__m128i*)(y1 + x), _mm_packus_epi16(luma1, luma1));
+
+		auto sa = BlockSumsSse41(a0, a1);
+		auto sb = BlockSumsSse41(b0, b1);
+		auto u = _mm_srai_epi32(_mm_add_epi32(_mm_hadd_epi32(_mm_madd_epi16(sa, uc), _mm_madd_epi16(sb, uc)), uvOffset), 16);
+		auto v = _mm_srai_epi32(_mm_add_epi32(_mm_hadd_epi32(_mm_madd_epi16(sa, vc), _mm_madd_epi16(sb, vc)), uvOffset), 16);
+		auto chroma = _mm_packs_epi32(_mm_unpacklo_epi32(u, v), _mm_unpackhi_epi32(u, v));
+		_mm_storel_epi64((__m128i*)(uv + x), _mm_packus_epi16(chroma, chroma));
+	}
+	return x;
+}
+
+static inline __m256i LumaAvx2(__m256i pixels, __m256i coefficients, __m256i offset, __m256i order)
+{
+	// 8 pixels in, 8 32-bit lumas out; hadd works within 128-bit lanes, the permute puts them back in order
+	auto lo = _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(pixels)), coefficients);
+	auto hi = _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(pixels, 1)), coefficients);
+	return _mm256_srai_epi32(_mm256_add_epi32(_mm256_permutevar8x32_epi32(_mm256_hadd_epi32(lo, hi), order), offset), 14);
+}
+
+static inline __m256i BlockSumsAvx2(__m256i pixels0, __m256i pixels1)
+{
+	// 8 pixels of two rows in, 4 sums of 2x2 blocks out, lanes hold blocks 0, 2 and 1, 3
+	auto s03 = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(pixels0)), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(pixels1)));
+	auto s47 = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(pixels0, 1)), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(pixels1, 1)));
+	return _mm256_add_epi16(_mm256_unpacklo_epi64(s03, s47), _mm256_unpackhi_epi64(s03, s47));
+}
+
+static inline __m256i Pack16Avx2(__m256i lo, __m256i hi)
+{
+	// 16 ordered 32-bit values in, 16 saturated bytes in the low 128 bits out
+	auto words = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+	return _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0x08);
+}
+
+static UINT ConvertRowPairAvx2(const BYTE* row0, const BYTE* row1, BYTE* y0, BYTE* y1, BYTE* uv, UINT width, const YuvCoefficients& c)
+{
+	const auto yc = _mm256_setr_epi16(c.y[0], c.y[1], c.y[2], c.y[3], c.y[0], c.y[1], c.y[2], c.y[3], c.y[0], c.y[1], c.y[2], c.y[3], c.y[0], c.y[1], c.y[2], c.y[3]);
+	const auto uc = _mm256_setr_epi16(c.u[0], c.u[1], c.u[2], c.u[3], c.u[0], c.u[1], c.u[2], c.u[3], c.u[0], c.u[1], c.u[2], c.u[3], c.u[0], c.u[1], c.u[2], c.u[3]);
+	const auto vc = _mm256_setr_epi16(c.v[0], c.v[1], c.v[2], c.v[3], c.v[0], c.v[1], c.v[2], c.v[3], c.v[0], c.v[1], c.v[2], c.v[3], c.v[0], c.v[1], c.v[2], c.v[3]);
+	const auto yOffset = _mm256_set1_epi32(c.yOffset);
+	const auto uvOffset = _mm256_set1_epi32(ChromaOffset);
+	const auto lumaOrder = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+	const auto chromaOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	UINT x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		auto a0 = _mm256_loadu_si256((const __m256i*)(row0 + x * 4));
+		auto b0 = _mm256_loadu_si256((const __m256i*)(row0 + x * 4 + 32));
+		auto a1 = _mm256_loadu_si256((const __m256i*)(row1 + x * 4));
+		auto b1 = _mm256_loadu_si256((const __m256i*)(row1 + x * 4 + 32));
+
+		auto luma0 = Pack16Avx2(LumaAvx2(a0, yc, yOffset, lumaOrder), LumaAvx2(b0, yc, yOffset, lumaOrder));
+		auto luma1 = Pack16Avx2(LumaAvx2(a1, yc, yOffset, lumaOrder), LumaAvx2(b1, yc, yOffset, lumaOrder));
+		_mm_storeu_si128((__m128i*)(y0 + x), _mm256_castsi256_si128(luma0));
+		_mm_storeu_si128((__m128i*)(y1 + x), _mm256_castsi256_si128(luma1));
+
+		auto sa = BlockSumsAvx2(a0, a1);
+		auto sb = BlockSumsAvx2(b0, b1);
+		auto u = _mm256_hadd_epi32(_mm256_madd_epi16(sa, uc), _mm256_madd_epi16(sb, uc));
+		auto v = _mm256_hadd_epi32(_mm256_madd_epi16(sa, vc), _mm256_madd_epi16(sb, vc));
+		u = _mm256_srai_epi32(_mm256_add_epi32(_mm256_permutevar8x32_epi32(u, chromaOrder), uvOffset), 16);
+		v = _mm256_srai_epi32(_mm256_add_epi32(_mm256_permutevar8x32_epi32(v, chromaOrder), uvOffset), 16);
+
+		// interleaving within lanes gives U0 V0 .. U3 V3 in the low halves and U4 V4 .. U7 V7 in the high ones,
+		// packing the two keeps that order without the permute Pack16Avx2 needs
+		auto chroma = _mm256_packs_epi32(_mm256_unpacklo_epi32(u, v), _mm256_unpackhi_epi32(u, v));
+		chroma = _mm256_permute4x64_epi64(_mm256_packus_epi16(chroma, chroma), 0x08);
+		_mm_storeu_si128((__m128i*)(uv + x), _mm256_castsi256_si128(chroma));
+	}
+	return x;
+}
+#endif
+
+// YUY2: one row at a time, Y0 U Y1 V per pair of pixels. The chroma of a pair is computed as that of a 2x2 block
+// made of the pair twice, which is what the coefficients are scaled for.
+static void ConvertRowYuy2Scalar(const BYTE* row, BYTE* out, UINT x, UINT width, const YuvCoefficients& c)
+{
+	for (; x < width; x += 2)
+	{
+		auto p0 = row + x * 4;
+		auto p1 = x + 1 < width ? p0 + 4 : p0; // last column of an odd width, repeated
+		int b = 2 * (p0[0] + p1[0]);
+		int g = 2 * (p0[1] + p1[1]);
+		int r = 2 * (p0[2] + p1[2]);
+		auto q = out + x * 2;
+		q[0] = Luma(p0, c);
+		q[1] = Clamp((c.u[0] * b + c.u[1] * g + c.u[2] * r + ChromaOffset) >> 16);
+		q[2] = Luma(p1, c);
+		q[3] = Clamp((c.v[0] * b + c.v[1] * g + c.v[2] * r + ChromaOffset) >> 16);
+	}
+}
+
+typedef UINT(*ConvertRowYuy2Fn)(const BYTE* row, BYTE* out, UINT width, const YuvCoefficients& c);
+
+static UINT ConvertRowYuy2None(const BYTE*, BYTE*, UINT, const YuvCoefficients&)
+{
+	return 0;
+}
+
+// I420: the NV12 kernels write a chunk of interleaved chroma, which is then split into the U and V planes
+static const UINT ChromaChunk = 256;
+
+static void SplitChromaScalar(const BYTE* uv, BYTE* u, BYTE* v, UINT i, UINT count)
+{
+	for (; i < count; i++)
+	{
+		u[i] = uv[i * 2];
+		v[i] = uv[i * 2 + 1];
+	}
+}
+
+typedef UINT(*SplitChromaFn)(const BYTE* uv, BYTE* u, BYTE* v, UINT count);
+
+static UINT SplitChromaNone(const BYTE*, BYTE*, BYTE*, UINT)
+{
+	return 0;
+}
+
+#if defined(_M_X64) || defined(_M_IX86)
+static UINT ConvertRowYuy2Sse41(const BYTE* row, BYTE* out, UINT width, const YuvCoefficients& c)
+{
+	const auto yc = _mm_set_epi16(c.y[3], c.y[2], c.y[1], c.y[0], c.y[3], c.y[2], c.y[1], c.y[0]);
+	const auto uc = _mm_set_epi16(c.u[3], c.u[2], c.u[1], c.u[0], c.u[3], c.u[2], c.u[1], c.u[0]);
+	const auto vc = _mm_set_epi16(c.v[3], c.v[2], c.v[1], c.v[0], c.v[3], c.v[2], c.v[1], c.v[0]);
+	const auto yOffset = _mm_set1_epi32(c.yOffset);
+	const auto uvOffset = _mm_set1_epi32(ChromaOffset);
+
+	UINT x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		auto a = _mm_loadu_si128((const __m128i*)(row + x * 4));
+		auto b = _mm_loadu_si128((const __m128i*)(row + x * 4 + 16));
+
+		auto luma = _mm_packs_epi32(LumaSse41(a, yc, yOffset), LumaSse41(b, yc, yOffset));
+
+		auto sa = BlockSumsSse41(a, a);
+		auto sb = BlockSumsSse41(b, b);
+		auto u = _mm_srai_epi32(_mm_add_epi32(_mm_hadd_epi32(_mm_madd_epi16(sa, uc), _mm_madd_epi16(sb, uc)), uvOffset), 16);
+		auto v = _mm_srai_epi32(_mm_add_epi32(_mm_hadd_epi32(_mm_madd_epi16(sa, vc), _mm_madd_epi16(sb, vc)), uvOffset), 16);
+		auto chroma = _mm_packs_epi32(_mm_unpacklo_epi32(u, v), _mm_unpackhi_epi32(u, v));
+
+		// Y0 U0 Y1 V0 ... is luma and chroma bytes interleaved
+		_mm_storeu_si128((__m128i*)(out + x * 2), _mm_unpacklo_epi8(_mm_packus_epi16(luma, luma), _mm_packus_epi16(chroma, chroma)));
+	}
+	return x;
+}
+
+static UINT ConvertRowYuy2Avx2(const BYTE* row, BYTE* out, UINT width, const YuvCoefficients& c)
+{
+	const auto yc = _mm256_setr_epi16(c.y[0], c.y[1], c.y[2], c.y[3], c.y[0], c.y[1], c.y[2], c.y[3], c.y[0], c.y[1], c.y[2], c.y[3], c.y[0], c.y[1], c.y[2], c.y[3]);
+	const auto uc = _mm256_setr_epi16(c.u[0], c.u[1], c.u[2], c.u[3], c.u[0], c.u[1], c.u[2], c.u[3], c.u[0], c.u[1], c.u[2], c.u[3], c.u[0], c.u[1], c.u[2], c.u[3]);
+	const auto vc = _mm256_setr_epi16(c.v[0], c.v[1], c.v[2], c.v[3], c.v[0], c.v[1], c.v[2], c.v[3], c.v[0], c.v[1], c.v[2], c.v[3], c.v[0], c.v[1], c.v[2], c.v[3]);
+	const auto yOffset = _mm256_set1_epi32(c.yOffset);
+	const auto uvOffset = _mm256_set1_epi32(ChromaOffset);
+	const auto lumaOrder = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+	const auto chromaOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	UINT x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		auto a = _mm256_loadu_si256((const __m256i*)(row + x * 4));
+		auto b = _mm256_loadu_si256((const __m256i*)(row + x * 4 + 32));
+
+		auto luma = _mm256_castsi256_si128(Pack16Avx2(LumaAvx2(a, yc, yOffset, lumaOrder), LumaAvx2(b, yc, yOffset, lumaOrder)));
+
+		auto sa = BlockSumsAvx2(a, a);
+		auto sb = BlockSumsAvx2(b, b);
+		auto u = _mm256_hadd_epi32(_mm256_madd_epi16(sa, uc), _mm256_madd_epi16(sb, uc));
+		auto v = _mm256_hadd_epi32(_mm256_madd_epi16(sa, vc), _mm256_madd_epi16(sb, vc));
+		u = _mm256_srai_epi32(_mm256_add_epi32(_mm256_permutevar8x32_epi32(u, chromaOrder), uvOffset), 16);
+		v = _mm256_srai_epi32(_mm256_add_epi32(_mm256_permutevar8x32_epi32(v, chromaOrder), uvOffset), 16);
+		auto chroma = _mm256_packs_epi32(_mm256_unpacklo_epi32(u, v), _mm256_unpackhi_epi32(u, v));
+		auto chroma8 = _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi16(chroma, chroma), 0x08));
+
+		_mm_storeu_si128((__m128i*)(out + x * 2), _mm_unpacklo_epi8(luma, chroma8));
+		_mm_storeu_si128((__m128i*)(out + x * 2 + 16), _mm_unpackhi_epi8(luma, chroma8));
+	}
+	return x;
+}
+
+static UINT SplitChromaSse2(const BYTE* uv, BYTE* u, BYTE* v, UINT count)
+{
+	const auto low = _mm_set1_epi16(0xFF);
+	UINT i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		auto a = _mm_loadu_si128((const __m128i*)(uv + i * 2));
+		auto b = _mm_loadu_si128((const __m128i*)(uv + i * 2 + 16));
+		_mm_storeu_si128((__m128i*)(u + i), _mm_packus_epi16(_mm_and_si128(a, low), _mm_and_si128(b, low)));
+		_mm_storeu_si128((__m128i*)(v + i), _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+	}
+	return i;
+}
+#endif
+
+static ConvertRowPairFn SelectConvertRowPair(const char** name)
+{
+#if defined(_M_X64) || defined(_M_IX86)
+	const auto& cpu = CpuFeatures::Get();
+	if (cpu.avx2)
+	{
+		*name = "AVX2";
+		return ConvertRowPairAvx2;
+	}
+
+	if (cpu.sse41)
+	{
+		*name = "SSE4.1";
+		return ConvertRowPairSse41;
+	}
+#endif
+	*name = "scalar";
+	return ConvertRowPairNone;
+}
+
+static ConvertRowYuy2Fn SelectConvertRowYuy2()
+{
+#if defined(_M_X64) || defined(_M_IX86)
+	const auto& cpu = CpuFeatures::Get();
+	if (cpu.avx2)
+		return ConvertRowYuy2Avx2;
+
+	if (cpu.sse41)
+		return ConvertRowYuy2Sse41;
+#endif
+	return ConvertRowYuy2None;
+}
+
+static SplitChromaFn SelectSplitChroma()
+{
+#if defined(_M_X64) || defined(_M_IX86)
+	if (CpuFeatures::Get().sse2)
+		return SplitChromaSse2;
+#endif
+	return SplitChromaNone;
+}
+
+static const char* _convertRowPairName = nullptr;
+static const ConvertRowPairFn _convertRowPair = SelectConvertRowPair(&_convertRowPairName);
+static const ConvertRowYuy2Fn _convertRowYuy2 = SelectConvertRowYuy2();
+static const SplitChromaFn _splitChroma = SelectSplitChroma();
+
+const char* RGB32ToNV12Kernel()
+{
+	return _convertRowPairName;
+}
+
+HRESULT RGB32ToNV12(const BYTE* input, ULONG inputSize, LONG inputStride, UINT width, UINT height, BYTE* output, ULONG outputSize, LONG outputStride, YuvMatrix matrix, YuvRange range)
+{
+	RETURN_HR_IF_NULL(E_INVALIDARG, input);
+	RETURN_HR_IF_NULL(E_INVALIDARG, output);
+	if (!width || !height)
+		return S_OK;
+
+	// the UV plane of an odd width still holds a full pair for the last column
+	const UINT evenWidth = (width + 1) & ~1;
+	RETURN_HR_IF(E_INVALIDARG, inputStride < 0 || (ULONGLONG)inputStride < (ULONGLONG)width * 4);
+	RETURN_HR_IF(E_INVALIDARG, outputStride < 0 || (ULONG)outputStride < evenWidth);
+	RETURN_HR_IF(E_UNEXPECTED, (ULONGLONG)inputStride * (height - 1) + (ULONGLONG)width * 4 > inputSize);
+	RETURN_HR_IF(E_UNEXPECTED, (ULONGLONG)outputStride * (height + (height + 1) / 2) > outputSize);
+
+	const auto& c = GetCoefficients(matrix, range);
+	const auto uvPlane = output + (size_t)height * outputStride;
+	SlicePool::Instance().Run(height, 2, [&](UINT first, UINT last)
+	{
+		for (UINT h = first; h < last; h += 2)
+		{
+			auto row0 = input + (size_t)h * inputStride;
+			auto y0 = output + (size_t)h * outputStride;
+			auto row1 = row0;
+			auto y1 = y0;
+			if (h + 1 < height)
+			{
+				row1 += inputStride;
+				y1 += outputStride;
+			}
+
+			auto uv = uvPlane + (size_t)(h / 2) * outputStride;
+			auto x = _convertRowPair(row0, row1, y0, y1, uv, width, c);
+			ConvertRowPairScalar(row0, row1, y0, y1, uv, x, width, c);
+		}
+	});
+	return S_OK;
+}
+
+HRESULT RGB32ToYUY2(const BYTE* input, ULONG inputSize, LONG inputStride, UINT width, UINT height, BYTE* output, ULONG outputSize, LONG outputStride, YuvMatrix matrix, YuvRange range)
+{
+	RETURN_HR_IF_NULL(E_INVALIDARG, input);
+	RETURN_HR_IF_NULL(E_INVALIDARG, output);
+	if (!width || !height)
+		return S_OK;
+
+	const UINT evenWidth = (width + 1) & ~1;
+	RETURN_HR_IF(E_INVALIDARG, inputStride < 0 || (ULONGLONG)inputStride < (ULONGLONG)width * 4);
+	RETURN_HR_IF(E_INVALIDARG, outputStride < 0 || (ULONG)outputStride < evenWidth * 2);
+	RETURN_HR_IF(E_UNEXPECTED, (ULONGLONG)inputStride * (height - 1) + (ULONGLONG)width * 4 > inputSize);
+	RETURN_HR_IF(E_UNEXPECTED, (ULONGLONG)outputStride * height > outputSize);
+
+	const auto& c = GetCoefficients(matrix, range);
+	SlicePool::Instance().Run(height, 1, [&](UINT first, UINT last)
+	{
+		for (UINT h = first; h < last; h++)
+		{
+			auto row = input + (size_t)h * inputStride;
+			auto out = output + (size_t)h * outputStride;
+			auto x = _convertRowYuy2(row, out, width, c);
+			ConvertRowYuy2Scalar(row, out, x, width, c);
+		}
+	});
+	return S_OK;
+}
+
+HRESULT RGB32ToI420(const BYTE* input, ULONG inputSize, LONG inputStride, UINT width, UINT height, BYTE* output, ULONG outputSize, LONG outputStride, YuvMatrix matrix, YuvRange range)
+{
+	RETURN_HR_IF_NULL(E_INVALIDARG, input);
+	RETURN_HR_IF_NULL(E_INVALIDARG, output);
+	if (!width || !height)
+		return S_OK;
+
+	// U and V rows are half the Y pitch, and hold the last column of an odd width
+	const UINT evenWidth = (width + 1) & ~1;
+	const LONG chromaStride = outputStride / 2;
+	const UINT chromaHeight = (height + 1) / 2;
+	RETURN_HR_IF(E_INVALIDARG, inputStride < 0 || (ULONGLONG)inputStride < (ULONGLONG)width * 4);
+	RETURN_HR_IF(E_INVALIDARG, outputStride < 0 || (ULONG)outputStride < evenWidth);
+	RETURN_HR_IF(E_UNEXPECTED, (ULONGLONG)inputStride * (height - 1) + (ULONGLONG)width * 4 > inputSize);
+	RETURN_HR_IF(E_UNEXPECTED, (ULONGLONG)outputStride * height + (ULONGLONG)chromaStride * chromaHeight * 2 > outputSize);
+
+	const auto& c = GetCoefficients(matrix, range);
+	const auto uPlane = output + (size_t)height * outputStride;
+	const auto vPlane = uPlane + (size_t)chromaHeight * chromaStride;
+	SlicePool::Instance().Run(height, 2, [&](UINT first, UINT last)
+	{
+		BYTE uv[ChromaChunk];
+		for (UINT h = first; h < last; h += 2)
+		{
+			auto row0 = input + (size_t)h * inputStride;
+			auto y0 = output + (size_t)h * outputStride;
+			auto row1 = row0;
+			auto y1 = y0;
+			if (h + 1 < height)
+			{
+				row1 += inputStride;
+				y1 += outputStride;
+			}
+
+			auto u = uPlane + (size_t)(h / 2) * chromaStride;
+			auto v = vPlane + (size_t)(h / 2) * chromaStride;
+			for (UINT x = 0; x < width; x += ChromaChunk)
+			{
+				const UINT w = (std::min)(ChromaChunk, width - x);
+				auto done = _convertRowPair(row0 + x * 4, row1 + x * 4, y0 + x, y1 + x, uv, w, c);
+				ConvertRowPairScalar(row0 + x * 4, row1 + x * 4, y0 + x, y1 + x, uv, done, w, c);
+
+				const UINT pairs = (w + 1) / 2;
+				auto i = _splitChroma(uv, u + x / 2, v + x / 2, pairs);
+				SplitChromaScalar(uv, u + x / 2, v + x / 2, i, pairs);
+			}
+		}
+	});
+	return S_OK;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+enum class YuvMatrix
+{
+	BT601 = 0,
+	BT709 = 1,
+};
+
+enum class YuvRange
+{
+	Limited = 0, // 16-235 luma, 16-240 chroma, what video pipelines expect by default
+	Full = 1,
+};
+
+// Converts 32bpp BGRA (alpha ignored) to NV12. Each chroma sample is the average of its 2x2 block of pixels;
+// odd widths and heights are supported, the last chroma column or row then averages the pixels that exist.
+// The UV plane starts height rows after the Y plane, both planes use outputStride.
+// Uses AVX2 or SSE4.1 when the CPU has them, the results are identical to the scalar version. Large frames are
+// converted in bands on the SlicePool.
+HRESULT RGB32ToNV12(const BYTE* input, ULONG inputSize, LONG inputStride, UINT width, UINT height, BYTE* output, ULONG outputSize, LONG outputStride, YuvMatrix matrix = YuvMatrix::BT601, YuvRange range = YuvRange::Limited);
+
+// Converts 32bpp BGRA (alpha ignored) to YUY2 (Y0 U Y1 V), each chroma sample the average of its pair of pixels.
+// An odd width repeats the last pixel. Same kernels and coefficients as RGB32ToNV12.
+HRESULT RGB32ToYUY2(const BYTE* input, ULONG inputSize, LONG inputStride, UINT width, UINT height, BYTE* output, ULONG outputSize, LONG outputStride, YuvMatrix matrix = YuvMatrix::BT601, YuvRange range = YuvRange::Limited);
+
+// Converts 32bpp BGRA (alpha ignored) to I420: the Y plane at outputStride, then the U and V planes at half of it.
+// Chroma as RGB32ToNV12, whose kernels it uses.
+HRESULT RGB32ToI420(const BYTE* input, ULONG inputSize, LONG inputStride, UINT width, UINT height, BYTE* output, ULONG outputSize, LONG outputStride, YuvMatrix matrix = YuvMatrix::BT601, YuvRange range = YuvRange::Limited);
+
+// Name of the conversion kernel picked for this CPU
+const char* RGB32ToNV12Kernel();
@@ -0,0 +1,41 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#endif
+
+// Instruction sets this CPU and OS can run, for picking vectorized code paths once at startup
+struct CpuFeatures
+{
+	bool sse2 = false;
+	bool sse41 = false;
+	bool avx2 = false;
+
+	static const CpuFeatures& Get()
+	{
+		static const CpuFeatures features = Detect();
+		return features;
+	}
+
+private:
+	static CpuFeatures Detect()
+	{
+		CpuFeatures features;
+#if defined(_M_X64) || defined(_M_IX86)
+		int info[4]{};
+		__cpuid(info, 0);
+		const auto maxLeaf = info[0];
+		__cpuid(info, 1);
+		features.sse2 = (info[3] & (1 << 26)) != 0;
+		features.sse41 = (info[2] & (1 << 19)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) // OS saves XMM and YMM state
+		{
+			__cpuidex(info, 7, 0);
+			features.avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#endif
+		return features;
+	}
+};
@@ -0,0 +1,189 @@
+#include "pch.h"
+#include "DecodeScheduler.h"
+#include "WicDecodeContext.h"
+
+DecodeScheduler& DecodeScheduler::Instance()
+{
+	static DecodeScheduler instance;
+	return instance;
+}
+
+DecodeScheduler::Queue* DecodeScheduler::Find(DecodeClient* client)
+{
+	for (auto& queue : _queues)
+	{
+		if (queue.client == client)
+			return &queue;
+	}
+	return nullptr;
+}
+
+UINT DecodeScheduler::WorkerCount()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return (UINT)_workers.size();
+}
+
+void DecodeScheduler::StartWorkers()
+{
+	auto count = std::max<UINT>(1, std::thread::hardware_concurrency());
+	auto generation = _generation;
+	for (UINT i = 0; i < count; i++)
+	{
+		_workers.emplace_back([this, generation]() { Worker(generation); });
+	}
+	WINTRACE(L"DecodeScheduler: started %u workers", count);
+}
+
+void DecodeScheduler::Register(DecodeClient* client)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	if (Find(client))
+		return;
+
+	_queues.emplace_back().client = client;
+	if (_workers.empty())
+	{
+		StartWorkers();
+	}
+	WINTRACE(L"DecodeScheduler: registered client %p, %u clients", client, (UINT)_queues.size());
+}
+
+void DecodeScheduler::Unregister(DecodeClient* client)
+{
+	std::vector<std::thread> workers;
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		auto queue = Find(client);
+		if (!queue)
+			return;
+
+		_ready.erase(std::remove(_ready.begin(), _ready.end(), queue), _ready.end());
+		queue->ready = false;
+		queue->pending.clear();
+		_idle.wait(lock, [queue]() { return !queue->busy; });
+		WINTRACE(L"DecodeScheduler: unregistered client %p submitted:%llu decoded:%llu dropped:%llu failed:%llu", client, queue->stats.submitted, queue->stats.decoded, queue->stats.dropped, queue->stats.failed);
+		_queues.remove_if([client](const Queue& q) { return q.client == client; });
+
+		if (_queues.empty())
+		{
+			// a Register racing with the join below starts a fresh set of workers
+			_generation++;
+			workers = std::move(_workers);
+		}
+	}
+
+	if (!workers.empty())
+	{
+		_work.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+		WINTRACE(L"DecodeScheduler: workers stopped");
+	}
+}
+
+HRESULT DecodeScheduler::Submit(DecodeClient* client, const BYTE* data, size_t size, const FrameTiming& timing)
+{
+	RETURN_HR_IF_NULL(E_POINTER, data);
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		auto queue = Find(client);
+		RETURN_HR_IF_NULL(E_UNEXPECTED, queue);
+
+		Frame frame;
+		if (queue->pending.size() >= MaxQueueDepth)
+		{
+			// the oldest waiting frame is stale now, reuse its buffer
+			frame.data = std::move(queue->pending.front().data);
+			queue->pending.pop_front();
+			queue->stats.dropped++;
+		}
+		else if (!queue->spare.empty())
+		{
+			frame.data = std::move(queue->spare.back());
+			queue->spare.pop_back();
+		}
+
+		frame.data.assign(data, data + size);
+		frame.timing = timing;
+		queue->pending.push_back(std::move(frame));
+		queue->stats.submitted++;
+		queue->stats.queueDepth = queue->pending.size();
+		if (queue->busy || queue->ready)
+			return S_OK;
+
+		queue->ready = true;
+		_ready.push_back(queue);
+	}
+	_work.notify_one();
+	return S_OK;
+}
+
+bool DecodeScheduler::GetStats(DecodeClient* client, Stats* stats)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	auto queue = Find(client);
+	if (!queue || !stats)
+		return false;
+
+	*stats = queue->stats;
+	return true;
+}
+
+void DecodeScheduler::Worker(UINT generation)
+{
+	// WIC needs COM on the thread doing the decode
+	HRESULT cohr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	std::unique_lock<std::mutex> lock(_lock);
+	while (true)
+	{
+		_work.wait(lock, [this, generation]() { return _generation != generation || !_ready.empty(); });
+		if (_generation != generation)
+			break;
+
+		auto queue = _ready.front();
+		_ready.pop_front();
+		queue->ready = false;
+		if (queue->pending.empty())
+			continue;
+
+		auto frame = std::move(queue->pending.front());
+		queue->pending.pop_front();
+		queue->stats.queueDepth = queue->pending.size();
+		queue->busy = true;
+		auto client = queue->client;
+
+		lock.unlock();
+		auto hr = client->Decode(frame.data.data(), frame.data.size(), frame.timing);
+		lock.lock();
+
+		queue->busy = false;
+		if (SUCCEEDED(hr))
+		{
+			queue->stats.decoded++;
+		}
+		else
+		{
+			queue->stats.failed++;
+		}
+		queue->spare.push_back(std::move(frame.data));
+
+		// back of the line, so other cameras get their turn first
+		if (!queue->pending.empty())
+		{
+			queue->ready = true;
+			_ready.push_back(queue);
+			_work.notify_one();
+		}
+		_idle.notify_all();
+	}
+	lock.unlock();
+
+	WicDecodeContext::ReleaseForCurrentThread();
+	if (SUCCEEDED(cohr))
+	{
+		CoUninitialize();
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "SampleTiming.h"
+
+// Decodes compressed frames on behalf of a camera, called on a scheduler worker
+struct DecodeClient
+{
+	virtual HRESULT Decode(const BYTE* data, size_t size, const FrameTiming& timing) = 0;
+};
+
+// Process-wide pool of decode workers shared by every virtual camera of the frame server.
+// Each camera (client) owns a small bounded queue of pending frames; when it is full the oldest frame is
+// dropped since only the most recent picture matters. Clients with pending frames wait in a round-robin
+// list and a worker always takes one frame from the client at the head, so a busy camera cannot starve the
+// others. A client never has two frames decoding at once, and total decode concurrency is capped at the
+// number of cores.
+// Workers start with the first registered client and are joined when the last one unregisters.
+class DecodeScheduler
+{
+public:
+	static constexpr size_t MaxQueueDepth = 2;
+
+	struct Stats
+	{
+		size_t queueDepth;   // frames waiting
+		ULONGLONG submitted;
+		ULONGLONG decoded;
+		ULONGLONG dropped;   // replaced by a newer frame before being decoded
+		ULONGLONG failed;
+	};
+
+	static DecodeScheduler& Instance();
+
+	void Register(DecodeClient* client);
+	// Drops pending frames and waits for a decode in progress for that client to complete
+	void Unregister(DecodeClient* client);
+
+	// Copies the frame into the client's queue, its timing is handed to Decode with it
+	HRESULT Submit(DecodeClient* client, const BYTE* data, size_t size, const FrameTiming& timing);
+	bool GetStats(DecodeClient* client, Stats* stats);
+	UINT WorkerCount();
+
+private:
+	struct Frame
+	{
+		std::vector<BYTE> data;
+		FrameTiming timing;
+	};
+
+	struct Queue
+	{
+		DecodeClient* client = nullptr;
+		std::deque<Frame> pending;
+		std::vector<std::vector<BYTE>> spare;  // buffers of decoded frames, reused by Submit
+		bool busy = false;                     // a worker is decoding a frame of this client
+		bool ready = false;                    // in _ready
+		Stats stats{};
+	};
+
+	std::mutex _lock;
+	std::condition_variable _work;  // _ready has an entry or _generation changed
+	std::condition_variable _idle;  // a decode completed
+	std::list<Queue> _queues;
+	std::deque<Queue*> _ready;      // round-robin order of clients with pending frames and no decode running
+	std::vector<std::thread> _workers;
+	UINT _generation = 0;           // bumped when the last client leaves, tells the current workers to exit
+
+	Queue* Find(DecodeClient* client);
+	void StartWorkers();
+	void Worker(UINT generation);
+};
@@ -0,0 +1,173 @@
+#include "pch.h"
+#include "FrameBufferPool.h"
+#include <bit>
+
+FrameBuffer::FrameBuffer(const FrameBuffer& other) :
+	_block(other._block),
+	_size(other._size)
+{
+	if (_block)
+	{
+		_block->refs++;
+	}
+}
+
+FrameBuffer::FrameBuffer(FrameBuffer&& other) noexcept :
+	_block(other._block),
+	_size(other._size)
+{
+	other._block = nullptr;
+	other._size = 0;
+}
+
+FrameBuffer& FrameBuffer::operator=(const FrameBuffer& other)
+{
+	if (this != &other)
+	{
+		if (other._block)
+		{
+			other._block->refs++;
+		}
+		Reset();
+		_block = other._block;
+		_size = other._size;
+	}
+	return *this;
+}
+
+FrameBuffer& FrameBuffer::operator=(FrameBuffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		Reset();
+		_block = other._block;
+		_size = other._size;
+		other._block = nullptr;
+		other._size = 0;
+	}
+	return *this;
+}
+
+bool FrameBuffer::Resize(size_t size)
+{
+	if (_block && size <= _block->capacity && _block->refs == 1)
+	{
+		_size = size;
+		return true;
+	}
+
+	*this = FrameBufferPool::Instance().Get(size);
+	return _block != nullptr || !size;
+}
+
+void FrameBuffer::Reset()
+{
+	if (_block && !--_block->refs)
+	{
+		FrameBufferPool::Instance().Release(_block);
+	}
+	_block = nullptr;
+	_size = 0;
+}
+
+FrameBufferPool& FrameBufferPool::Instance()
+{
+	static FrameBufferPool instance;
+	return instance;
+}
+
+size_t FrameBufferPool::ClassSize(size_t size)
+{
+	if (size <= MinSize)
+		return MinSize;
+
+	// 2^n < size <= 2^(n+1), rounded up to a multiple of 2^n / 8
+	const auto step = std::bit_ceil(size) / 16;
+	return (size + step - 1) / step * step;
+}
+
+FrameBuffer FrameBufferPool::Get(size_t size)
+{
+	if (!size)
+		return FrameBuffer();
+
+	const auto capacity = ClassSize(size);
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		auto it = _free.find(capacity);
+		if (it != _free.end() && !it->second.empty())
+		{
+			auto block = it->second.back();
+			it->second.pop_back();
+			block->refs = 1;
+			_stats.freeBytes -= capacity;
+			_stats.hits++;
+			return FrameBuffer(block, size);
+		}
+		_stats.misses++;
+	}
+
+	auto data = (BYTE*)_aligned_malloc(capacity, Alignment);
+	if (!data)
+	{
+		WINTRACE(L"FrameBufferPool: failed to allocate %zu bytes", capacity);
+		return FrameBuffer();
+	}
+
+	auto block = new (std::nothrow) FrameBuffer::Block();
+	if (!block)
+	{
+		_aligned_free(data);
+		return FrameBuffer();
+	}
+	block->capacity = capacity;
+	block->data = data;
+
+	std::lock_guard<std::mutex> lock(_lock);
+	_stats.residentBytes += capacity;
+	_stats.peakResidentBytes = std::max(_stats.peakResidentBytes, _stats.residentBytes);
+	return FrameBuffer(block, size);
+}
+
+void FrameBufferPool::Release(FrameBuffer::Block* block)
+{
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		if (_stats.freeBytes + block->capacity <= MaxFreeBytes)
+		{
+			_free[block->capacity].push_back(block);
+			_stats.freeBytes += block->capacity;
+			return;
+		}
+		_stats.residentBytes -= block->capacity;
+	}
+
+	_aligned_free(block->data);
+	delete block;
+}
+
+FrameBufferPool::Stats FrameBufferPool::GetStats()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return _stats;
+}
+
+void FrameBufferPool::Trim()
+{
+	std::map<size_t, std::vector<FrameBuffer::Block*>> free;
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		free.swap(_free);
+		_stats.residentBytes -= _stats.freeBytes;
+		_stats.freeBytes = 0;
+	}
+
+	for (auto& list : free)
+	{
+		for (auto block : list.second)
+		{
+			_aligned_free(block->data);
+			delete block;
+		}
+	}
+}
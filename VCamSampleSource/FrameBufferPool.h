@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+
+class FrameBufferPool;
+
+// Handle to a pooled, 64-byte aligned pixel buffer. Copies share the same memory (the buffer is refcounted)
+// and the memory goes back to the pool when the last handle lets go of it.
+class FrameBuffer
+{
+	friend class FrameBufferPool;
+
+	struct Block
+	{
+		std::atomic<ULONG> refs{ 1 };
+		size_t capacity = 0;
+		BYTE* data = nullptr;
+	};
+
+	Block* _block = nullptr;
+	size_t _size = 0;
+
+	FrameBuffer(Block* block, size_t size) : _block(block), _size(size) {}
+
+public:
+	FrameBuffer() = default;
+	FrameBuffer(const FrameBuffer& other);
+	FrameBuffer(FrameBuffer&& other) noexcept;
+	FrameBuffer& operator=(const FrameBuffer& other);
+	FrameBuffer& operator=(FrameBuffer&& other) noexcept;
+	~FrameBuffer() { Reset(); }
+
+	BYTE* Data() const { return _block ? _block->data : nullptr; }
+	size_t Size() const { return _size; }
+	bool Empty() const { return !_size; }
+
+	// Makes the buffer size bytes. Contents are kept when the memory is large enough and not shared, otherwise
+	// the handle moves to another pooled buffer with undefined contents. Returns false if out of memory.
+	bool Resize(size_t size);
+	void Reset();
+};
+
+// Process-wide cache of frame buffers. Sizes are rounded up to classes (8 per power of two, so at most 12.5%
+// is unused) and released buffers wait on their class' free list for the next request of that class; with
+// cameras running at fixed resolutions, every stage of every frame gets its memory back from the pool.
+// Released buffers beyond MaxFreeBytes are freed right away.
+class FrameBufferPool
+{
+public:
+	static constexpr size_t Alignment = 64;      // cache line, and enough for any vector load
+	static constexpr size_t MinSize = 64 * 1024;
+	static constexpr size_t MaxFreeBytes = 256 * 1024 * 1024;
+
+	struct Stats
+	{
+		ULONGLONG hits;           // requests served from a free list
+		ULONGLONG misses;         // requests that allocated
+		size_t residentBytes;     // allocated, in use or free
+		size_t peakResidentBytes;
+		size_t freeBytes;
+	};
+
+	static FrameBufferPool& Instance();
+
+	// Empty on out of memory
+	FrameBuffer Get(size_t size);
+	Stats GetStats();
+	// Frees every buffer not in use
+	void Trim();
+
+private:
+	friend class FrameBuffer;
+
+	std::mutex _lock;
+	std::map<size_t, std::vector<FrameBuffer::Block*>> _free; // by capacity
+	Stats _stats{};
+
+	static size_t ClassSize(size_t size);
+	void Release(FrameBuffer::Block* block);
+};
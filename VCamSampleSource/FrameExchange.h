@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include "FrameBufferPool.h"
+#include "SampleTiming.h"
+
+// A decoded picture, BGRA or NV12, or the camera's JPEG as is
+struct DecodedFrame
+{
+	FrameBuffer data;
+	UINT width = 0;
+	UINT height = 0;
+	UINT stride = 0;       // bytes per row
+	bool nv12 = false;     // Y plane then interleaved UV, both at stride
+	bool jpeg = false;     // MJPG passthrough: data is the JPEG, width and height from its frame header, no stride
+	MFTIME published = 0;  // when the decoder handed it over
+	ULONGLONG sequence = 0; // 1 for the first frame published, then 2 ...
+	FrameTiming timing;    // of the JPEG it was decoded from
+};
+
+// Triple buffer passing decoded frames from the decode worker (one producer) to Generate (one consumer)
+// without copying and without either side waiting for the other.
+// The producer fills the back slot and publishes it by swapping it with the middle slot; the consumer takes
+// the middle slot, if it holds a newer frame, by swapping it with its front slot. Each side only ever touches
+// its own slot, so a frame is never written while it is read; a frame published before the previous one was
+// taken replaces it, its buffer going back to the producer.
+class FrameExchange
+{
+	static constexpr UINT IndexMask = 3;
+	static constexpr UINT Fresh = 4;  // set on the middle index when it holds a frame the consumer hasn't taken
+
+	DecodedFrame _slots[3];
+	std::atomic<UINT> _middle{ 2 };
+	UINT _back = 0;   // producer only
+	ULONGLONG _sequence = 0; // producer only
+	UINT _front = 1;  // consumer only
+	std::atomic<ULONGLONG> _published{ 0 };
+	std::atomic<ULONGLONG> _overwritten{ 0 };
+
+public:
+	struct Stats
+	{
+		ULONGLONG published;
+		ULONGLONG overwritten;  // published frames replaced before the consumer took them
+	};
+
+	// Producer: the slot to decode into; its buffer keeps the capacity of an earlier frame
+	DecodedFrame& Back() { return _slots[_back]; }
+
+	// Producer: hands the back slot over, the next Back() is a different slot
+	void Publish()
+	{
+		_slots[_back].published = MFGetSystemTime();
+		_slots[_back].sequence = ++_sequence;
+		auto previous = _middle.exchange(_back | Fresh, std::memory_order_acq_rel);
+		if (previous & Fresh)
+		{
+			_overwritten++;
+		}
+		_back = previous & IndexMask;
+		_published++;
+	}
+
+	// Consumer: the most recent frame, which stays valid and unchanged until the next call to Latest
+	const DecodedFrame& Latest()
+	{
+		if (_middle.load(std::memory_order_relaxed) & Fresh)
+		{
+			_front = _middle.exchange(_front, std::memory_order_acq_rel) & IndexMask;
+		}
+		return _slots[_front];
+	}
+
+	Stats GetStats() const { return { _published.load(), _overwritten.load() }; }
+};
@@ -1,8 +1,13 @@
 #include "pch.h"
 #include "Undocumented.h"
 #include "Tools.h"
+#include "ColorConversion.h"
+#include "SlicePool.h"
+#include "Resampler.h"
+#include "PixelFormats.h"
 #include "MFTools.h"
 #include "FrameGenerator.h"
+#include "WicDecodeContext.h"
 #include <winhttp.h>
 #include <cmath>
 
@@ -10,6 +15,8 @@ HRESULT FrameGenerator::EnsureRenderTarget(UINT width, UINT height)
 {
 	_width = width;
 	_height = height;
+	_targetWidth = width;
+	_targetHeight = height;
 	
 	if (!HasD3DManager())
 	{
@@ -32,6 +39,8 @@ HRESULT FrameGenerator::EnsureRenderTarget(UINT width, UINT height)
 		RETURN_IF_FAILED(CreateRenderTargetResources(width, height));
 	}
 
+	_spinner.Reset(); // the stream starts, possibly with new sample buffers
+	_lastOutput.reset();
 	_prevTime = MFGetSystemTime();
 	_frame = 0;
 	return S_OK;
@@ -98,15 +107,22 @@ HRESULT FrameGenerator::SetD3DManager(IUnknown* manager, UINT width, UINT height
 	MFSetAttributeSize(inputType.get(), MF_MT_FRAME_SIZE, width, height);
 	RETURN_IF_FAILED(_converter->SetInputType(0, inputType.get(), 0));
 
+	RETURN_IF_FAILED(SetConverterOutputType(MFVideoFormat_NV12, width, height));
+
+	// make sure the video processor works on GPU
+	RETURN_IF_FAILED(_converter->ProcessMessage(MFT_MESSAGE_SET_D3D_MANAGER, (ULONG_PTR)manager));
+	return S_OK;
+}
+
+HRESULT FrameGenerator::SetConverterOutputType(REFGUID subtype, UINT width, UINT height)
+{
 	wil::com_ptr_nothrow<IMFMediaType> outputType;
 	RETURN_IF_FAILED(MFCreateMediaType(&outputType));
 	outputType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
-	outputType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12);
+	outputType->SetGUID(MF_MT_SUBTYPE, subtype);
 	MFSetAttributeSize(outputType.get(), MF_MT_FRAME_SIZE, width, height);
 	RETURN_IF_FAILED(_converter->SetOutputType(0, outputType.get(), 0));
-
-	// make sure the video processor works on GPU
-	RETURN_IF_FAILED(_converter->ProcessMessage(MFT_MESSAGE_SET_D3D_MANAGER, (ULONG_PTR)manager));
+	_converterFormat = subtype;
 	return S_OK;
 }
 
@@ -115,6 +131,11 @@ HRESULT FrameGenerator::CreateRenderTargetResources(UINT width, UINT height)
 {
 	assert(_renderTarget);
 	RETURN_IF_FAILED(_renderTarget->CreateSolidColorBrush(D2D1::ColorF(1, 1, 1, 1), &_whiteBrush));
+	for (auto& bitmap : _uploadBitmaps)
+	{
+		bitmap.reset();
+	}
+	_uploads.Reset();
 
 	// DWrite optional (kept for debug overlays if needed)
 	RETURN_IF_FAILED(DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory), (IUnknown**)&_dwrite));
@@ -132,10 +153,8 @@ HRESULT FrameGenerator::SetMjpegUrl(const wchar_t* url)
 {
 	WINTRACE(L"FrameGenerator::SetMjpegUrl url:'%s'", url ? url : L"(null)");
 	RETURN_HR_IF_NULL(E_INVALIDARG, url);
-	_host.clear();
-	_path.clear();
-	_port = INTERNET_DEFAULT_HTTP_PORT;
-	_useHttps = false;
+	StopReader();
+	_endpoint = MjpegEndpoint();
 
 	// Very small URL parser for http[s]://host[:port]/path
 	std::wstring s(url);
@@ -144,222 +163,263 @@ HRESULT FrameGenerator::SetMjpegUrl(const wchar_t* url)
 	size_t pos = std::wstring::npos;
 	if (s.rfind(http, 0) == 0)
 	{
-		_useHttps = false; s = s.substr(http.size());
+		_endpoint.https = false; s = s.substr(http.size());
 	}
 	else if (s.rfind(https, 0) == 0)
 	{
-		_useHttps = true; s = s.substr(https.size()); _port = INTERNET_DEFAULT_HTTPS_PORT;
+		_endpoint.https = true; s = s.substr(https.size()); _endpoint.port = INTERNET_DEFAULT_HTTPS_PORT;
 	}
 
 	pos = s.find(L"/");
 	std::wstring hostport = pos == std::wstring::npos ? s : s.substr(0, pos);
-	_path = pos == std::wstring::npos ? L"/" : s.substr(pos);
+	_endpoint.path = pos == std::wstring::npos ? L"/" : s.substr(pos);
 
 	size_t colon = hostport.find(L":");
 	if (colon == std::wstring::npos)
 	{
-		_host = hostport;
+		_endpoint.host = hostport;
 	}
 	else
 	{
-		_host = hostport.substr(0, colon);
-		_port = static_cast<INTERNET_PORT>(std::stoi(hostport.substr(colon + 1)));
+		_endpoint.host = hostport.substr(0, colon);
+		_endpoint.port = static_cast<INTERNET_PORT>(std::stoi(hostport.substr(colon + 1)));
 	}
 
-	StopReader();
-	if (_hRequest) { WinHttpCloseHandle(_hRequest); _hRequest = nullptr; }
-	if (_hConnect) { WinHttpCloseHandle(_hConnect); _hConnect = nullptr; }
-	if (_hSession) { WinHttpCloseHandle(_hSession); _hSession = nullptr; }
-	_mjpegBuffer.clear();
-	_lastJpeg.clear();
-	_decodedRGBA.clear();
-	_decWidth = _decHeight = _decStride = 0;
+	_splitter.Reset();
 	_hasFrame = false;
-	WINTRACE(L"FrameGenerator::SetMjpegUrl parsed host:%s port:%u path:%s https:%d", _host.c_str(), _port, _path.c_str(), _useHttps ? 1 : 0);
+	WINTRACE(L"FrameGenerator::SetMjpegUrl parsed host:%s port:%u path:%s https:%d", _endpoint.host.c_str(), _endpoint.port, _endpoint.path.c_str(), _endpoint.https ? 1 : 0);
 	return S_OK;
 }
 
-HRESULT FrameGenerator::EnsureHttpOpen()
+HRESULT FrameGenerator::SetAsyncTransport(bool async)
 {
-	if (!_hSession)
-	{
-		_hSession = WinHttpOpen(L"WinCamHTTP/1.0", WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
-		if (!_hSession) { auto err = HRESULT_FROM_WIN32(GetLastError()); WINTRACE(L"WinHttpOpen failed 0x%08X", err); return err; }
-	}
-	if (!_hConnect)
-	{
-		_hConnect = WinHttpConnect(_hSession, _host.c_str(), _port, 0);
-		if (!_hConnect) { auto err = HRESULT_FROM_WIN32(GetLastError()); WINTRACE(L"WinHttpConnect failed 0x%08X host:%s port:%u", err, _host.c_str(), _port); return err; }
-	}
+	WINTRACE(L"FrameGenerator::SetAsyncTransport async:%d", async ? 1 : 0);
+	if (_asyncTransport == async)
+		return S_OK;
+
+	// the next Generate starts the new transport
+	StopReader();
+	_asyncTransport = async;
 	return S_OK;
 }
 
-HRESULT FrameGenerator::EnsureRequest()
+HRESULT FrameGenerator::SetSnapshotMode(bool snapshot)
 {
-	if (_hRequest)
+	WINTRACE(L"FrameGenerator::SetSnapshotMode snapshot:%d", snapshot ? 1 : 0);
+	if (_snapshot == snapshot)
 		return S_OK;
 
-	RETURN_IF_FAILED(EnsureHttpOpen());
-	DWORD flags = _useHttps ? WINHTTP_FLAG_SECURE : 0;
-	_hRequest = WinHttpOpenRequest(_hConnect, L"GET", _path.c_str(), nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
-	if (!_hRequest) { auto err = HRESULT_FROM_WIN32(GetLastError()); WINTRACE(L"WinHttpOpenRequest failed 0x%08X", err); return err; }
-	WINTRACE(L"MJPEG: sending request to %s:%u%s", _host.c_str(), _port, _path.c_str());
-	if (!WinHttpSendRequest(_hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0, WINHTTP_NO_REQUEST_DATA, 0, 0, 0))
-	{
-		auto le = GetLastError(); auto err = HRESULT_FROM_WIN32(le);
-		WINTRACE(L"WinHttpSendRequest failed 0x%08X (%u)", err, le);
-		WinHttpCloseHandle(_hRequest); _hRequest = nullptr;
-		return err;
-	}
-	if (!WinHttpReceiveResponse(_hRequest, nullptr))
-	{
-		auto le = GetLastError(); auto err = HRESULT_FROM_WIN32(le);
-		WINTRACE(L"WinHttpReceiveResponse failed 0x%08X (%u)", err, le);
-		WinHttpCloseHandle(_hRequest); _hRequest = nullptr;
-		return err;
-	}
-	DWORD statusCode = 0; DWORD scSize = sizeof(statusCode);
-	if (WinHttpQueryHeaders(_hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX, &statusCode, &scSize, WINHTTP_NO_HEADER_INDEX))
-	{
-		WINTRACE(L"MJPEG: response received. HTTP %u", statusCode);
-	}
-	else
+	StopReader();
+	_snapshot = snapshot;
+	return S_OK;
+}
+
+HRESULT FrameGenerator::SetFrameRate(UINT numerator, UINT denominator)
+{
+	RETURN_HR_IF(E_INVALIDARG, !numerator || !denominator);
+	auto fps = std::max<UINT>(1, numerator / denominator);
+	WINTRACE(L"FrameGenerator::SetFrameRate %u/%u", numerator, denominator);
+	if (_fps == fps)
+		return S_OK;
+
+	// the snapshot poll interval follows the frame rate
+	if (_snapshot)
 	{
-		WINTRACE(L"MJPEG: response received. (status code unavailable)");
+		StopReader();
 	}
+	_fps = fps;
 	return S_OK;
 }
 
-bool FrameGenerator::FindJpegInBuffer(const std::vector<BYTE>& buf, size_t& start, size_t& end)
+HRESULT FrameGenerator::SetJpegDecoder(JpegDecoderType type)
 {
-	// JPEG SOI: 0xFF,0xD8 ; EOI: 0xFF,0xD9
-	start = end = std::string::npos;
-	size_t i = 0;
-	for (; i + 1 < buf.size(); ++i)
+	auto decoder = JpegDecoder::Get(type);
+	WINTRACE(L"FrameGenerator::SetJpegDecoder type:%u using:%s", (UINT)type, decoder->Name());
+
+	// decodes run on the scheduler, stop feeding it before switching
+	if (decoder != _decoder)
 	{
-		if (buf[i] == 0xFF && buf[i + 1] == 0xD8) { start = i; break; }
+		StopReader();
+		_decoder = decoder;
 	}
-	if (start == std::string::npos)
-		return false;
-	for (i = start + 2; i + 1 < buf.size(); ++i)
+	return S_OK;
+}
+
+HRESULT FrameGenerator::SetFitMode(FitMode mode)
+{
+	RETURN_HR_IF(E_INVALIDARG, mode != FitMode::Stretch && mode != FitMode::Letterbox && mode != FitMode::Crop);
+	WINTRACE(L"FrameGenerator::SetFitMode mode:%u", (UINT)mode);
+	_fitMode = mode; // the next frame's layout won't match
+	_lastOutput.reset();
+	return S_OK;
+}
+
+const FrameLayout& FrameGenerator::UpdateLayout(UINT width, UINT height)
+{
+	if (!_layout.Matches(_fitMode, width, height, _width, _height))
 	{
-		if (buf[i] == 0xFF && buf[i + 1] == 0xD9) { end = i + 2; break; }
+		_layout = FrameLayout::Compute(_fitMode, width, height, _width, _height);
+		_fittedBorder = false;
+		_targetBorder = false;
+		WINTRACE(L"FrameGenerator::UpdateLayout mode:%u %ux%u -> %ux%u source:%d,%d,%d,%d target:%d,%d,%d,%d", (UINT)_fitMode, width, height, _width, _height,
+			_layout.source.left, _layout.source.top, _layout.source.right, _layout.source.bottom, _layout.target.left, _layout.target.top, _layout.target.right, _layout.target.bottom);
 	}
-	return end != std::string::npos;
+	return _layout;
 }
 
-HRESULT FrameGenerator::ReadNextJpegFrame()
+HRESULT FrameGenerator::SetScaleFilter(ResampleFilter filter)
 {
-	RETURN_IF_FAILED(EnsureRequest());
+	RETURN_HR_IF(E_INVALIDARG, filter != ResampleFilter::Bilinear && filter != ResampleFilter::Bicubic && filter != ResampleFilter::Lanczos3);
+	WINTRACE(L"FrameGenerator::SetScaleFilter filter:%u", (UINT)filter);
+	_resampler.SetFilter(filter);
+	_lastOutput.reset();
+	return S_OK;
+}
 
-	// Read from network until we can extract a full JPEG frame
-	DWORD dwSize = 0;
-	while (true)
-	{
-		size_t start = 0, end = 0;
-		if (FindJpegInBuffer(_mjpegBuffer, start, end))
-		{
-			_lastJpeg.assign(_mjpegBuffer.begin() + start, _mjpegBuffer.begin() + end);
-			WINTRACE(L"MJPEG: found JPEG in buffer start=%zu end=%zu size=%zu", start, end, _lastJpeg.size());
-			// Remove consumed bytes
-			_mjpegBuffer.erase(_mjpegBuffer.begin(), _mjpegBuffer.begin() + end);
-			return S_OK;
-		}
+// --- MjpegTransportSink, called on the transport's thread ---
 
-		if (!WinHttpQueryDataAvailable(_hRequest, &dwSize))
-		{
-			auto err = HRESULT_FROM_WIN32(GetLastError());
-			WINTRACE(L"MJPEG: WinHttpQueryDataAvailable failed 0x%08X", err);
-			return err;
-		}
-		if (dwSize == 0)
-		{
-			// Connection closed; reopen request to continue
-			WinHttpCloseHandle(_hRequest); _hRequest = nullptr;
-			WINTRACE(L"MJPEG: data available size=0, reopening request");
-			RETURN_IF_FAILED(EnsureRequest());
-			continue;
-		}
+void FrameGenerator::OnResponse(DWORD statusCode, const std::string& contentType)
+{
+	// multipart/x-mixed-replace responses carry the part boundary, which lets the splitter use Content-Length
+	WINTRACE(L"MJPEG: response HTTP %u content-type:'%S'", statusCode, contentType.c_str());
+	_splitter.SetContentType(contentType);
+}
 
-		const size_t oldSize = _mjpegBuffer.size();
-		_mjpegBuffer.resize(oldSize + dwSize);
-		DWORD dwRead = 0;
-		if (!WinHttpReadData(_hRequest, _mjpegBuffer.data() + oldSize, dwSize, &dwRead))
-		{
-			auto err = HRESULT_FROM_WIN32(GetLastError());
-			WINTRACE(L"MJPEG: WinHttpReadData failed 0x%08X", err);
-			return err;
-		}
-		_mjpegBuffer.resize(oldSize + dwRead);
-		WINTRACE(L"MJPEG: read %u bytes (buffer now %zu)", dwRead, _mjpegBuffer.size());
-	}
+BYTE* FrameGenerator::GetReadBuffer(DWORD size)
+{
+	// reads land straight in the splitter's ingest buffer
+	return _splitter.GetWriteBuffer(size);
 }
 
-HRESULT FrameGenerator::DecodeJpegToBitmap(UINT& outW, UINT& outH)
+bool FrameGenerator::OnData(DWORD size)
 {
-	RETURN_HR_IF(E_FAIL, _lastJpeg.empty());
-	WINTRACE(L"MJPEG: decoding JPEG of size %zu", _lastJpeg.size());
-	// Use thread-local WIC objects to avoid cross-thread COM state issues
-	wil::com_ptr_nothrow<IWICImagingFactory> wicFactory;
-	RETURN_IF_FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_ALL, IID_PPV_ARGS(&wicFactory)));
+	_splitter.CommitWrite(size);
+	const auto arrival = MFGetSystemTime();
+
+	// only the newest complete frame is worth decoding, the others count as dropped
+	const BYTE* jpeg = nullptr;
+	size_t jpegSize = 0;
+	LONGLONG server = 0;
+	const BYTE* frame;
+	size_t frameSize;
+	while (_splitter.NextFrame(&frame, &frameSize))
+	{
+		jpeg = frame;
+		jpegSize = frameSize;
+		server = _splitter.FrameTimestamp();
+		_jpegIndex++;
+	}
 
-	wil::com_ptr_nothrow<IWICStream> stream;
-	RETURN_IF_FAILED(wicFactory->CreateStream(&stream));
-	RETURN_IF_FAILED(stream->InitializeFromMemory(_lastJpeg.data(), static_cast<DWORD>(_lastJpeg.size())));
+	if (!jpeg)
+		return false;
 
-	wil::com_ptr_nothrow<IWICBitmapDecoder> decoder;
-	RETURN_IF_FAILED(wicFactory->CreateDecoderFromStream(stream.get(), nullptr, WICDecodeMetadataCacheOnDemand, &decoder));
-	wil::com_ptr_nothrow<IWICBitmapFrameDecode> frame;
-	RETURN_IF_FAILED(decoder->GetFrame(0, &frame));
+	WINTRACE(L"MJPEG: found JPEG in buffer size=%zu moved=%llu frames=%llu", jpegSize, _splitter.BytesMoved(), _splitter.FrameCount());
 
-	// Handle EXIF orientation (property 274) if present
-	wil::com_ptr_nothrow<IWICMetadataQueryReader> meta;
-	(void)frame->GetMetadataQueryReader(&meta);
-	UINT16 orient = 1; // default top-left
-	PROPVARIANT v{}; PropVariantInit(&v);
-	if (meta && SUCCEEDED(meta->GetMetadataByName(L"/app1/ifd/exif/{ushort=274}", &v)) && v.vt == VT_UI2)
+	FrameTiming timing{ _captureClock.Captured(arrival, server), _jpegIndex };
+	if (_passthrough)
 	{
-		orient = v.uiVal;
+		PublishJpeg(jpeg, jpegSize, timing);
+		return true;
 	}
-	PropVariantClear(&v);
 
-	wil::com_ptr_nothrow<IWICBitmapSource> src = frame;
-	wil::com_ptr_nothrow<IWICBitmapFlipRotator> rot;
-	WICBitmapTransformOptions xform = WICBitmapTransformRotate0;
-	switch (orient)
+	// the span dies with the next read, the scheduler keeps its own copy until a worker picks it up
+	LOG_IF_FAILED(DecodeScheduler::Instance().Submit(this, jpeg, jpegSize, timing));
+	return true;
+}
+
+void FrameGenerator::OnError(HRESULT hr)
+{
+	WINTRACE(L"MJPEG: transport error 0x%08X, reconnecting", hr);
+}
+
+void FrameGenerator::PublishJpeg(const BYTE* jpeg, size_t jpegSize, const FrameTiming& timing)
+{
+	// MJPG output: nothing to decode, only the frame header is read to check the size against the negotiated one.
+	// Decoding is off while passing through (see Generate), this thread is the exchange's only producer
+	UINT w = 0, h = 0;
+	if (!MjpegSplitter::ReadFrameSize(jpeg, jpegSize, &w, &h))
 	{
-	case 3: xform = WICBitmapTransformRotate180; break;
-	case 6: xform = WICBitmapTransformRotate90; break;   // 90 CW
-	case 8: xform = WICBitmapTransformRotate270; break;  // 270 CW
-	default: xform = WICBitmapTransformRotate0; break;
+		WINTRACE(L"MJPEG: passthrough JPEG of size %zu has no frame header, dropped", jpegSize);
+		return;
 	}
-	if (xform != WICBitmapTransformRotate0)
+
+	if (w != _targetWidth || h != _targetHeight)
 	{
-		RETURN_IF_FAILED(wicFactory->CreateBitmapFlipRotator(&rot));
-		RETURN_IF_FAILED(rot->Initialize(src.get(), xform));
-		src = rot.get();
+		_mismatchedJpegs++;
 	}
 
-	wil::com_ptr_nothrow<IWICFormatConverter> wicConverter;
-	RETURN_IF_FAILED(wicFactory->CreateFormatConverter(&wicConverter));
-	HRESULT convhr = wicConverter->Initialize(src.get(), GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, nullptr, 0.0f, WICBitmapPaletteTypeCustom);
-	if (FAILED(convhr)) { WINTRACE(L"MJPEG: WIC format converter Initialize failed 0x%08X", convhr); return convhr; }
+	auto& frame = _frames.Back();
+	if (!frame.data.Resize(jpegSize))
+		return;
+
+	memcpy(frame.data.Data(), jpeg, jpegSize);
+	frame.width = w; frame.height = h; frame.stride = 0;
+	frame.nv12 = false;
+	frame.jpeg = true;
+	frame.timing = timing;
+	_frames.Publish();
+	_hasFrame = true;
+}
 
-	// Copy pixels into contiguous BGRA buffer
+HRESULT FrameGenerator::Decode(const BYTE* data, size_t size, const FrameTiming& timing)
+{
+	// either way it's decoded, the frame is published from the back slot
+	_frames.Back().timing = timing;
 	UINT w = 0, h = 0;
-	RETURN_IF_FAILED(wicConverter->GetSize(&w, &h));
-	outW = w; outH = h;
-	UINT stride = w * 4;
-	size_t bufSize = (size_t)stride * h;
+	return DecodeJpegToBitmap(data, size, w, h);
+}
+
+HRESULT FrameGenerator::DecodeJpegToBitmap(const BYTE* jpeg, size_t jpegSize, UINT& outW, UINT& outH)
+{
+	RETURN_HR_IF(E_FAIL, !jpeg || !jpegSize);
+	WINTRACE(L"MJPEG: decoding JPEG of size %zu", jpegSize);
+	if (_decodeToNV12)
 	{
-		winrt::slim_lock_guard guard(_frameMutex);
-		_decodedRGBA.resize(bufSize);
-		_decWidth = w; _decHeight = h; _decStride = stride;
-		HRESULT cphr = wicConverter->CopyPixels(nullptr, stride, (UINT)bufSize, _decodedRGBA.data());
-		if (FAILED(cphr)) return cphr;
-		_hasFrame = true;
+		auto hr = DecodeJpegToNV12(jpeg, jpegSize);
+		RETURN_IF_FAILED(hr);
+		if (hr == S_OK)
+		{
+			outW = _targetWidth; outH = _targetHeight;
+			return S_OK;
+		}
 	}
-	WINTRACE(L"MJPEG: decoded frame %ux%u stride=%u size=%u", w, h, stride, (UINT)bufSize);
+
+	// Decode into the exchange's back slot, then publish it
+	// the decode workers never run two decodes for the same generator, so they are the exchange's only producer
+	auto& frame = _frames.Back();
+	UINT w = 0, h = 0, stride = 0;
+	RETURN_IF_FAILED(_decoder->Decode(jpeg, jpegSize, _targetWidth, _targetHeight, frame.data, &w, &h, &stride));
+	outW = w; outH = h;
+	frame.width = w; frame.height = h; frame.stride = stride;
+	frame.nv12 = false;
+	frame.jpeg = false;
+	_frames.Publish();
+	_hasFrame = true;
+
+	auto stats = _decoder->GetStats();
+	auto wic = WicDecodeContext::GetStats();
+	WINTRACE(L"MJPEG: decoded frame %ux%u stride=%u decoder:%s avg:%llu us wic objects/frame:%.2f", w, h, stride, _decoder->Name(), stats.frames ? stats.timeUs / stats.frames : 0, wic.frames ? (double)wic.objects / wic.frames : 0.0);
+	return S_OK;
+}
+
+HRESULT FrameGenerator::DecodeJpegToNV12(const BYTE* jpeg, size_t jpegSize)
+{
+	// JPEG is YCbCr 4:2:0 already: when the negotiated size is one of its IDCT scales, copy the planes out as NV12
+	// instead of going to BGRA and converting back; S_FALSE when not possible
+	UINT w = _targetWidth, h = _targetHeight;
+	auto& frame = _frames.Back();
+	auto hr = _decoder->DecodeNV12(jpeg, jpegSize, w, h, frame.data);
+	if (hr != S_OK)
+		return hr;
+
+	frame.width = w; frame.height = h; frame.stride = w;
+	frame.nv12 = true;
+	frame.jpeg = false;
+	_frames.Publish();
+	_hasFrame = true;
+
+	auto stats = _decoder->GetStats();
+	WINTRACE(L"MJPEG: decoded NV12 frame %ux%u decoder:%s avg:%llu us (BGRA avg:%llu us)", w, h, _decoder->Name(), stats.nv12Frames ? stats.nv12TimeUs / stats.nv12Frames : 0, stats.frames ? stats.timeUs / stats.frames : 0);
 	return S_OK;
 }
 
@@ -383,64 +443,213 @@ HRESULT FrameGenerator::CopyDecodedToTargetRGB(BYTE* dest, DWORD destLen, LONG d
 	return S_OK;
 }
 
-void FrameGenerator::ReaderLoop()
+void FrameGenerator::StopReader()
+{
+	if (_transport)
+	{
+		_transport->Stop();
+		_transport.reset();
+		DecodeScheduler::Instance().Unregister(this);
+		SlicePool::Instance().Release();
+	}
+}
+
+HRESULT FrameGenerator::StartReaderIfNeeded()
+{
+	if (_endpoint.host.empty())
+		return E_UNEXPECTED; // URL not set
+	if (_transport)
+		return S_OK;
+
+	_endpoint.snapshot = _snapshot;
+	_endpoint.pollIntervalMs = _fps ? 1000 / _fps : 0;
+
+	DecodeScheduler::Instance().Register(this);
+	SlicePool::Instance().Acquire();
+	auto transport = MjpegTransport::Create(_asyncTransport);
+	auto hr = transport->Start(_endpoint, this);
+	if (FAILED(hr))
+	{
+		WINTRACE(L"MJPEG: failed to start %s transport 0x%08X", _asyncTransport ? L"async" : L"sync", hr);
+		transport->Stop();
+		DecodeScheduler::Instance().Unregister(this);
+		SlicePool::Instance().Release();
+		return hr;
+	}
+
+	_transport = std::move(transport);
+	WINTRACE(L"MJPEG: %s transport started", _asyncTransport ? L"async" : L"sync");
+	return S_OK;
+}
+
+static void FillBorder(BYTE* plane, LONG pitch, UINT width, UINT height, const RECT& inside, BYTE value)
 {
-	// Initialize COM on the reader thread for WIC usage
-	HRESULT cohr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
-	bool needUninit = (cohr == S_OK);
-	WINTRACE(L"MJPEG: reader loop starting for %s:%u%s", _host.c_str(), _port, _path.c_str());
-	while (!_readerStop)
+	for (UINT y = 0; y < height; y++)
 	{
-		if (FAILED(ReadNextJpegFrame()))
+		auto row = plane + (size_t)y * pitch;
+		if (y < (UINT)inside.top || y >= (UINT)inside.bottom)
 		{
-			// brief backoff on errors
-			Sleep(50);
-			continue;
+			memset(row, value, width);
 		}
-		UINT w = 0, h = 0;
-		if (FAILED(DecodeJpegToBitmap(w, h)))
+		else
 		{
-			Sleep(10);
-			continue;
+			memset(row, value, inside.left);
+			memset(row + inside.right, value, width - inside.right);
 		}
-		// keep up with stream rate
-		Sleep(1);
 	}
-	WINTRACE(L"MJPEG: reader loop stopped.");
-	if (needUninit)
+}
+
+// Video range black around the layout's target in an NV12 image
+static void FillBorderNV12(BYTE* y, BYTE* uv, LONG pitch, const FrameLayout& layout)
+{
+	FillBorder(y, pitch, layout.dstWidth, layout.dstHeight, layout.target, 16);
+	// UV rows are half as many, one U and one V byte per two pixels keeps the byte columns of luma
+	RECT chroma{ layout.target.left, layout.target.top / 2, layout.target.right, (layout.target.bottom + 1) / 2 };
+	FillBorder(uv, pitch, (layout.dstWidth + 1) & ~1u, (layout.dstHeight + 1) / 2, chroma, 128);
+}
+
+HRESULT FrameGenerator::CopyLastOutput(IMFMediaBuffer* buffer, BYTE* scanline, LONG pitch, DWORD length)
+{
+	// nothing else writes to the sample buffers, if this is the last one it still has the pixels
+	if (buffer == _lastOutput.get())
+		return S_OK;
+
+	wil::com_ptr_nothrow<IMF2DBuffer2> last;
+	RETURN_IF_FAILED(_lastOutput->QueryInterface(IID_PPV_ARGS(&last)));
+	BYTE* src;
+	LONG srcPitch;
+	BYTE* start;
+	DWORD srcLength;
+	RETURN_IF_FAILED(last->Lock2DSize(MF2DBuffer_LockFlags_Read, &src, &srcPitch, &start, &srcLength));
+
+	auto format = PixelFormat::Find(_lastFormat);
+	const LONG rowSize = format ? (LONG)format->DefaultStride(_width) : 0;
+	auto hr = S_OK;
+	if (!format)
 	{
-		CoUninitialize();
+		hr = E_UNEXPECTED;
 	}
+	else if (srcPitch == pitch && srcLength <= length)
+	{
+		memcpy(scanline, src, srcLength);
+	}
+	else if (srcPitch >= rowSize && pitch >= rowSize && format->ImageSize(_height, srcPitch) <= srcLength && format->ImageSize(_height, pitch) <= length)
+	{
+		format->Copy(src, srcPitch, scanline, pitch, _width, _height);
+	}
+	else
+	{
+		hr = MF_E_BUFFERTOOSMALL;
+	}
+	last->Unlock2D();
+	return hr;
 }
 
-void FrameGenerator::StopReader()
+HRESULT FrameGenerator::EncodePlaceholderJpeg()
 {
-	if (_readerThread.joinable())
+	RETURN_HR_IF(E_UNEXPECTED, !_width || !_height);
+	if (!_wicFactory)
+	{
+		RETURN_IF_FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_ALL, IID_PPV_ARGS(&_wicFactory)));
+	}
+
+	wil::com_ptr_nothrow<IStream> stream;
+	RETURN_IF_FAILED(CreateStreamOnHGlobal(nullptr, TRUE, &stream));
+	wil::com_ptr_nothrow<IWICBitmapEncoder> encoder;
+	RETURN_IF_FAILED(_wicFactory->CreateEncoder(GUID_ContainerFormatJpeg, nullptr, &encoder));
+	RETURN_IF_FAILED(encoder->Initialize(stream.get(), WICBitmapEncoderNoCache));
+	wil::com_ptr_nothrow<IWICBitmapFrameEncode> encode;
+	RETURN_IF_FAILED(encoder->CreateNewFrame(&encode, nullptr));
+	RETURN_IF_FAILED(encode->Initialize(nullptr));
+	RETURN_IF_FAILED(encode->SetSize(_width, _height));
+	auto pixelFormat = GUID_WICPixelFormat24bppBGR;
+	RETURN_IF_FAILED(encode->SetPixelFormat(&pixelFormat));
+	RETURN_HR_IF(WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT, pixelFormat != GUID_WICPixelFormat24bppBGR);
+
+	// black, one row at a time
+	std::vector<BYTE> row((size_t)_width * 3);
+	for (UINT y = 0; y < _height; y++)
 	{
-		_readerStop = true;
-		_readerThread.join();
-		_readerStop = false;
+		RETURN_IF_FAILED(encode->WritePixels(1, (UINT)row.size(), (UINT)row.size(), row.data()));
 	}
+	RETURN_IF_FAILED(encode->Commit());
+	RETURN_IF_FAILED(encoder->Commit());
+
+	STATSTG stat{};
+	RETURN_IF_FAILED(stream->Stat(&stat, STATFLAG_NONAME));
+	HGLOBAL global;
+	RETURN_IF_FAILED(GetHGlobalFromStream(stream.get(), &global));
+	const auto size = (size_t)stat.cbSize.QuadPart;
+	RETURN_HR_IF(E_OUTOFMEMORY, !_placeholderJpeg.Resize(size));
+	auto data = GlobalLock(global);
+	RETURN_LAST_ERROR_IF_NULL(data);
+	memcpy(_placeholderJpeg.Data(), data, size);
+	GlobalUnlock(global);
+
+	_placeholderWidth = _width;
+	_placeholderHeight = _height;
+	WINTRACE(L"FrameGenerator: placeholder JPEG %ux%u, %zu bytes", _width, _height, size);
+	return S_OK;
 }
 
-HRESULT FrameGenerator::StartReaderIfNeeded()
+HRESULT FrameGenerator::GenerateJpeg(IMFSample* sample, const DecodedFrame* frame, IMFSample** outSample)
 {
-	if (_host.empty())
-		return E_UNEXPECTED; // URL not set
-	if (_readerThread.joinable())
-		return S_OK;
-	_readerStop = false;
-	try
+	// the type promises the negotiated size: a JPEG of another size (the camera isn't at the configured
+	// resolution) is flagged and not passed on, the placeholder is
+	if (frame && (frame->width != _width || frame->height != _height))
 	{
-		_readerThread = std::thread([this]() { this->ReaderLoop(); });
-		WINTRACE(L"MJPEG: reader thread started");
-		return S_OK;
+		WINTRACE(L"FrameGenerator::GenerateJpeg JPEG is %ux%u, negotiated %ux%u, mismatched:%llu", frame->width, frame->height, _width, _height, _mismatchedJpegs.load());
+		frame = nullptr;
+	}
+
+	// compressed samples vary in size, MediaStream hands over samples without buffers for this type
+	RETURN_IF_FAILED(sample->RemoveAllBuffers());
+	if (frame && _lastOutput && frame->sequence == _lastSequence && _lastFormat == MFVideoFormat_MJPG)
+	{
+		// same JPEG as the last sample: its buffer is only read downstream, share it
+		RETURN_IF_FAILED(sample->AddBuffer(_lastOutput.get()));
+		_repeatedFrames++;
 	}
-	catch (...)
+	else
 	{
-		WINTRACE(L"MJPEG: failed to start reader thread");
-		return E_FAIL;
+		const FrameBuffer* jpeg = frame ? &frame->data : nullptr;
+		if (!jpeg)
+		{
+			if (_placeholderJpeg.Empty() || _placeholderWidth != _width || _placeholderHeight != _height)
+			{
+				RETURN_IF_FAILED(EncodePlaceholderJpeg());
+			}
+			jpeg = &_placeholderJpeg;
+		}
+
+		wil::com_ptr_nothrow<IMFMediaBuffer> buffer;
+		RETURN_IF_FAILED(MFCreateMemoryBuffer((DWORD)jpeg->Size(), &buffer));
+		BYTE* data;
+		RETURN_IF_FAILED(buffer->Lock(&data, nullptr, nullptr));
+		memcpy(data, jpeg->Data(), jpeg->Size());
+		buffer->Unlock();
+		RETURN_IF_FAILED(buffer->SetCurrentLength((DWORD)jpeg->Size()));
+		RETURN_IF_FAILED(sample->AddBuffer(buffer.get()));
+
+		if (frame)
+		{
+			_lastOutput = buffer;
+			_lastSequence = frame->sequence;
+			_lastFormat = MFVideoFormat_MJPG;
+		}
+		else
+		{
+			_lastOutput.reset();
+		}
 	}
+	RETURN_IF_FAILED(sample->SetUINT32(MFSampleExtension_CleanPoint, TRUE));
+
+	_generated = frame ? frame->timing : FrameTiming();
+	_frame++;
+	sample->AddRef();
+	*outSample = sample;
+	WINTRACE(L"FrameGenerator::Generate MJPG passthrough success, frame:%u placeholder:%d repeated:%llu", _frame, frame ? 0 : 1, _repeatedFrames);
+	return S_OK;
 }
 
 HRESULT FrameGenerator::Generate(IMFSample* sample, REFGUID format, IMFSample** outSample)
@@ -450,10 +659,49 @@ HRESULT FrameGenerator::Generate(IMFSample* sample, REFGUID format, IMFSample**
 	RETURN_HR_IF_NULL(E_POINTER, outSample);
 	*outSample = nullptr;
 
+	// MJPG passthrough publishes the JPEGs from the transport thread instead of decoding them; switching restarts
+	// the reader, so the exchange never has two producers
+	const bool passthrough = format == MFVideoFormat_MJPG;
+	if (passthrough != _passthrough)
+	{
+		StopReader();
+		_passthrough = passthrough;
+	}
+
 	// Ensure background reader is running; don't block Generate
 	(void)StartReaderIfNeeded();
-	bool haveFrame = _hasFrame;
-	UINT decodedW = _decWidth, decodedH = _decHeight;
+	_decodeToNV12 = format == MFVideoFormat_NV12 && !HasD3DManager();
+	DecodeScheduler::Stats stats{};
+	if (DecodeScheduler::Instance().GetStats(this, &stats))
+	{
+		WINTRACE(L"FrameGenerator::Generate decode queue:%zu submitted:%llu decoded:%llu dropped:%llu", stats.queueDepth, stats.submitted, stats.decoded, stats.dropped);
+	}
+	if (_transport)
+	{
+		auto transport = _transport->GetStats();
+		WINTRACE(L"FrameGenerator::Generate transport waits:%llu waited:%llu ms reconnects:%llu", transport.waits, transport.waitTimeMs, transport.reconnects);
+	}
+	auto slices = SlicePool::Instance().GetStats();
+	WINTRACE(L"FrameGenerator::Generate slices jobs:%llu bands:%llu stolen:%llu kernel:%S", slices.jobs, slices.bands, slices.stolenBands, RGB32ToNV12Kernel());
+	WINTRACE(L"FrameGenerator::Generate scaler filter:%u kernel:%S", (UINT)_resampler.Filter(), Resampler::Kernel());
+	WINTRACE(L"FrameGenerator::Generate repeated frames (conversions saved):%llu", _repeatedFrames);
+	auto pool = FrameBufferPool::Instance().GetStats();
+	WINTRACE(L"FrameGenerator::Generate buffers hits:%llu misses:%llu resident:%zu peak:%zu free:%zu", pool.hits, pool.misses, pool.residentBytes, pool.peakResidentBytes, pool.freeBytes);
+	// borrowed from the exchange, the decoder never writes to it while we hold it
+	const DecodedFrame* frame = _hasFrame ? &_frames.Latest() : nullptr;
+	bool haveFrame = frame && !frame->data.Empty() && frame->jpeg == passthrough; // not one left from the other mode
+	if (haveFrame)
+	{
+		auto exchange = _frames.GetStats();
+		WINTRACE(L"FrameGenerator::Generate frame age:%llu ms published:%llu overwritten:%llu", (MFGetSystemTime() - frame->published) / 10000, exchange.published, exchange.overwritten);
+	}
+
+	if (passthrough)
+		return GenerateJpeg(sample, haveFrame ? frame : nullptr, outSample);
+
+	// everything else is written (or converted to by the GPU) from BGRA pictures, as the format's table entry says
+	auto pixelFormat = PixelFormat::Find(format);
+	RETURN_HR_IF(MF_E_INVALIDMEDIATYPE, !pixelFormat);
 
 	// build a sample using either D3D/DXGI (GPU) or WIC (CPU)
 	wil::com_ptr_nothrow<IMFMediaBuffer> mediaBuffer;
@@ -466,30 +714,53 @@ HRESULT FrameGenerator::Generate(IMFSample* sample, REFGUID format, IMFSample**
 		RETURN_IF_FAILED(MFCreateDXGISurfaceBuffer(__uuidof(ID3D11Texture2D), _texture.get(), 0, 0, &mediaBuffer));
 		RETURN_IF_FAILED(sample->AddBuffer(mediaBuffer.get()));
 
-		// The reader thread stored decoded frame in _decodedRGBA; draw into GPU surface
+		// The decode workers published the decoded frame to _frames; draw into GPU surface
 		// If requested format is NV12, convert using GPU Video Processor MFT
 		{
 			// Render either the decoded buffer or an animated spinner placeholder to GPU target
 			_renderTarget->BeginDraw();
-			_renderTarget->Clear(D2D1::ColorF(0, 0, 0, 1));
-			if (haveFrame)
+			if (haveFrame && !frame->nv12)
 			{
-				winrt::slim_lock_guard guard(_frameMutex);
-				if (!_decodedRGBA.empty())
+				// the texture is reused from frame to frame, the border only needs clearing when the layout changes
+				auto& layout = UpdateLayout(frame->width, frame->height);
+				if (!_targetBorder)
 				{
-					// Create a WIC bitmap from memory
-					wil::com_ptr_nothrow<IWICBitmap> memBmp;
-					if (!_wicFactory)
-					{
-						RETURN_IF_FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_ALL, IID_PPV_ARGS(&_wicFactory)));
-					}
-					RETURN_IF_FAILED(_wicFactory->CreateBitmapFromMemory(decodedW, decodedH, GUID_WICPixelFormat32bppPBGRA, _decStride, (UINT)_decodedRGBA.size(), _decodedRGBA.data(), &memBmp));
-					wil::com_ptr_nothrow<ID2D1Bitmap> d2dBitmap;
-					RETURN_IF_FAILED(_renderTarget->CreateBitmapFromWicBitmap(memBmp.get(), &d2dBitmap));
-					_renderTarget->DrawBitmap(d2dBitmap.get(), D2D1::RectF(0, 0, (FLOAT)_width, (FLOAT)_height), 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_LINEAR);
+					_renderTarget->Clear(D2D1::ColorF(0, 0, 0, 1));
+					_targetBorder = true;
+				}
+
+				// upload into one of the persistent bitmaps, not the one the previous sample was drawn from
+				auto plan = _uploads.Next(frame->width, frame->height, frame->sequence);
+				auto& bitmap = _uploadBitmaps[plan.slot];
+				HRESULT uhr = S_OK;
+				if (plan.create)
+				{
+					bitmap.reset();
+					auto props = D2D1::BitmapProperties(D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+					uhr = _renderTarget->CreateBitmap(D2D1::SizeU(frame->width, frame->height), props, &bitmap);
+					WINTRACE(L"FrameGenerator::Generate upload bitmap %u created %ux%u hr:0x%08X", plan.slot, frame->width, frame->height, uhr);
+				}
+				if (SUCCEEDED(uhr) && plan.upload)
+				{
+					uhr = bitmap->CopyFromMemory(nullptr, frame->data.Data(), frame->stride);
+				}
+				if (FAILED(uhr))
+				{
+					_uploads.Invalidate(plan.slot);
+					_renderTarget->EndDraw();
+					return uhr;
 				}
+
+				auto target = D2D1::RectF((FLOAT)layout.target.left, (FLOAT)layout.target.top, (FLOAT)layout.target.right, (FLOAT)layout.target.bottom);
+				auto source = D2D1::RectF((FLOAT)layout.source.left, (FLOAT)layout.source.top, (FLOAT)layout.source.right, (FLOAT)layout.source.bottom);
+				_renderTarget->DrawBitmap(bitmap.get(), target, 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_LINEAR, source);
 			}
 			else
+			{
+				_renderTarget->Clear(D2D1::ColorF(0, 0, 0, 1));
+				_targetBorder = false;
+			}
+			if (!haveFrame)
 			{
 				// Animated spinner: 12 fading ticks rotating
 				const float cx = (FLOAT)_width * 0.5f;
@@ -522,9 +793,13 @@ HRESULT FrameGenerator::Generate(IMFSample* sample, REFGUID format, IMFSample**
 			}
 			RETURN_IF_FAILED(_renderTarget->EndDraw());
 		}
-		if (format == MFVideoFormat_NV12)
+		if (format != MFVideoFormat_RGB32)
 		{
 			assert(_converter);
+			if (_converterFormat != format)
+			{
+				RETURN_IF_FAILED(SetConverterOutputType(format, _width, _height));
+			}
 			RETURN_IF_FAILED(_converter->ProcessInput(0, sample, 0));
 
 			// let converter build the sample for us, note it works because we gave it the D3DManager
@@ -547,8 +822,9 @@ HRESULT FrameGenerator::Generate(IMFSample* sample, REFGUID format, IMFSample**
 			*outSample = sample;
 		}
 
+		_generated = haveFrame && !frame->nv12 ? frame->timing : FrameTiming();
 		_frame++;
-		WINTRACE(L"FrameGenerator::Generate GPU path success, frame:%u format:%s", _frame, (format == MFVideoFormat_NV12) ? L"NV12" : L"RGB32");
+		WINTRACE(L"FrameGenerator::Generate GPU path success, frame:%u format:%s", _frame, pixelFormat->name);
 		return S_OK;
 	}
 
@@ -563,187 +839,166 @@ HRESULT FrameGenerator::Generate(IMFSample* sample, REFGUID format, IMFSample**
 	if (FAILED(lhr)) { WINTRACE(L"FrameGenerator::Generate Lock2DSize failed 0x%08X", lhr); return lhr; }
 
 	HRESULT hr = S_OK;
-	// We'll scale to negotiated size (_width x _height) if needed using WIC on CPU
-	std::vector<BYTE> localRGBA; UINT srcW = 0, srcH = 0, srcStride = 0;
+	bool spinner = false;
 	if (haveFrame)
 	{
-		winrt::slim_lock_guard guard(_frameMutex);
-		if (_decodedRGBA.empty()) { hr = MF_E_NOT_AVAILABLE; }
-		else {
-			srcW = _decWidth; srcH = _decHeight; srcStride = _decStride;
-			localRGBA = _decodedRGBA; // copy to avoid holding lock during scale
-		}
+		_spinner.Reset(); // the sample buffers get pictures now
 	}
-	else
+
+	// no new picture since the last sample (slow cameras send a few per second into a 30 fps stream): its pixels are
+	// in that sample's buffer, copy them rather than scaling and converting the same picture again
+	bool repeated = false;
+	if (haveFrame && _lastOutput && frame->sequence == _lastSequence && format == _lastFormat)
 	{
-		// No frame decoded yet
-		hr = MF_E_NOT_AVAILABLE;
+		auto rhr = CopyLastOutput(mediaBuffer.get(), scanline, pitch, length);
+		if (FAILED(rhr)) WINTRACE(L"FrameGenerator::Generate copy of the last output failed 0x%08X", rhr);
+		repeated = SUCCEEDED(rhr);
+		if (repeated)
+		{
+			_repeatedFrames++;
+		}
 	}
-	if (SUCCEEDED(hr))
+
+	// a frame decoded straight to NV12 only needs copying, or scaling both planes, into the sample
+	bool copiedNV12 = false;
+	if (!repeated && haveFrame && format == MFVideoFormat_NV12)
 	{
-		BYTE* srcPtr = localRGBA.data();
-		UINT workStride = srcStride;
-		std::vector<BYTE> scaled;
-		if (srcW != _width || srcH != _height)
+		if (frame->nv12 && length >= (DWORD)pitch * _height * 3 / 2)
 		{
-			// Use a local WIC factory to scale to the negotiated size
-			wil::com_ptr_nothrow<IWICImagingFactory> wicFactory;
-			hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_ALL, IID_PPV_ARGS(&wicFactory));
-			if (SUCCEEDED(hr))
+			auto& layout = UpdateLayout(frame->width, frame->height);
+			if (layout.IsCopy())
 			{
-				wil::com_ptr_nothrow<IWICBitmap> srcBmp;
-				hr = wicFactory->CreateBitmapFromMemory(srcW, srcH, GUID_WICPixelFormat32bppPBGRA, srcStride, (UINT)localRGBA.size(), srcPtr, &srcBmp);
-				if (SUCCEEDED(hr))
+				const BYTE* src = frame->data.Data();
+				for (UINT y = 0; y < _height * 3 / 2; ++y)
 				{
-					wil::com_ptr_nothrow<IWICBitmapScaler> scaler;
-					hr = wicFactory->CreateBitmapScaler(&scaler);
-					if (SUCCEEDED(hr))
-					{
-						hr = scaler->Initialize(srcBmp.get(), _width, _height, WICBitmapInterpolationModeFant);
-						if (SUCCEEDED(hr))
-						{
-							scaled.resize((size_t)_width * 4 * _height);
-							hr = scaler->CopyPixels(nullptr, _width * 4, (UINT)scaled.size(), scaled.data());
-							if (FAILED(hr)) WINTRACE(L"CPU scale CopyPixels failed 0x%08X", hr);
-							if (SUCCEEDED(hr))
-							{
-								srcPtr = scaled.data();
-								workStride = _width * 4;
-								srcW = _width; srcH = _height;
-							}
-						}
-						else { WINTRACE(L"CPU scaler Initialize failed 0x%08X", hr); }
-					}
-					else { WINTRACE(L"CreateBitmapScaler failed 0x%08X", hr); }
+					memcpy(scanline + (size_t)y * pitch, src + (size_t)y * frame->stride, _width);
 				}
-				else { WINTRACE(L"CreateBitmapFromMemory failed 0x%08X", hr); }
+				copiedNV12 = true;
 			}
-			if (FAILED(hr))
+			else
 			{
-				WINTRACE(L"MJPEG: CPU scale failed 0x%08X (src %ux%u -> dst %ux%u), falling back to center-crop/copy", hr, srcW, srcH, _width, _height);
-				// Center-crop/copy into destination-sized RGBA buffer so downstream sees negotiated size
-				scaled.assign((size_t)_width * 4 * _height, 0);
-				UINT copyW = (std::min)(srcW, _width);
-				UINT copyH = (std::min)(srcH, _height);
-				UINT srcX0 = (srcW > copyW) ? (srcW - copyW) / 2 : 0;
-				UINT srcY0 = (srcH > copyH) ? (srcH - copyH) / 2 : 0;
-				UINT dstX0 = (_width > copyW) ? (_width - copyW) / 2 : 0;
-				UINT dstY0 = (_height > copyH) ? (_height - copyH) / 2 : 0;
-				for (UINT y = 0; y < copyH; ++y)
+				// samples come from a pool, the border has to be written every time, but only the border
+				const BYTE* srcY = frame->data.Data();
+				const BYTE* srcUV = srcY + (size_t)frame->height * frame->stride;
+				BYTE* dstUV = scanline + (size_t)_height * pitch;
+				if (layout.HasBorder())
 				{
-					const BYTE* srow = srcPtr + (size_t)(y + srcY0) * workStride + (size_t)srcX0 * 4;
-					BYTE* drow = scaled.data() + (size_t)(y + dstY0) * (_width * 4) + (size_t)dstX0 * 4;
-					memcpy(drow, srow, (size_t)copyW * 4);
+					FillBorderNV12(scanline, dstUV, pitch, layout);
 				}
-				srcPtr = scaled.data();
-				workStride = _width * 4;
-				srcW = _width; srcH = _height;
-				hr = S_OK;
+				auto shr = _resampler.ScaleNV12(
+					srcY + (size_t)layout.source.top * frame->stride + layout.source.left,
+					srcUV + (size_t)(layout.source.top / 2) * frame->stride + layout.source.left,
+					layout.SourceWidth(), layout.SourceHeight(), frame->stride,
+					scanline + (size_t)layout.target.top * pitch + layout.target.left,
+					dstUV + (size_t)(layout.target.top / 2) * pitch + layout.target.left,
+					layout.TargetWidth(), layout.TargetHeight(), pitch);
+				if (FAILED(shr)) WINTRACE(L"CPU NV12 scale failed 0x%08X (src %ux%u -> dst %ux%u)", shr, frame->width, frame->height, _width, _height);
+				copiedNV12 = SUCCEEDED(shr);
 			}
 		}
+	}
 
-		if (format == MFVideoFormat_NV12)
-		{
-			hr = RGB32ToNV12(srcPtr, (ULONG)(workStride * srcH), (LONG)workStride, srcW, srcH, scanline, length, pitch);
-			if (FAILED(hr)) WINTRACE(L"RGB32ToNV12 failed 0x%08X (src %ux%u stride %u) destLen:%u pitch:%ld", hr, srcW, srcH, workStride, length, pitch);
-		}
-		else
-		{
-			const UINT rows = (srcH < (UINT)(length / pitch)) ? srcH : (UINT)(length / pitch);
-			const UINT copyStride = (workStride < (UINT)pitch) ? workStride : (UINT)pitch;
-			for (UINT y = 0; y < rows; ++y)
-			{
-				memcpy(scanline + y * pitch, srcPtr + y * workStride, copyStride);
-			}
+	// We'll scale to negotiated size (_width x _height) if needed on CPU
+	UINT srcW = 0, srcH = 0, srcStride = 0;
+	if (repeated || copiedNV12)
+	{
+		hr = S_OK;
+	}
+	else if (haveFrame)
+	{
+		if (frame->nv12) { hr = MF_E_NOT_AVAILABLE; }
+		else {
+			srcW = frame->width; srcH = frame->height; srcStride = frame->stride;
 		}
 	}
 	else
 	{
-		// No MJPEG frame yet: draw an animated spinner placeholder into an RGBA scratch buffer
-		std::vector<BYTE> rgba;
-		rgba.assign((size_t)_width * 4 * _height, 0);
-
-		auto putPixel = [&](int x, int y, BYTE r, BYTE g, BYTE b, BYTE a)
-		{
-			if (x < 0 || y < 0 || x >= (int)_width || y >= (int)_height) return;
-			size_t idx = (size_t)y * ((size_t)_width * 4) + (size_t)x * 4;
-			rgba[idx + 0] = b;
-			rgba[idx + 1] = g;
-			rgba[idx + 2] = r;
-			rgba[idx + 3] = a;
-		};
-
-		auto drawLineThick = [&](float x0, float y0, float x1, float y1, int thickness, BYTE r, BYTE g, BYTE b, BYTE a)
+		// No frame decoded yet
+		hr = MF_E_NOT_AVAILABLE;
+	}
+	if (repeated || copiedNV12)
+	{
+		// already in the sample
+	}
+	else if (SUCCEEDED(hr))
+	{
+		const BYTE* srcPtr = frame->data.Data();
+		UINT workStride = srcStride;
+		auto& layout = UpdateLayout(srcW, srcH);
+		if (!layout.IsCopy())
 		{
-			// Simple DDA with normal offsets for thickness
-			float dx = x1 - x0, dy = y1 - y0;
-			float steps = fabsf(dx) > fabsf(dy) ? fabsf(dx) : fabsf(dy);
-			if (steps < 1.0f) steps = 1.0f;
-			float sx = dx / steps, sy = dy / steps;
-			for (int i = 0; i <= (int)steps; ++i)
+			// the fitted picture keeps its border from frame to frame, it's only filled when the layout changes;
+			// the decoder already did the bulk of a large downscale with its IDCT scaling, this does the rest
+			const auto previous = _fitted.Data();
+			if (!_fitted.Resize((size_t)_width * 4 * _height))
 			{
-				float x = x0 + sx * i;
-				float y = y0 + sy * i;
-				// normal vector
-				float nx = -sy, ny = sx;
-				float nl = sqrtf(nx * nx + ny * ny);
-				if (nl > 0.0f) { nx /= nl; ny /= nl; }
-				for (int t = -thickness; t <= thickness; ++t)
+				hr = E_OUTOFMEMORY;
+			}
+			else
+			{
+				if (!_fittedBorder || _fitted.Data() != previous)
 				{
-					int px = (int)lroundf(x + nx * t);
-					int py = (int)lroundf(y + ny * t);
-					putPixel(px, py, r, g, b, a);
+					memset(_fitted.Data(), 0, _fitted.Size());
+					_fittedBorder = true;
 				}
+
+				hr = _resampler.ScaleBGRA(srcPtr + (size_t)layout.source.top * srcStride + (size_t)layout.source.left * 4, layout.SourceWidth(), layout.SourceHeight(), (LONG)srcStride,
+					_fitted.Data() + (size_t)layout.target.top * _width * 4 + (size_t)layout.target.left * 4, layout.TargetWidth(), layout.TargetHeight(), (LONG)(_width * 4));
+				if (FAILED(hr))
+				{
+					WINTRACE(L"MJPEG: CPU scale failed 0x%08X (src %ux%u -> dst %ux%u), falling back to center-crop/copy", hr, srcW, srcH, _width, _height);
+					// Center-crop/copy into destination-sized RGBA buffer so downstream sees negotiated size
+					memset(_fitted.Data(), 0, _fitted.Size());
+					_fittedBorder = false;
+					UINT copyW = (std::min)(srcW, _width);
+					UINT copyH = (std::min)(srcH, _height);
+					UINT srcX0 = (srcW > copyW) ? (srcW - copyW) / 2 : 0;
+					UINT srcY0 = (srcH > copyH) ? (srcH - copyH) / 2 : 0;
+					UINT dstX0 = (_width > copyW) ? (_width - copyW) / 2 : 0;
+					UINT dstY0 = (_height > copyH) ? (_height - copyH) / 2 : 0;
+					for (UINT y = 0; y < copyH; ++y)
+					{
+						const BYTE* srow = srcPtr + (size_t)(y + srcY0) * workStride + (size_t)srcX0 * 4;
+						BYTE* drow = _fitted.Data() + (size_t)(y + dstY0) * (_width * 4) + (size_t)dstX0 * 4;
+						memcpy(drow, srow, (size_t)copyW * 4);
+					}
+					hr = S_OK;
+				}
+				srcPtr = _fitted.Data();
+				workStride = _width * 4;
+				srcW = _width; srcH = _height;
 			}
-		};
-
-		// Spinner parameters
-		const float cx = (float)_width * 0.5f;
-		const float cy = (float)_height * 0.5f;
-		const float radius = (float)((std::min)(_width, _height) * 0.25f);
-		const float tickLen = radius * 0.35f;
-		const float r0 = radius - tickLen;
-		const float r1 = radius;
-		const int N = 12;
-		const float twoPi = 6.28318530718f;
-		const LONGLONG now100 = MFGetSystemTime();
-		const float ms = (float)(now100 / 10000.0);
-		const float base = fmodf(ms, 1200.0f) / 1200.0f * twoPi;
-		const int stroke = (int)std::max<UINT>(2u, (std::min)(_width, _height) / 120);
-		for (int i = 0; i < N; ++i)
-		{
-			float a = base + (twoPi * i) / N;
-			float fade = powf(0.75f, (float)((N - 1) - i));
-			BYTE v = (BYTE)std::clamp<int>((int)(fade * 255.0f), 40, 255);
-			float x0 = cx + r0 * cosf(a);
-			float y0 = cy + r0 * sinf(a);
-			float x1 = cx + r1 * cosf(a);
-			float y1 = cy + r1 * sinf(a);
-			drawLineThick(x0, y0, x1, y1, stroke, v, v, v, 255);
 		}
 
-		if (format == MFVideoFormat_NV12)
-		{
-			// Convert spinner RGBA to NV12
-			hr = RGB32ToNV12(rgba.data(), (ULONG)rgba.size(), (LONG)(_width * 4), _width, _height, scanline, length, pitch);
-		}
-		else
+		hr = pixelFormat->fromRGB32(srcPtr, (ULONG)(workStride * srcH), (LONG)workStride, srcW, srcH, scanline, length, pitch, YuvMatrix::BT601, YuvRange::Limited);
+		if (FAILED(hr)) WINTRACE(L"RGB32 to %s failed 0x%08X (src %ux%u stride %u) destLen:%u pitch:%ld", pixelFormat->name, hr, srcW, srcH, workStride, length, pitch);
+	}
+	else
+	{
+		// No MJPEG frame yet: animated spinner placeholder, rendered once per size
+		spinner = true;
+		hr = _spinner.Prepare(_width, _height, *pixelFormat);
+		if (SUCCEEDED(hr))
 		{
-			// Copy RGBA into destination
-			const BYTE* src = rgba.data();
-			const UINT workStride = _width * 4;
-			const UINT rows = (UINT)std::min<DWORD>((DWORD)_height, length / (DWORD)pitch);
-			for (UINT y = 0; y < rows; ++y)
-			{
-				memcpy(scanline + (size_t)y * pitch, src + (size_t)y * workStride, (size_t)std::min<LONG>((LONG)workStride, pitch));
-			}
+			hr = _spinner.Write(MFGetSystemTime(), scanline, pitch, length);
 		}
-		hr = S_OK;
 	}
 
 	buffer2D->Unlock2D();
+	if (SUCCEEDED(hr) && !spinner)
+	{
+		_lastOutput = mediaBuffer;
+		_lastSequence = frame->sequence;
+		_lastFormat = format;
+	}
+	else
+	{
+		_lastOutput.reset();
+	}
+
 	if (SUCCEEDED(hr))
 	{
+		_generated = spinner ? FrameTiming() : frame->timing;
 		_frame++;
 		sample->AddRef();
 		*outSample = sample;
@@ -761,11 +1016,14 @@ HRESULT FrameGenerator::SetResolution(UINT width, UINT height)
 	WINTRACE(L"FrameGenerator::SetResolution %ux%u", width, height);
 	_width = width;
 	_height = height;
+	_targetWidth = width;
+	_targetHeight = height;
 	
 	// Clear any cached resources that depend on resolution
 	_texture.reset();
 	_renderTarget.reset();
 	_bitmap.reset();
+	_lastOutput.reset();
 	
 	return S_OK;
 }
@@ -2,11 +2,18 @@
 
 #include <string>
 #include <vector>
-#include <winhttp.h>
-#include <thread>
 #include <atomic>
+#include "MjpegSplitter.h"
+#include "MjpegTransport.h"
+#include "DecodeScheduler.h"
+#include "JpegDecoder.h"
+#include "FrameExchange.h"
+#include "Resampler.h"
+#include "FrameLayout.h"
+#include "Spinner.h"
+#include "UploadSlots.h"
 
-class FrameGenerator
+class FrameGenerator : private MjpegTransportSink, private DecodeClient
 {
 	UINT _width;
 	UINT _height;
@@ -21,46 +28,72 @@ class FrameGenerator
 	wil::com_ptr_nothrow<IDWriteTextFormat> _textFormat;
 	wil::com_ptr_nothrow<IDWriteFactory> _dwrite;
 	wil::com_ptr_nothrow<IMFTransform> _converter;
+	GUID _converterFormat = GUID_NULL; // GPU path: output subtype of _converter
 	wil::com_ptr_nothrow<IWICBitmap> _bitmap;
 	wil::com_ptr_nothrow<IMFDXGIDeviceManager> _dxgiManager;
+	// GPU path: decoded frames are uploaded in place into these, in turn
+	wil::com_ptr_nothrow<ID2D1Bitmap> _uploadBitmaps[UploadSlots::Count];
+	UploadSlots _uploads;
 
 	// Network MJPEG streaming state
-	HINTERNET _hSession = nullptr;
-	HINTERNET _hConnect = nullptr;
-	HINTERNET _hRequest = nullptr;
-	std::wstring _host;
-	INTERNET_PORT _port;
-	std::wstring _path;
-	bool _useHttps = false;
-	std::vector<BYTE> _mjpegBuffer; // rolling buffer for parsing JPEG frames
-	std::vector<BYTE> _lastJpeg;    // last full JPEG frame extracted
+	MjpegEndpoint _endpoint;
+	std::unique_ptr<MjpegTransport> _transport;
+	bool _asyncTransport = true;    // WinHTTP async callbacks instead of a blocking reader thread
+	bool _snapshot = false;         // poll a single-JPEG URL instead of reading a stream
+	JpegDecoder* _decoder = JpegDecoder::Get(JpegDecoderType::Wic);
+	std::atomic<UINT> _targetWidth{ 0 };  // negotiated size, read by the decode workers to pick an IDCT scale
+	std::atomic<UINT> _targetHeight{ 0 };
+	MjpegSplitter _splitter;        // ingest buffer and incremental JPEG frame extraction from the HTTP stream
+	CaptureClock _captureClock;     // transport thread: server timestamps to capture times
+	ULONGLONG _jpegIndex = 0;       // transport thread: JPEGs read so far, including those never decoded
+	FrameTiming _generated;         // picture of the last sample Generate wrote, index 0 for a placeholder
 	wil::com_ptr_nothrow<IWICImagingFactory> _wicFactory;
 	wil::com_ptr_nothrow<IWICFormatConverter> _wicConverter; // ensure 32bppPBGRA for render
 
-	// Decoded frame storage (RGBA32) produced by reader thread
-	winrt::slim_mutex _frameMutex;
-	std::vector<BYTE> _decodedRGBA;
-	UINT _decWidth = 0;
-	UINT _decHeight = 0;
-	UINT _decStride = 0; // bytes per row
+	// Decoded frames (BGRA, or NV12 when decoded straight to it) passed from the decode workers to Generate
+	FrameExchange _frames;
 	std::atomic<bool> _hasFrame{ false };
+	std::atomic<bool> _decodeToNV12{ false }; // CPU NV12 output: ask the decoder for YCbCr planes instead of BGRA
+	std::atomic<bool> _passthrough{ false };  // MJPG output: the transport publishes JPEGs as is, nothing is decoded
+	std::atomic<ULONGLONG> _mismatchedJpegs{ 0 }; // passthrough JPEGs whose size isn't the negotiated one
+	FrameBuffer _placeholderJpeg;   // MJPG output: black JPEG at the negotiated size, until a matching one arrives
+	UINT _placeholderWidth = 0;
+	UINT _placeholderHeight = 0;
+	Resampler _resampler;           // CPU scaling to the negotiated size, used by Generate only
+	FitMode _fitMode = FitMode::Stretch;
+	FrameLayout _layout;            // for the last decoded size, see UpdateLayout
+	FrameBuffer _fitted;            // CPU path: output-sized BGRA picture, its border kept from frame to frame
+	bool _fittedBorder = false;     // _fitted has the current layout's border
+	bool _targetBorder = false;     // the GPU render target has it
+	Spinner _spinner;               // CPU path placeholder until the first frame is decoded
+	wil::com_ptr_nothrow<IMFMediaBuffer> _lastOutput; // CPU path: buffer of the last sample, holding _lastSequence's pixels
+	ULONGLONG _lastSequence = 0;
+	GUID _lastFormat = GUID_NULL;
+	ULONGLONG _repeatedFrames = 0;  // samples copied from the last one instead of converted
 
-	// Reader thread management
-	std::thread _readerThread;
-	std::atomic<bool> _readerStop{ false };
-	void ReaderLoop();
+	// MjpegTransportSink
+	void OnResponse(DWORD statusCode, const std::string& contentType) override;
+	BYTE* GetReadBuffer(DWORD size) override;
+	bool OnData(DWORD size) override;
+	void OnError(HRESULT hr) override;
 
-	HRESULT EnsureHttpOpen();
-	HRESULT EnsureRequest();
-	HRESULT ReadNextJpegFrame();
-	HRESULT DecodeJpegToBitmap(UINT& outW, UINT& outH);
+	// DecodeClient, called on a DecodeScheduler worker
+	HRESULT Decode(const BYTE* data, size_t size, const FrameTiming& timing) override;
+
+	void PublishJpeg(const BYTE* jpeg, size_t jpegSize, const FrameTiming& timing);
+	HRESULT DecodeJpegToBitmap(const BYTE* jpeg, size_t jpegSize, UINT& outW, UINT& outH);
+	HRESULT DecodeJpegToNV12(const BYTE* jpeg, size_t jpegSize);
 	HRESULT CopyDecodedToTargetRGB(BYTE* dest, DWORD destLen, LONG destStride);
+	HRESULT CopyLastOutput(IMFMediaBuffer* buffer, BYTE* scanline, LONG pitch, DWORD length);
+	HRESULT EncodePlaceholderJpeg();
+	HRESULT GenerateJpeg(IMFSample* sample, const DecodedFrame* frame, IMFSample** outSample);
 	void StopReader();
 	HRESULT StartReaderIfNeeded();
 
-	static bool FindJpegInBuffer(const std::vector<BYTE>& buf, size_t& start, size_t& end);
-
 	HRESULT CreateRenderTargetResources(UINT width, UINT height);
+	HRESULT SetConverterOutputType(REFGUID subtype, UINT width, UINT height);
+	// Layout of a decoded picture in the negotiated size, recomputed (and borders invalidated) when either changes
+	const FrameLayout& UpdateLayout(UINT width, UINT height);
 
 public:
 	FrameGenerator() :
@@ -71,7 +104,6 @@ public:
 		_deviceHandle(nullptr),
 		_prevTime(MFGetSystemTime())
 	{
-		_port = INTERNET_DEFAULT_HTTP_PORT;
 	}
 
 	~FrameGenerator()
@@ -86,10 +118,7 @@ public:
 		}
 
 		StopReader();
-
-		if (_hRequest) { WinHttpCloseHandle(_hRequest); _hRequest = nullptr; }
-		if (_hConnect) { WinHttpCloseHandle(_hConnect); _hConnect = nullptr; }
-		if (_hSession) { WinHttpCloseHandle(_hSession); _hSession = nullptr; }
+		FrameBufferPool::Instance().Trim();
 	}
 
 	HRESULT SetD3DManager(IUnknown* manager, UINT width, UINT height);
@@ -99,7 +128,20 @@ public:
 
 	// Configure MJPEG source URL of the form: http(s)://host[:port]/path
 	HRESULT SetMjpegUrl(const wchar_t* url);
+	// Select the asynchronous WinHTTP transport (default) or a blocking reader thread; restarts the reader
+	HRESULT SetAsyncTransport(bool async);
+	// Poll a snapshot URL (one JPEG per request) at the negotiated frame rate instead of reading a stream
+	HRESULT SetSnapshotMode(bool snapshot);
+	HRESULT SetFrameRate(UINT numerator, UINT denominator);
+	HRESULT SetJpegDecoder(JpegDecoderType type);
+	// Filter used when the CPU path scales decoded frames to the negotiated size
+	HRESULT SetScaleFilter(ResampleFilter filter);
+	// How pictures whose aspect ratio isn't the negotiated one are fitted: stretched, letterboxed or cropped
+	HRESULT SetFitMode(FitMode mode);
 
-	// Generate: fetch next MJPEG frame, decode to RGB32, then either GPU-convert to NV12 or CPU-convert
+	// Generate: fetch next MJPEG frame, decode to RGB32, then either GPU-convert or CPU-convert to the output format;
+	// for MJPG the camera's JPEG goes into the sample as is
 	HRESULT Generate(IMFSample* sample, REFGUID format, IMFSample** outSample);
+	// Capture time and index of the picture in the sample Generate returned last
+	const FrameTiming& GeneratedTiming() const { return _generated; }
 };
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+// How a decoded picture whose aspect ratio differs from the negotiated one is fitted into it
+enum class FitMode
+{
+	Stretch = 0,   // fill the output, distorting the picture
+	Letterbox = 1, // whole picture, black bars top and bottom or left and right
+	Crop = 2,      // fill the output, cutting the picture's edges
+};
+
+// Where a picture goes in the output for a fit mode: the part of the picture that is shown and the rectangle it is
+// scaled to, the rest of the output being border. Edges are on even pixels so NV12 chroma lines up with luma.
+// Computed when the picture or output size changes, not per frame.
+struct FrameLayout
+{
+	FitMode mode = FitMode::Stretch;
+	UINT srcWidth = 0;
+	UINT srcHeight = 0;
+	UINT dstWidth = 0;
+	UINT dstHeight = 0;
+	RECT source{}; // shown part of the picture
+	RECT target{}; // where it lands in the output
+
+	bool Matches(FitMode fit, UINT pictureWidth, UINT pictureHeight, UINT outputWidth, UINT outputHeight) const
+	{
+		return mode == fit && srcWidth == pictureWidth && srcHeight == pictureHeight && dstWidth == outputWidth && dstHeight == outputHeight;
+	}
+
+	UINT SourceWidth() const { return source.right - source.left; }
+	UINT SourceHeight() const { return source.bottom - source.top; }
+	UINT TargetWidth() const { return target.right - target.left; }
+	UINT TargetHeight() const { return target.bottom - target.top; }
+
+	// the output is the picture as is
+	bool IsCopy() const { return srcWidth == dstWidth && srcHeight == dstHeight && SourceWidth() == srcWidth && SourceHeight() == srcHeight; }
+	bool HasBorder() const { return TargetWidth() != dstWidth || TargetHeight() != dstHeight; }
+
+	static FrameLayout Compute(FitMode mode, UINT srcWidth, UINT srcHeight, UINT dstWidth, UINT dstHeight)
+	{
+		FrameLayout layout;
+		layout.mode = mode;
+		layout.srcWidth = srcWidth;
+		layout.srcHeight = srcHeight;
+		layout.dstWidth = dstWidth;
+		layout.dstHeight = dstHeight;
+		layout.source = { 0, 0, (LONG)srcWidth, (LONG)srcHeight };
+		layout.target = { 0, 0, (LONG)dstWidth, (LONG)dstHeight };
+		if (!srcWidth || !srcHeight || !dstWidth || !dstHeight)
+			return layout;
+
+		// compare srcWidth / srcHeight with dstWidth / dstHeight
+		const auto srcAspect = (ULONGLONG)srcWidth * dstHeight;
+		const auto dstAspect = (ULONGLONG)dstWidth * srcHeight;
+		if (srcAspect == dstAspect)
+			return layout;
+
+		const bool wider = srcAspect > dstAspect;
+		if (mode == FitMode::Letterbox)
+		{
+			if (wider)
+			{
+				Center(layout.target.top, layout.target.bottom, Span((ULONGLONG)dstWidth * srcHeight, srcWidth, dstHeight), dstHeight);
+			}
+			else
+			{
+				Center(layout.target.left, layout.target.right, Span((ULONGLONG)dstHeight * srcWidth, srcHeight, dstWidth), dstWidth);
+			}
+		}
+		else if (mode == FitMode::Crop)
+		{
+			if (wider)
+			{
+				Center(layout.source.left, layout.source.right, Span((ULONGLONG)dstWidth * srcHeight, dstHeight, srcWidth), srcWidth);
+			}
+			else
+			{
+				Center(layout.source.top, layout.source.bottom, Span((ULONGLONG)dstHeight * srcWidth, dstWidth, srcHeight), srcHeight);
+			}
+		}
+		return layout;
+	}
+
+private:
+	// numerator / denominator rounded to an even count, at most limit
+	static UINT Span(ULONGLONG numerator, ULONGLONG denominator, UINT limit)
+	{
+		auto span = (UINT)((numerator + denominator / 2) / denominator) & ~1u;
+		return std::clamp(span, std::min(2u, limit), limit);
+	}
+
+	static void Center(LONG& first, LONG& last, UINT span, UINT limit)
+	{
+		first = (LONG)(((limit - span) / 2) & ~1u);
+		last = first + (LONG)span;
+	}
+};
@@ -0,0 +1,68 @@
+#include "pch.h"
+#include "WicDecodeContext.h"
+#include "JpegDecoder.h"
+#include "TurboJpegDecoder.h"
+
+// The WIC backend and JpegDecoder::Get; the backend-independent part of JpegDecoder is in JpegDecoder.cpp and
+// the TurboJPEG backend in TurboJpegDecoder.cpp, which build outside Windows too.
+
+class WicJpegDecoder : public JpegDecoder
+{
+protected:
+	HRESULT DecodeFrame(const BYTE* jpeg, size_t size, UINT targetWidth, UINT targetHeight, FrameBuffer& bgra, UINT* width, UINT* height, UINT* stride) override
+	{
+		WicDecodeContext* context = nullptr;
+		RETURN_IF_FAILED(WicDecodeContext::ForCurrentThread(&context));
+		wil::com_ptr_nothrow<IWICBitmapFrameDecode> frame;
+		WICBitmapTransformOptions orientation;
+		RETURN_IF_FAILED(context->OpenFrame(jpeg, size, &frame, &orientation));
+
+		// the scaled path doesn't rotate, rotated frames are rare enough to take the full path
+		if (targetWidth && targetHeight && orientation == WICBitmapTransformRotate0)
+		{
+			auto hr = context->DecodeScaled(frame.get(), targetWidth, targetHeight, bgra, width, height, stride);
+			RETURN_IF_FAILED(hr);
+			if (hr == S_OK)
+				return S_OK;
+		}
+
+		wil::com_ptr_nothrow<IWICBitmapSource> source;
+		RETURN_IF_FAILED(context->Convert(frame.get(), orientation, &source));
+
+		UINT w = 0, h = 0;
+		RETURN_IF_FAILED(source->GetSize(&w, &h));
+		RETURN_HR_IF(E_OUTOFMEMORY, !bgra.Resize((size_t)w * 4 * h));
+		RETURN_IF_FAILED(source->CopyPixels(nullptr, w * 4, (UINT)bgra.Size(), bgra.Data()));
+		*width = w;
+		*height = h;
+		*stride = w * 4;
+		return S_OK;
+	}
+
+	HRESULT DecodeFrameNV12(const BYTE* jpeg, size_t size, UINT width, UINT height, FrameBuffer& nv12) override
+	{
+		WicDecodeContext* context = nullptr;
+		RETURN_IF_FAILED(WicDecodeContext::ForCurrentThread(&context));
+		wil::com_ptr_nothrow<IWICBitmapFrameDecode> frame;
+		WICBitmapTransformOptions orientation;
+		RETURN_IF_FAILED(context->OpenFrame(jpeg, size, &frame, &orientation));
+		if (orientation != WICBitmapTransformRotate0)
+			return S_FALSE;
+
+		return context->DecodePlanar(frame.get(), width, height, nv12);
+	}
+
+public:
+	const wchar_t* Name() const override { return L"WIC"; }
+};
+
+JpegDecoder* JpegDecoder::Get(JpegDecoderType type)
+{
+	static WicJpegDecoder wic;
+#if defined(WINCAMHTTP_TURBOJPEG)
+	static TurboJpegDecoder turbo(&wic);
+	if (type == JpegDecoderType::TurboJpeg)
+		return &turbo;
+#endif
+	return &wic;
+}
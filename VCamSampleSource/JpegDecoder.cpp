@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "JpegDecoder.h"
+
+HRESULT JpegDecoder::Decode(const BYTE* jpeg, size_t size, UINT targetWidth, UINT targetHeight, FrameBuffer& bgra, UINT* width, UINT* height, UINT* stride)
+{
+	RETURN_HR_IF_NULL(E_POINTER, width);
+	RETURN_HR_IF_NULL(E_POINTER, height);
+	RETURN_HR_IF_NULL(E_POINTER, stride);
+	RETURN_HR_IF(E_INVALIDARG, !jpeg || size < 4 || size > MAXDWORD);
+
+	auto start = MFGetSystemTime();
+	auto hr = DecodeFrame(jpeg, size, targetWidth, targetHeight, bgra, width, height, stride);
+	RETURN_IF_FAILED(hr);
+	if (hr != S_OK)
+	{
+		RETURN_HR_IF_NULL(E_UNEXPECTED, _fallback);
+		return _fallback->Decode(jpeg, size, targetWidth, targetHeight, bgra, width, height, stride);
+	}
+
+	_time += MFGetSystemTime() - start;
+	_frames++;
+	return S_OK;
+}
+
+// JPEG stores full range YCbCr, video NV12 is 16-235 luma and 16-240 chroma
+static void ToVideoRange(BYTE* nv12, UINT width, UINT height)
+{
+	struct Tables
+	{
+		BYTE luma[256];
+		BYTE chroma[256];
+		Tables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				luma[i] = (BYTE)(16 + (i * 219 + 127) / 255);
+				chroma[i] = (BYTE)(128 + ((i - 128) * 224 + (i >= 128 ? 127 : -127)) / 255);
+			}
+		}
+	};
+	static const Tables tables;
+
+	const size_t lumaSize = (size_t)width * height;
+	for (size_t i = 0; i < lumaSize; i++)
+	{
+		nv12[i] = tables.luma[nv12[i]];
+	}
+
+	const size_t chromaSize = lumaSize / 2;
+	auto uv = nv12 + lumaSize;
+	for (size_t i = 0; i < chromaSize; i++)
+	{
+		uv[i] = tables.chroma[uv[i]];
+	}
+}
+
+HRESULT JpegDecoder::DecodeNV12(const BYTE* jpeg, size_t size, UINT width, UINT height, FrameBuffer& nv12)
+{
+	RETURN_HR_IF(E_INVALIDARG, !jpeg || size < 4 || size > MAXDWORD);
+	if (!width || !height || (width & 1) || (height & 1))
+		return S_FALSE;
+
+	auto start = MFGetSystemTime();
+	auto hr = DecodeFrameNV12(jpeg, size, width, height, nv12);
+	RETURN_IF_FAILED(hr);
+	if (hr != S_OK)
+		return hr;
+
+	ToVideoRange(nv12.Data(), width, height);
+	_nv12Time += MFGetSystemTime() - start;
+	_nv12Frames++;
+	return S_OK;
+}
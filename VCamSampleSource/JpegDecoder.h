@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include "FrameBufferPool.h"
+
+enum class JpegDecoderType
+{
+	Wic = 0,
+	TurboJpeg = 1,  // needs a build with WINCAMHTTP_TURBOJPEG defined and libjpeg-turbo's turbojpeg.h/.lib available
+};
+
+// Decodes a complete JPEG to upright 32bpp BGRA (opaque, so also valid as PBGRA).
+// Given a target size, backends decode at the smallest of the JPEG's 1/2, 1/4 or 1/8 IDCT scales that still
+// covers it, leaving only a small resize to the caller; 4K sources feeding 1080p or 720p decode at 1/2 or 1/4.
+// Backends are stateless singletons shared by all cameras; whatever per-decode state they need is kept per
+// thread, so Decode can be called from several decode workers at once.
+// For NV12 output, backends can also hand out the JPEG's own YCbCr 4:2:0 planes, skipping the conversion to
+// BGRA and back.
+// Every backend times its decodes, so two backends can be compared side by side on the same streams.
+class JpegDecoder
+{
+	JpegDecoder* const _fallback;
+	std::atomic<ULONGLONG> _frames{ 0 };
+	std::atomic<ULONGLONG> _time{ 0 }; // 100ns units
+	std::atomic<ULONGLONG> _nv12Frames{ 0 };
+	std::atomic<ULONGLONG> _nv12Time{ 0 };
+
+protected:
+	// A backend with a fallback can leave frames it doesn't handle to it
+	explicit JpegDecoder(JpegDecoder* fallback = nullptr) : _fallback(fallback) {}
+
+	// S_FALSE hands the frame to the fallback, which decodes and counts it instead
+	virtual HRESULT DecodeFrame(const BYTE* jpeg, size_t size, UINT targetWidth, UINT targetHeight, FrameBuffer& bgra, UINT* width, UINT* height, UINT* stride) = 0;
+	// Y plane then interleaved CbCr, both full range as stored in the JPEG; S_FALSE if not possible
+	virtual HRESULT DecodeFrameNV12(const BYTE* /*jpeg*/, size_t /*size*/, UINT /*width*/, UINT /*height*/, FrameBuffer& /*nv12*/) { return S_FALSE; }
+
+public:
+	struct Stats
+	{
+		ULONGLONG frames;
+		ULONGLONG timeUs;
+		ULONGLONG nv12Frames;
+		ULONGLONG nv12TimeUs;
+	};
+
+	virtual ~JpegDecoder() = default;
+	virtual const wchar_t* Name() const = 0;
+
+	// bgra is resized as needed and keeps its memory when large enough, so a buffer reused across frames stops
+	// allocating.
+	// A target of 0x0 decodes at full size.
+	HRESULT Decode(const BYTE* jpeg, size_t size, UINT targetWidth, UINT targetHeight, FrameBuffer& bgra, UINT* width, UINT* height, UINT* stride);
+	// Decodes straight to NV12 (stride = width) in the same BT.601 video range RGB32ToNV12 produces, when the JPEG
+	// is 4:2:0 and has an IDCT scale of exactly width x height (even). Returns S_FALSE otherwise, use Decode then.
+	HRESULT DecodeNV12(const BYTE* jpeg, size_t size, UINT width, UINT height, FrameBuffer& nv12);
+	Stats GetStats() const { return { _frames.load(), _time.load() / 10, _nv12Frames.load(), _nv12Time.load() / 10 }; }
+
+	// Returns the requested backend, or the WIC one if that backend isn't compiled in
+	static JpegDecoder* Get(JpegDecoderType type);
+};
@@ -0,0 +1,75 @@
+#include "pch.h"
+#include "MarkerScan.h"
+#include "CpuFeatures.h"
+#include <bit>
+#if defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+static const BYTE* FindMarkerByteScalar(const BYTE* p, const BYTE* end)
+{
+	// the CRT memchr is already vectorized on most platforms
+	auto hit = memchr(p, 0xFF, end - p);
+	return hit ? (const BYTE*)hit : end;
+}
+
+#if defined(_M_X64) || defined(_M_IX86)
+static const BYTE* FindMarkerByteSse2(const BYTE* p, const BYTE* end)
+{
+	const auto ff = _mm_set1_epi8((char)0xFF);
+	for (; end - p >= 16; p += 16)
+	{
+		auto mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), ff));
+		if (mask)
+			return p + std::countr_zero(mask);
+	}
+
+	for (; p < end; ++p)
+	{
+		if (*p == 0xFF)
+			return p;
+	}
+	return end;
+}
+
+static const BYTE* FindMarkerByteAvx2(const BYTE* p, const BYTE* end)
+{
+	const auto ff = _mm256_set1_epi8((char)0xFF);
+	for (; end - p >= 64; p += 64)
+	{
+		// two vectors per iteration, entropy-coded data only has a 0xFF every hundred bytes or so
+		auto eq0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), ff);
+		auto eq1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 32)), ff);
+		if (!_mm256_testz_si256(_mm256_or_si256(eq0, eq1), _mm256_or_si256(eq0, eq1)))
+		{
+			auto mask0 = (unsigned int)_mm256_movemask_epi8(eq0);
+			if (mask0)
+				return p + std::countr_zero(mask0);
+
+			return p + 32 + std::countr_zero((unsigned int)_mm256_movemask_epi8(eq1));
+		}
+	}
+	return FindMarkerByteSse2(p, end);
+}
+#endif
+
+const std::vector<MarkerScanKernel>& MarkerScanKernels()
+{
+	static const std::vector<MarkerScanKernel> kernels = []()
+	{
+		std::vector<MarkerScanKernel> kernels{ { "scalar", FindMarkerByteScalar } };
+#if defined(_M_X64) || defined(_M_IX86)
+		const auto& cpu = CpuFeatures::Get();
+		if (cpu.sse2)
+		{
+			kernels.push_back({ "SSE2", FindMarkerByteSse2 });
+			if (cpu.avx2)
+			{
+				kernels.push_back({ "AVX2", FindMarkerByteAvx2 });
+			}
+		}
+#endif
+		return kernels;
+	}();
+	return kernels;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+
+// Marker byte search for the MJPEG splitter: returns the first 0xFF in [p, end), or end. This is where the
+// byte-at-a-time cost of the marker scan lives, so it is vectorized and picked once at runtime from what the CPU
+// supports. Every variant the CPU can run is listed, so tests and benchmarks can compare them.
+typedef const BYTE* (*FindMarkerByteFn)(const BYTE* p, const BYTE* end);
+
+struct MarkerScanKernel
+{
+	const char* name; // "scalar", "SSE2", "AVX2"
+	FindMarkerByteFn find;
+};
+
+// The kernels this CPU can run, scalar first and the fastest last
+const std::vector<MarkerScanKernel>& MarkerScanKernels();
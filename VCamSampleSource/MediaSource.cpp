@@ -40,6 +40,13 @@ HRESULT MediaSource::Initialize(IMFAttributes* attributes)
 		WINTRACE(L"MediaSource::Initialize no AppX");
 	}
 
+	RETURN_IF_FAILED(CreateDescriptor());
+	RETURN_IF_FAILED(MFCreateEventQueue(&_queue));
+	return S_OK;
+}
+
+HRESULT MediaSource::CreateDescriptor()
+{
 	auto streams = wil::make_unique_cotaskmem_array<wil::com_ptr_nothrow<IMFStreamDescriptor>>(_streams.size());
 	for (uint32_t i = 0; i < streams.size(); i++)
 	{
@@ -47,8 +54,10 @@ HRESULT MediaSource::Initialize(IMFAttributes* attributes)
 		RETURN_IF_FAILED(_streams[i]->GetStreamDescriptor(&desc));
 		streams[i] = desc.detach();
 	}
-	RETURN_IF_FAILED(MFCreatePresentationDescriptor((DWORD)streams.size(), streams.get(), &_descriptor));
-	RETURN_IF_FAILED(MFCreateEventQueue(&_queue));
+
+	wil::com_ptr_nothrow<IMFPresentationDescriptor> descriptor;
+	RETURN_IF_FAILED(MFCreatePresentationDescriptor((DWORD)streams.size(), streams.get(), &descriptor));
+	_descriptor = std::move(descriptor);
 	return S_OK;
 }
 
@@ -111,6 +111,77 @@ public:
 				_configHeight = 1080;
 				WINTRACE(L"MediaSource: Failed to read Height from HKLM for %s, using default 1080", _cameraId.c_str());
 			}
+
+			DWORD asyncTransport = 1;
+			size = sizeof(DWORD);
+			result = RegQueryValueExW(hKey, L"AsyncTransport", nullptr, &type, (LPBYTE)&asyncTransport, &size);
+			if (result != ERROR_SUCCESS || type != REG_DWORD)
+			{
+				asyncTransport = 1;
+			}
+			_asyncTransport = asyncTransport != 0;
+
+			DWORD snapshot = 0;
+			size = sizeof(DWORD);
+			result = RegQueryValueExW(hKey, L"Snapshot", nullptr, &type, (LPBYTE)&snapshot, &size);
+			if (result != ERROR_SUCCESS || type != REG_DWORD)
+			{
+				snapshot = 0;
+			}
+			_snapshot = snapshot != 0;
+
+			DWORD decoder = 0;
+			size = sizeof(DWORD);
+			result = RegQueryValueExW(hKey, L"JpegDecoder", nullptr, &type, (LPBYTE)&decoder, &size);
+			if (result != ERROR_SUCCESS || type != REG_DWORD)
+			{
+				decoder = 0;
+			}
+			_jpegDecoder = (JpegDecoderType)decoder;
+
+			DWORD filter = 0;
+			size = sizeof(DWORD);
+			result = RegQueryValueExW(hKey, L"ScaleFilter", nullptr, &type, (LPBYTE)&filter, &size);
+			if (result != ERROR_SUCCESS || type != REG_DWORD || filter > (DWORD)ResampleFilter::Lanczos3)
+			{
+				filter = 0;
+			}
+			_scaleFilter = (ResampleFilter)filter;
+
+			DWORD fit = 0;
+			size = sizeof(DWORD);
+			result = RegQueryValueExW(hKey, L"FitMode", nullptr, &type, (LPBYTE)&fit, &size);
+			if (result != ERROR_SUCCESS || type != REG_DWORD || fit > (DWORD)FitMode::Crop)
+			{
+				fit = 0;
+			}
+			_fitMode = (FitMode)fit;
+
+			// advertised modes, by default the configured size and smaller ones at the usual frame rates
+			_videoModes = VideoModes::Default(_configWidth, _configHeight);
+			WCHAR listBuffer[512]{};
+			size = sizeof(listBuffer) - sizeof(WCHAR);
+			result = RegQueryValueExW(hKey, L"Resolutions", nullptr, &type, (LPBYTE)listBuffer, &size);
+			if (result == ERROR_SUCCESS && type == REG_SZ)
+			{
+				auto sizes = VideoModes::ParseSizes(listBuffer);
+				if (!sizes.empty())
+				{
+					_videoModes.sizes = sizes;
+				}
+			}
+
+			ZeroMemory(listBuffer, sizeof(listBuffer));
+			size = sizeof(listBuffer) - sizeof(WCHAR);
+			result = RegQueryValueExW(hKey, L"FrameRates", nullptr, &type, (LPBYTE)listBuffer, &size);
+			if (result == ERROR_SUCCESS && type == REG_SZ)
+			{
+				auto rates = VideoModes::ParseRates(listBuffer);
+				if (!rates.empty())
+				{
+					_videoModes.rates = rates;
+				}
+			}
 			
 			RegCloseKey(hKey);
 			WINTRACE(L"MediaSource: Configuration from HKLM for %s: %s %ux%u", _cameraId.c_str(), _mjpegUrl.c_str(), _configWidth, _configHeight);
@@ -118,6 +189,7 @@ public:
 		else
 		{
 			WINTRACE(L"MediaSource: Failed to open HKLM registry for %s, using defaults: %ux%u", _cameraId.c_str(), _configWidth, _configHeight);
+			_videoModes = VideoModes::Default(_configWidth, _configHeight);
 		}
 
 		// Apply configuration immediately to streams so they don't query back into source during Start
@@ -127,10 +199,17 @@ public:
 			{
 				if (!_mjpegUrl.empty()) { _streams[i]->SetMjpegUrl(_mjpegUrl.c_str()); }
 				_streams[i]->SetResolution(_configWidth, _configHeight);
+				_streams[i]->SetAsyncTransport(_asyncTransport);
+				_streams[i]->SetSnapshotMode(_snapshot);
+				_streams[i]->SetJpegDecoder(_jpegDecoder);
+				_streams[i]->SetScaleFilter(_scaleFilter);
+				_streams[i]->SetFitMode(_fitMode);
+				RETURN_IF_FAILED(_streams[i]->SetVideoModes(_videoModes));
 			}
 		}
-		
-		return S_OK;
+
+		// the stream descriptors changed
+		return CreateDescriptor();
 	}
 
 	HRESULT Initialize(IMFAttributes* attributes);
@@ -164,6 +243,8 @@ private:
 #endif
 
 	int GetStreamIndexById(DWORD id);
+	// Presentation descriptor from the streams' descriptors
+	HRESULT CreateDescriptor();
 
 private:
 	const int _numStreams = 1;  // 1 stream for now
@@ -176,6 +257,12 @@ private:
 	std::wstring _mjpegUrl;
 	UINT32 _configWidth = 1920;
 	UINT32 _configHeight = 1080;
+	bool _asyncTransport = true; // WinHTTP async transport, "AsyncTransport" = 0 selects the blocking reader thread
+	bool _snapshot = false;      // "Snapshot" = 1: URL returns a single JPEG per request, poll it
+	JpegDecoderType _jpegDecoder = JpegDecoderType::Wic; // "JpegDecoder": 0 WIC, 1 TurboJPEG when built with it
+	ResampleFilter _scaleFilter = ResampleFilter::Bilinear; // "ScaleFilter": 0 bilinear, 1 bicubic, 2 Lanczos3
+	FitMode _fitMode = FitMode::Stretch; // "FitMode": 0 stretch, 1 letterbox, 2 crop to fill
+	VideoModes _videoModes;      // "Resolutions" ("1920x1080,1280x720") and "FrameRates" ("30,15") strings
 	std::wstring _cameraId;
 };
 
@@ -3,6 +3,7 @@
 #include "Tools.h"
 #include "MFTools.h"
 #include "FrameGenerator.h"
+#include "PixelFormats.h"
 #include "MediaStream.h"
 #include "MediaSource.h"
 #include <vector>
@@ -20,66 +21,87 @@ HRESULT MediaStream::Initialize(IMFMediaSource* source, int index)
 
 	RETURN_IF_FAILED(MFCreateEventQueue(&_queue));
 
-	// set 1 here to force RGB32 only
-	auto types = wil::make_unique_cotaskmem_array<wil::com_ptr_nothrow<IMFMediaType>>(2);
+	return CreateDescriptor(VideoModes::Default(1920, 1080));
+}
 
-	// Determine initial advertised width/height from MediaSource configuration (defaults to 1920x1080)
-	UINT32 advWidth = 1920, advHeight = 1080;
-	if (source)
+static HRESULT CreateVideoType(REFGUID subtype, UINT width, UINT height, UINT fps, IMFMediaType** type)
+{
+	wil::com_ptr_nothrow<IMFMediaType> videoType;
+	RETURN_IF_FAILED(MFCreateMediaType(&videoType));
+	videoType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
+	videoType->SetGUID(MF_MT_SUBTYPE, subtype);
+	MFSetAttributeSize(videoType.get(), MF_MT_FRAME_SIZE, width, height);
+	videoType->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
+	videoType->SetUINT32(MF_MT_ALL_SAMPLES_INDEPENDENT, TRUE);
+	MFSetAttributeRatio(videoType.get(), MF_MT_FRAME_RATE, fps, 1);
+	MFSetAttributeRatio(videoType.get(), MF_MT_PIXEL_ASPECT_RATIO, 1, 1);
+	if (auto format = PixelFormat::Find(subtype))
+	{
+		// default stride is bytes-per-row of the first plane (the Y plane for planar formats)
+		videoType->SetUINT32(MF_MT_DEFAULT_STRIDE, format->DefaultStride(width));
+		// frame size * pixel bit size * framerate
+		videoType->SetUINT32(MF_MT_AVG_BITRATE, (uint32_t)((ULONGLONG)width * height * format->BitsPerPixel() * fps));
+		if (subtype != MFVideoFormat_RGB32)
+		{
+			// what FrameGenerator and Spinner convert with (YuvMatrix::BT601, YuvRange::Limited), so consumers don't guess
+			videoType->SetUINT32(MF_MT_YUV_MATRIX, MFVideoTransferMatrix_BT601);
+			videoType->SetUINT32(MF_MT_VIDEO_NOMINAL_RANGE, MFNominalRange_16_235);
+		}
+	}
+	else
 	{
-		// Try to downcast to our MediaSource and read its config members via interface
-		MediaSource* ms = static_cast<MediaSource*>(source);
-		// Best-effort: we don't expose direct getters; we can query current stream descriptor later too
-		// but here we just use the generator defaults set by MediaSource in constructor.
-		// To ensure we match, we'll also update generator resolution in Start based on negotiated type.
-		// If MediaSource applied SetResolution before, the generator will be created with that size.
-		// Use the SetResolution path to capture actual configured size if possible
-		// (no direct accessors available: keep advWidth/advHeight defaults)
+		// MJPG: compressed, no stride; camera JPEGs run about 2 bits per pixel
+		videoType->SetUINT32(MF_MT_COMPRESSED, TRUE);
+		videoType->SetUINT32(MF_MT_AVG_BITRATE, (uint32_t)((ULONGLONG)width * height * 2 * fps));
 	}
+	*type = videoType.detach();
+	return S_OK;
+}
+
+HRESULT MediaStream::CreateDescriptor(const VideoModes& modes)
+{
+	RETURN_HR_IF(E_INVALIDARG, modes.sizes.empty() || modes.rates.empty());
 
-	wil::com_ptr_nothrow<IMFMediaType> rgbType;
-	RETURN_IF_FAILED(MFCreateMediaType(&rgbType));
-	rgbType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
-	rgbType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_RGB32);
-	MFSetAttributeSize(rgbType.get(), MF_MT_FRAME_SIZE, advWidth, advHeight);
-	rgbType->SetUINT32(MF_MT_DEFAULT_STRIDE, advWidth * 4);
-	rgbType->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
-	rgbType->SetUINT32(MF_MT_ALL_SAMPLES_INDEPENDENT, TRUE);
-	MFSetAttributeRatio(rgbType.get(), MF_MT_FRAME_RATE, 30, 1);
-	auto bitrate = (uint32_t)(advWidth * advHeight * 4 * 8 * 30);
-	rgbType->SetUINT32(MF_MT_AVG_BITRATE, bitrate);
-	MFSetAttributeRatio(rgbType.get(), MF_MT_PIXEL_ASPECT_RATIO, 1, 1);
-	types[0] = rgbType.detach();
-
-	if (types.size() > 1)
+	// every size at every rate in every pixel format (RGB32 first), the first one is the default; MJPG passes the
+	// camera's JPEGs through unscaled, so only at the first (configured) size
+	auto types = wil::make_unique_cotaskmem_array<wil::com_ptr_nothrow<IMFMediaType>>(modes.sizes.size() * modes.rates.size() * PixelFormat::Count + modes.rates.size());
+	size_t i = 0;
+	for (auto& size : modes.sizes)
 	{
-		wil::com_ptr_nothrow<IMFMediaType> nv12Type;
-		RETURN_IF_FAILED(MFCreateMediaType(&nv12Type));
-		nv12Type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
-		nv12Type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12);
-		nv12Type->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
-		nv12Type->SetUINT32(MF_MT_ALL_SAMPLES_INDEPENDENT, TRUE);
-	MFSetAttributeSize(nv12Type.get(), MF_MT_FRAME_SIZE, advWidth, advHeight);
-		// For NV12, default stride is bytes-per-row of the Y plane: equals width
-	nv12Type->SetUINT32(MF_MT_DEFAULT_STRIDE, (UINT)(advWidth));
-		MFSetAttributeRatio(nv12Type.get(), MF_MT_FRAME_RATE, 30, 1);
-		// frame size * pixel bit size * framerate
-	bitrate = (uint32_t)(advWidth * 1.5 * advHeight * 8 * 30);
-		nv12Type->SetUINT32(MF_MT_AVG_BITRATE, bitrate);
-		MFSetAttributeRatio(nv12Type.get(), MF_MT_PIXEL_ASPECT_RATIO, 1, 1);
-		types[1] = nv12Type.detach();
+		for (auto fps : modes.rates)
+		{
+			for (auto& format : PixelFormat::Formats)
+			{
+				RETURN_IF_FAILED(CreateVideoType(format.subtype, size.width, size.height, fps, &types[i++]));
+			}
+			if (&size == &modes.sizes[0])
+			{
+				RETURN_IF_FAILED(CreateVideoType(MFVideoFormat_MJPG, size.width, size.height, fps, &types[i++]));
+			}
+		}
 	}
 
-	RETURN_IF_FAILED_MSG(MFCreateStreamDescriptor(_index, (DWORD)types.size(), types.get(), &_descriptor), "MFCreateStreamDescriptor failed");
+	wil::com_ptr_nothrow<IMFStreamDescriptor> descriptor;
+	RETURN_IF_FAILED_MSG(MFCreateStreamDescriptor(_index, (DWORD)types.size(), types.get(), &descriptor), "MFCreateStreamDescriptor failed");
 
 	wil::com_ptr_nothrow<IMFMediaTypeHandler> handler;
-	RETURN_IF_FAILED(_descriptor->GetMediaTypeHandler(&handler));
+	RETURN_IF_FAILED(descriptor->GetMediaTypeHandler(&handler));
 	TraceMFAttributes(handler.get(), L"MediaTypeHandler");
 	RETURN_IF_FAILED(handler->SetCurrentMediaType(types[0]));
+	WINTRACE(L"MediaStream::CreateDescriptor %zu sizes x %zu rates, default %ux%u@%u", modes.sizes.size(), modes.rates.size(), modes.sizes[0].width, modes.sizes[0].height, modes.rates[0]);
 
+	_descriptor = std::move(descriptor);
 	return S_OK;
 }
 
+HRESULT MediaStream::SetVideoModes(const VideoModes& modes)
+{
+	// SetVideoModes
+	winrt::slim_lock_guard lock(_lock);
+	RETURN_HR_IF(MF_E_INVALIDREQUEST, _state == MF_STREAM_STATE_RUNNING);
+	return CreateDescriptor(modes);
+}
+
 HRESULT MediaStream::Start(IMFMediaType* type)
 {
 	RETURN_HR_IF(MF_E_SHUTDOWN, !_queue || !_allocator);
@@ -134,6 +156,18 @@ HRESULT MediaStream::Start(IMFMediaType* type)
 	// Set resolution on generator to negotiated size (important for buffer sizing)
 	LOG_IF_FAILED(_generator.SetResolution(width, height));
 
+	// snapshot cameras are polled at the negotiated frame rate
+	UINT32 numerator = 0, denominator = 0;
+	if (type && SUCCEEDED(MFGetAttributeRatio(type, MF_MT_FRAME_RATE, &numerator, &denominator)) && numerator && denominator)
+	{
+		LOG_IF_FAILED(_generator.SetFrameRate(numerator, denominator));
+		_sampleDuration = (LONGLONG)(10000000ULL * denominator / numerator);
+	}
+	else
+	{
+		_sampleDuration = 333333;
+	}
+
 	// Create render target with correct resolution
 	// Ensure render target for negotiated size
 	{
@@ -144,10 +178,15 @@ HRESULT MediaStream::Start(IMFMediaType* type)
 			return ehr;
 		}
 	}
-	// Initialize allocator with provided type
-	RETURN_IF_FAILED(_allocator->InitializeSampleAllocator(10, type));
+	// Initialize allocator with provided type; it sizes buffers for uncompressed images, MJPG samples get theirs
+	// from the generator, sized for each JPEG
+	if (_format != MFVideoFormat_MJPG)
+	{
+		RETURN_IF_FAILED(_allocator->InitializeSampleAllocator(10, type));
+	}
 	RETURN_IF_FAILED(_queue->QueueEventParamVar(MEStreamStarted, GUID_NULL, S_OK, nullptr));
 	_state = MF_STREAM_STATE_RUNNING;
+	_clock.Reset();
 
     return RequestSample(nullptr);
 }
@@ -276,9 +315,17 @@ STDMETHODIMP MediaStream::RequestSample(IUnknown* pToken)
 
 	wil::com_ptr_nothrow<IMFSample> sample;
 	// allocate sample
-	RETURN_IF_FAILED(_allocator->AllocateSample(&sample));
+	if (_format == MFVideoFormat_MJPG)
+	{
+		RETURN_IF_FAILED(MFCreateSample(&sample));
+	}
+	else
+	{
+		RETURN_IF_FAILED(_allocator->AllocateSample(&sample));
+	}
+	// provisional, the GPU converter copies them to the sample it makes; set for real once the picture is known
 	RETURN_IF_FAILED(sample->SetSampleTime(MFGetSystemTime()));
-	RETURN_IF_FAILED(sample->SetSampleDuration(333333));
+	RETURN_IF_FAILED(sample->SetSampleDuration(_sampleDuration));
 
 	// Inspect pre-Generate buffers
 	DWORD preCount = 0; sample->GetBufferCount(&preCount);
@@ -313,6 +360,15 @@ STDMETHODIMP MediaStream::RequestSample(IUnknown* pToken)
 	}
 	// frame generated
 
+	// stamped with the capture time of its picture, so recordings can keep it in sync with audio
+	const auto now = MFGetSystemTime();
+	auto& timing = _generator.GeneratedTiming();
+	auto stamp = _clock.Next(now, timing);
+	RETURN_IF_FAILED(outSample->SetSampleTime(stamp.time));
+	RETURN_IF_FAILED(outSample->SetSampleDuration(_sampleDuration));
+	RETURN_IF_FAILED(outSample->SetUINT32(MFSampleExtension_Discontinuity, stamp.discontinuity));
+	WINTRACE(L"MediaStream::RequestSample picture:%llu time:%lld age:%lld ms discontinuity:%d", timing.index, stamp.time, (now - stamp.time) / 10000, stamp.discontinuity);
+
 	if (pToken)
 	{
 		RETURN_IF_FAILED(outSample->SetUnknown(MFSampleExtension_Token, pToken));
@@ -418,3 +474,38 @@ HRESULT MediaStream::SetMjpegUrl(LPCWSTR url)
 	winrt::slim_lock_guard lock(_lock);
 	return _generator.SetMjpegUrl(url);
 }
+
+HRESULT MediaStream::SetAsyncTransport(bool async)
+{
+	// SetAsyncTransport
+	winrt::slim_lock_guard lock(_lock);
+	return _generator.SetAsyncTransport(async);
+}
+
+HRESULT MediaStream::SetSnapshotMode(bool snapshot)
+{
+	// SetSnapshotMode
+	winrt::slim_lock_guard lock(_lock);
+	return _generator.SetSnapshotMode(snapshot);
+}
+
+HRESULT MediaStream::SetJpegDecoder(JpegDecoderType type)
+{
+	// SetJpegDecoder
+	winrt::slim_lock_guard lock(_lock);
+	return _generator.SetJpegDecoder(type);
+}
+
+HRESULT MediaStream::SetScaleFilter(ResampleFilter filter)
+{
+	// SetScaleFilter
+	winrt::slim_lock_guard lock(_lock);
+	return _generator.SetScaleFilter(filter);
+}
+
+HRESULT MediaStream::SetFitMode(FitMode mode)
+{
+	// SetFitMode
+	winrt::slim_lock_guard lock(_lock);
+	return _generator.SetFitMode(mode);
+}
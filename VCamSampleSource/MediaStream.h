@@ -1,5 +1,8 @@
 #pragma once
 
+#include "VideoModes.h"
+#include "SampleTiming.h"
+
 struct MediaStream : winrt::implements<MediaStream, CBaseAttributes<IMFAttributes>, IMFMediaStream2, IKsControl>
 {
 public:
@@ -41,6 +44,13 @@ public:
 	void Shutdown();
 	HRESULT SetResolution(UINT32 width, UINT32 height);
 	HRESULT SetMjpegUrl(LPCWSTR url);
+	HRESULT SetAsyncTransport(bool async);
+	HRESULT SetSnapshotMode(bool snapshot);
+	HRESULT SetJpegDecoder(JpegDecoderType type);
+	HRESULT SetScaleFilter(ResampleFilter filter);
+	HRESULT SetFitMode(FitMode mode);
+	// Replaces the advertised media types, while stopped
+	HRESULT SetVideoModes(const VideoModes& modes);
 
 private:
 #if _DEBUG
@@ -50,10 +60,14 @@ private:
 	}
 #endif
 
+	HRESULT CreateDescriptor(const VideoModes& modes);
+
 	winrt::slim_mutex  _lock;
 	MF_STREAM_STATE _state;
 	FrameGenerator _generator;
 	GUID _format;
+	LONGLONG _sampleDuration = 333333; // 100 ns units, from the negotiated frame rate
+	SampleClock _clock;                // sample times, from the capture times of the pictures
 	wil::com_ptr_nothrow<IMFStreamDescriptor> _descriptor;
 	wil::com_ptr_nothrow<IMFMediaEventQueue> _queue;
 	wil::com_ptr_nothrow<IMFMediaSource> _source;
@@ -0,0 +1,545 @@
+#include "pch.h"
+#include "MjpegSplitter.h"
+#include "MarkerScan.h"
+
+static const FindMarkerByteFn _findMarkerByte = MarkerScanKernels().back().find;
+
+const char* MjpegSplitter::MarkerScanner()
+{
+	return MarkerScanKernels().back().name;
+}
+
+size_t MjpegSplitter::FindMarker(size_t from) const
+{
+	// first 0xFF in [from, _writePos - 1) so the byte after it can be examined, _writePos - 1 if there's none
+	const auto buf = _buffer.data();
+	return _findMarkerByte(buf + from, buf + _writePos - 1) - buf;
+}
+
+static bool StartsWithNoCase(const std::string& s, const char* prefix)
+{
+	const auto len = strlen(prefix);
+	return s.size() >= len && !_strnicmp(s.c_str(), prefix, len);
+}
+
+static std::string Trim(const std::string& s)
+{
+	const auto first = s.find_first_not_of(" \t\r\n");
+	if (first == std::string::npos)
+		return std::string();
+
+	const auto last = s.find_last_not_of(" \t\r\n");
+	return s.substr(first, last - first + 1);
+}
+
+// "1695571234.123456" seconds as 100 ns units, 0 if there's no number
+static LONGLONG ParseSeconds(const char* text)
+{
+	char* end;
+	auto seconds = strtoull(text, &end, 10);
+	if (end == text)
+		return 0;
+
+	auto value = (LONGLONG)seconds * 10000000;
+	if (*end == '.')
+	{
+		LONGLONG scale = 1000000;
+		for (auto p = end + 1; *p >= '0' && *p <= '9' && scale; p++, scale /= 10)
+		{
+			value += (*p - '0') * scale;
+		}
+	}
+	return value;
+}
+
+void MjpegSplitter::SetContentType(const std::string& contentType)
+{
+	// multipart/x-mixed-replace; boundary=myboundary
+	_boundary.clear();
+	if (StartsWithNoCase(Trim(contentType), "multipart/"))
+	{
+		std::string lower(contentType);
+		std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+		auto pos = lower.find("boundary=");
+		if (pos != std::string::npos)
+		{
+			auto value = contentType.substr(pos + 9);
+			auto semi = value.find(';');
+			if (semi != std::string::npos)
+			{
+				value.resize(semi);
+			}
+
+			value = Trim(value);
+			if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+			{
+				value = value.substr(1, value.size() - 2);
+			}
+
+			// servers don't agree on whether the declared boundary includes the leading "--", so we search for the
+			// declared value itself, which matches the delimiter line either way
+			_boundary = value;
+		}
+	}
+	WINTRACE(L"MjpegSplitter: content type '%S' boundary '%S'", contentType.c_str(), _boundary.c_str());
+	Reset();
+}
+
+void MjpegSplitter::Reset()
+{
+	_readPos = 0;
+	_writePos = 0;
+	_scanPos = 0;
+	_frameStart = 0;
+	_contentLength = 0;
+	_timestamp = 0;
+	_frameTimestamp = 0;
+	_state = InitialState();
+	_inFrame = false;
+	_entropy = false;
+	_lenient = false;
+}
+
+void MjpegSplitter::Rebase(size_t offset)
+{
+	// all offsets we keep are at or after _readPos, except a stale _frameStart between frames
+	_scanPos -= offset;
+	_frameStart = _frameStart >= offset ? _frameStart - offset : 0;
+	_writePos -= offset;
+	_readPos -= offset;
+}
+
+void MjpegSplitter::Compact()
+{
+	// move the unconsumed tail (at most the partial frame in flight) back to the front
+	if (!_readPos)
+		return;
+
+	const auto pending = _writePos - _readPos;
+	if (pending)
+	{
+		memmove(_buffer.data(), _buffer.data() + _readPos, pending);
+		_bytesMoved += pending;
+	}
+	Rebase(_readPos);
+}
+
+BYTE* MjpegSplitter::GetWriteBuffer(size_t size)
+{
+	if (_readPos == _writePos)
+	{
+		// everything consumed, restart at the front for free
+		Rebase(_readPos);
+	}
+
+	if (_buffer.size() - _writePos >= size)
+		return _buffer.data() + _writePos;
+
+	Compact();
+	if (_buffer.size() - _writePos >= size)
+		return _buffer.data() + _writePos;
+
+	auto capacity = std::max<size_t>(std::max<size_t>(_buffer.size() * 2, InitialCapacity), _writePos + size);
+	if (capacity > MaxCapacity)
+	{
+		// a single frame larger than we accept: drop it and resync
+		WINTRACE(L"MjpegSplitter: frame exceeds %zu bytes, dropping %zu buffered bytes", MaxCapacity, _writePos);
+		Reset();
+		capacity = std::max<size_t>(std::max<size_t>(_buffer.size(), InitialCapacity), size);
+	}
+
+	if (capacity > _buffer.size())
+	{
+		_buffer.resize(capacity);
+	}
+	return _buffer.data() + _writePos;
+}
+
+void MjpegSplitter::CommitWrite(size_t written)
+{
+	assert(_writePos + written <= _buffer.size());
+	_writePos += written;
+}
+
+void MjpegSplitter::Append(const BYTE* data, size_t size)
+{
+	if (!data || !size)
+		return;
+
+	auto ptr = GetWriteBuffer(size);
+	memcpy(ptr, data, size);
+	CommitWrite(size);
+}
+
+void MjpegSplitter::StartFrame(size_t pos)
+{
+	_frameStart = pos;
+	_readPos = pos;
+	_inFrame = true;
+	_entropy = false;
+	_lenient = false;
+}
+
+bool MjpegSplitter::ParseBoundary()
+{
+	const auto buf = (const char*)_buffer.data();
+	const auto end = _writePos;
+	const auto len = _boundary.size();
+	auto p = _scanPos;
+	while (p + len <= end)
+	{
+		auto hit = (const char*)memchr(buf + p, _boundary[0], end - p - len + 1);
+		if (!hit)
+		{
+			p = end - len + 1;
+			break;
+		}
+
+		p = hit - buf;
+		if (!memcmp(buf + p, _boundary.data(), len))
+		{
+			// the delimiter line ends with (CR)LF, possibly after transport padding or a closing "--"
+			auto lf = (const char*)memchr(buf + p + len, '\n', end - p - len);
+			if (!lf)
+			{
+				_scanPos = p;
+				return false;
+			}
+
+			_scanPos = lf - buf + 1;
+			_readPos = _scanPos;
+			_contentLength = 0;
+			_timestamp = 0;
+			_state = State::Headers;
+			return true;
+		}
+		p++;
+	}
+
+	// keep what we searched so far, if the boundary never shows up we'll rescan it for JPEG markers
+	_scanPos = p;
+	if (_scanPos - _readPos > MaxBoundarySkip)
+	{
+		// the server doesn't use the boundary it declared, look at the bytes instead
+		WINTRACE(L"MjpegSplitter: boundary '%S' not found in %zu bytes, falling back to marker scan", _boundary.c_str(), _scanPos - _readPos);
+		_boundary.clear();
+		_scanPos = _readPos;
+		_inFrame = false;
+		_state = State::Jpeg;
+		return true;
+	}
+	return false;
+}
+
+bool MjpegSplitter::ParseHeaders()
+{
+	const auto buf = (const char*)_buffer.data();
+	const auto end = _writePos;
+	while (_scanPos < end)
+	{
+		auto lf = (const char*)memchr(buf + _scanPos, '\n', end - _scanPos);
+		if (!lf)
+		{
+			if (end - _readPos > MaxHeadersSize)
+			{
+				WINTRACE(L"MjpegSplitter: part headers exceed %zu bytes, resyncing", MaxHeadersSize);
+				_readPos = _scanPos = end;
+				_state = State::Boundary;
+				return true;
+			}
+			return false;
+		}
+
+		auto line = Trim(std::string(buf + _scanPos, lf));
+		_scanPos = lf - buf + 1;
+		if (line.empty())
+		{
+			// end of headers, the body follows
+			if (_contentLength >= 2 && _contentLength <= MaxCapacity)
+			{
+				_frameStart = _scanPos;
+				_readPos = _scanPos;
+				_scanPos += _contentLength;
+				_state = State::Body;
+			}
+			else
+			{
+				_readPos = _scanPos;
+				_inFrame = false;
+				_state = State::Jpeg;
+			}
+			return true;
+		}
+
+		if (StartsWithNoCase(line, "content-length:"))
+		{
+			_contentLength = (size_t)strtoull(line.c_str() + 15, nullptr, 10);
+		}
+		else if (StartsWithNoCase(line, "x-timestamp:"))
+		{
+			_timestamp = ParseSeconds(line.c_str() + 12);
+		}
+	}
+	return false;
+}
+
+bool MjpegSplitter::ParseJpeg(size_t* frameEnd)
+{
+	// JPEG SOI: 0xFF,0xD8 ; EOI: 0xFF,0xD9
+	// a marker is two bytes, so we stop one byte short of the end and resume on that byte next time
+	const auto buf = _buffer.data();
+	const auto end = _writePos;
+	auto p = _scanPos;
+	if (!_inFrame)
+	{
+		bool found = false;
+		while (p + 1 < end)
+		{
+			p = FindMarker(p);
+			if (p + 1 >= end)
+				break;
+
+			if (buf[p + 1] == 0xD8)
+			{
+				found = true;
+				break;
+			}
+			p++;
+		}
+
+		if (!found)
+		{
+			// nothing before the last byte can start a frame anymore
+			_scanPos = p;
+			_readPos = std::max(_readPos, p);
+			return false;
+		}
+		StartFrame(p);
+		p += 2;
+	}
+
+	while (true)
+	{
+		if (_lenient)
+		{
+			while (p + 1 < end)
+			{
+				p = FindMarker(p);
+				if (p + 1 >= end)
+					break;
+
+				if (buf[p + 1] == 0xD9)
+				{
+					*frameEnd = p + 2;
+					return true;
+				}
+				p++;
+			}
+			_scanPos = p;
+			return false;
+		}
+
+		if (_entropy)
+		{
+			// entropy-coded data: 0xFF is followed by a stuffed 0x00, a fill 0xFF or a restart marker, anything else ends the scan
+			for (; p + 1 < end; ++p)
+			{
+				p = FindMarker(p);
+				if (p + 1 >= end)
+					break;
+
+				auto m = buf[p + 1];
+				if (m == 0x00 || m == 0xFF || (m >= 0xD0 && m <= 0xD7))
+					continue;
+
+				_entropy = false;
+				break;
+			}
+
+			if (_entropy)
+			{
+				_scanPos = p;
+				return false;
+			}
+		}
+
+		// marker segments: skip them by their length, this is what jumps over embedded thumbnails
+		if (p + 1 >= end)
+		{
+			_scanPos = p;
+			return false;
+		}
+
+		if (buf[p] != 0xFF)
+		{
+			_lenient = true;
+			continue;
+		}
+
+		auto m = buf[p + 1];
+		if (m == 0xFF)
+		{
+			p++;
+			continue;
+		}
+
+		if (m == 0xD9)
+		{
+			*frameEnd = p + 2;
+			return true;
+		}
+
+		if (m == 0xD8)
+		{
+			// truncated frame followed by a new one
+			StartFrame(p);
+			p += 2;
+			continue;
+		}
+
+		if (m == 0x01 || (m >= 0xD0 && m <= 0xD7))
+		{
+			p += 2;
+			continue;
+		}
+
+		if (p + 3 >= end)
+		{
+			_scanPos = p;
+			return false;
+		}
+
+		size_t len = ((size_t)buf[p + 2] << 8) | buf[p + 3];
+		if (len < 2)
+		{
+			_lenient = true;
+			continue;
+		}
+
+		p += 2 + len;
+		if (m == 0xDA) // SOS
+		{
+			_entropy = true;
+		}
+	}
+}
+
+bool MjpegSplitter::NextFrame(const BYTE** data, size_t* size)
+{
+	*data = nullptr;
+	*size = 0;
+
+	while (true)
+	{
+		size_t frameEnd = 0;
+		switch (_state)
+		{
+		case State::Boundary:
+			if (!ParseBoundary())
+				return false;
+			break;
+
+		case State::Headers:
+			if (!ParseHeaders())
+				return false;
+			break;
+
+		case State::Body:
+			if (_writePos < _scanPos)
+				return false;
+
+			if (_buffer[_frameStart] != 0xFF || _buffer[_frameStart + 1] != 0xD8)
+			{
+				// Content-Length doesn't frame a JPEG, look at the bytes instead
+				WINTRACE(L"MjpegSplitter: part body is not a JPEG, scanning");
+				_scanPos = _frameStart;
+				_inFrame = false;
+				_state = State::Jpeg;
+				break;
+			}
+
+			*data = _buffer.data() + _frameStart;
+			*size = _scanPos - _frameStart;
+			_frameTimestamp = _timestamp;
+			_readPos = _scanPos;
+			_state = State::Boundary;
+			_frames++;
+			_lengthFrames++;
+			return true;
+
+		case State::Jpeg:
+			if (!ParseJpeg(&frameEnd))
+				return false;
+
+			*data = _buffer.data() + _frameStart;
+			*size = frameEnd - _frameStart;
+			_frameTimestamp = _timestamp; // 0 unless the part had headers but no Content-Length
+			_scanPos = frameEnd;
+			_readPos = frameEnd;
+			_inFrame = false;
+			_state = InitialState();
+			_frames++;
+			return true;
+		}
+	}
+}
+
+bool MjpegSplitter::ReadFrameSize(const BYTE* jpeg, size_t size, UINT* width, UINT* height)
+{
+	if (!jpeg || size < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8)
+		return false;
+
+	// the frame header comes before the first SOS, the segments in between (APPn, DQT, DHT...) are jumped over
+	size_t p = 2;
+	while (p + 3 < size)
+	{
+		if (jpeg[p] != 0xFF)
+			return false;
+
+		auto m = jpeg[p + 1];
+		if (m == 0xFF)
+		{
+			p++;
+			continue;
+		}
+
+		if (m == 0xDA || m == 0xD9)
+			return false;
+
+		size_t len = ((size_t)jpeg[p + 2] << 8) | jpeg[p + 3];
+		if (len < 2)
+			return false;
+
+		// SOF0..SOF15, except DHT (C4), JPG (C8) and DAC (CC): length, precision, height, width
+		if (m >= 0xC0 && m <= 0xCF && m != 0xC4 && m != 0xC8 && m != 0xCC)
+		{
+			if (len < 7 || p + 9 > size)
+				return false;
+
+			*height = ((UINT)jpeg[p + 5] << 8) | jpeg[p + 6];
+			*width = ((UINT)jpeg[p + 7] << 8) | jpeg[p + 8];
+			return *width && *height;
+		}
+		p += 2 + len;
+	}
+	return false;
+}
+
+bool MjpegSplitter::HasExif(const BYTE* jpeg, size_t size)
+{
+	// walk the segments in front of the scan data, looking for APP1 "Exif\0\0"
+	size_t pos = 2;
+	while (pos + 4 <= size && jpeg[pos] == 0xFF)
+	{
+		auto marker = jpeg[pos + 1];
+		if (marker == 0xDA || marker == 0xD9)
+			break;
+
+		size_t length = ((size_t)jpeg[pos + 2] << 8) | jpeg[pos + 3];
+		if (marker == 0xE1 && length >= 8 && pos + 10 <= size && !memcmp(jpeg + pos + 4, "Exif\0\0", 6))
+			return true;
+
+		pos += 2 + length;
+	}
+	return false;
+}
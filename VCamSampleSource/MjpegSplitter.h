@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+// Incremental MJPEG frame splitter.
+// The network reader writes straight into the splitter's ingest buffer; the splitter remembers where it
+// stopped parsing so each byte is examined at most once, whatever the chunk sizes, and hands out complete
+// frames as spans into that buffer without copying them.
+// The buffer memory is reused between frames: consumed bytes are only reclaimed when the writer runs out
+// of room, and then only the partial frame still in flight is moved back to the front.
+//
+// When the response is multipart/x-mixed-replace, part headers are parsed and a part's Content-Length is
+// used to jump over its body without looking at it. Without a length (or without a multipart content type)
+// the JPEG itself is walked marker segment by marker segment, so SOI/EOI pairs nested in APPn segments
+// (EXIF thumbnails) are skipped, and only the entropy-coded data is scanned for 0xFF, using SSE2/AVX2 when
+// the CPU has them.
+class MjpegSplitter
+{
+	enum class State
+	{
+		Boundary,    // multipart: looking for the next boundary delimiter, _readPos stays where the search began
+		Headers,     // multipart: reading part headers up to the empty line
+		Body,        // multipart: waiting for Content-Length bytes of body
+		Jpeg,        // looking for SOI, then walking JPEG marker segments
+	};
+
+	std::vector<BYTE> _buffer;   // ingest storage, its size is the current capacity
+	size_t _readPos = 0;         // first byte not consumed yet
+	size_t _writePos = 0;        // end of valid data
+	size_t _scanPos = 0;         // next byte to examine, may be past _writePos when skipping a segment or body
+	size_t _frameStart = 0;      // SOI or body offset of the frame in progress
+	size_t _contentLength = 0;   // body length of the current part, 0 if unknown
+	LONGLONG _timestamp = 0;     // X-Timestamp of the current part, 100 ns units, 0 if none
+	LONGLONG _frameTimestamp = 0; // of the frame NextFrame returned last
+	State _state = State::Jpeg;
+	bool _inFrame = false;       // Jpeg: SOI found
+	bool _entropy = false;       // Jpeg: inside entropy-coded data after SOS
+	bool _lenient = false;       // Jpeg: segment structure broken, fall back to a plain EOI search
+	std::string _boundary;       // multipart boundary, empty when not multipart
+	ULONGLONG _frames = 0;
+	ULONGLONG _lengthFrames = 0; // frames delimited by Content-Length
+	ULONGLONG _bytesMoved = 0;   // bytes moved by compaction, for diagnostics
+
+	void Rebase(size_t offset);
+	void Compact();
+	State InitialState() const { return _boundary.empty() ? State::Jpeg : State::Boundary; }
+	void StartFrame(size_t pos);
+	size_t FindMarker(size_t from) const;
+	bool ParseBoundary();
+	bool ParseHeaders();
+	bool ParseJpeg(size_t* frameEnd);
+
+public:
+	static constexpr size_t InitialCapacity = 512 * 1024;
+	static constexpr size_t MaxCapacity = 32 * 1024 * 1024;
+	static constexpr size_t MaxHeadersSize = 16 * 1024;
+	static constexpr size_t MaxBoundarySkip = 256 * 1024;
+
+	// Configures parsing from the HTTP response Content-Type; resets any buffered data
+	void SetContentType(const std::string& contentType);
+	const std::string& Boundary() const { return _boundary; }
+
+	// Name of the marker byte scanner selected for this CPU (AVX2, SSE2 or scalar)
+	static const char* MarkerScanner();
+	// Reads a complete JPEG's size from its frame header (SOFn), walking the marker segments before it only
+	static bool ReadFrameSize(const BYTE* jpeg, size_t size, UINT* width, UINT* height);
+	// True if the JPEG has an EXIF APP1 segment, which may carry an orientation
+	static bool HasExif(const BYTE* jpeg, size_t size);
+
+	// Returns room for at least size bytes at the end of the buffer; invalidates spans returned by NextFrame
+	BYTE* GetWriteBuffer(size_t size);
+	void CommitWrite(size_t written);
+	void Append(const BYTE* data, size_t size);
+
+	// Returns the next complete JPEG as a span into the ingest buffer; the span stays valid until the next
+	// GetWriteBuffer/Append/Reset call. Returns false if more data is needed.
+	bool NextFrame(const BYTE** data, size_t* size);
+	// The server's capture time of the frame NextFrame returned last, from its part's X-Timestamp header (seconds,
+	// with a fraction) in 100 ns units; 0 when the server doesn't send one
+	LONGLONG FrameTimestamp() const { return _frameTimestamp; }
+
+	// Drops buffered data and parse state, keeps the content type configuration
+	void Reset();
+	size_t BufferedSize() const { return _writePos - _readPos; }
+	size_t Capacity() const { return _buffer.size(); }
+	ULONGLONG FrameCount() const { return _frames; }
+	ULONGLONG LengthFrameCount() const { return _lengthFrames; }
+	ULONGLONG BytesMoved() const { return _bytesMoved; }
+};
@@ -0,0 +1,22 @@
+#include "pch.h"
+#include "MjpegTransport.h"
+
+// The parts of the transports that don't depend on how bytes are read, shared by WinHttpTransport.cpp and
+// PosixSocketTransport.cpp.
+
+HRESULT MjpegTransport::ResponseResult(DWORD statusCode, bool frameReceived)
+{
+	if (!IsSuccess(statusCode))
+		return HTTP_E_STATUS_UNEXPECTED;
+
+	return frameReceived ? S_OK : HRESULT_FROM_WIN32(ERROR_NO_DATA);
+}
+
+DWORD MjpegTransport::PollDelay(const MjpegEndpoint& endpoint, MFTIME requestStart)
+{
+	auto elapsedMs = (MFGetSystemTime() - requestStart) / 10000;
+	if (!endpoint.snapshot || elapsedMs >= endpoint.pollIntervalMs)
+		return 0;
+
+	return endpoint.pollIntervalMs - (DWORD)elapsedMs;
+}
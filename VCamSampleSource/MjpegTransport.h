@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <random>
+#include <algorithm>
+
+// Where an MJPEG stream comes from, parsed from http(s)://host[:port]/path
+struct MjpegEndpoint
+{
+	std::wstring host;
+	WORD port = 80;
+	std::wstring path;
+	bool https = false;
+
+	// the URL serves a single JPEG per request instead of a stream: each response is one frame and the next
+	// request goes out as soon as it ends, at most once every pollIntervalMs, over the same keep-alive connection
+	bool snapshot = false;
+	DWORD pollIntervalMs = 0;
+};
+
+// Receives what a transport reads from the camera.
+// A transport never calls its sink from two threads at once, and never after Stop returns.
+struct MjpegTransportSink
+{
+	// a new response started, anything buffered from a previous one is stale
+	virtual void OnResponse(DWORD statusCode, const std::string& contentType) = 0;
+	// where the next read lands, at least size bytes
+	virtual BYTE* GetReadBuffer(DWORD size) = 0;
+	// size bytes were written to the last buffer returned by GetReadBuffer; true if they completed a frame
+	virtual bool OnData(DWORD size) = 0;
+	// the response failed or ended, the transport reconnects by itself
+	virtual void OnError(HRESULT hr) = 0;
+};
+
+// Delay before reconnecting after a failure: doubles with each consecutive failure up to MaxDelayMs, the
+// upper half randomized so cameras that dropped together don't hammer the server in lockstep.
+class ReconnectBackoff
+{
+	UINT _failures = 0;
+	std::minstd_rand _random;
+
+public:
+	static constexpr DWORD MinDelayMs = 50;
+	static constexpr DWORD MaxDelayMs = 5000;
+
+	ReconnectBackoff() : _random((unsigned int)(MFGetSystemTime() ^ (uintptr_t)this)) {}
+
+	DWORD Next()
+	{
+		auto limit = std::min<DWORD>(MaxDelayMs, MinDelayMs << std::min<UINT>(_failures, 8));
+		_failures++;
+		return limit / 2 + _random() % (limit / 2 + 1);
+	}
+
+	// a response delivered a frame, the next failure starts over from MinDelayMs
+	void Reset() { _failures = 0; }
+};
+
+// Moves bytes from an HTTP endpoint to a sink until stopped.
+class MjpegTransport
+{
+protected:
+	// time spent blocked, on data or before a reconnect, in 100ns units
+	std::atomic<ULONGLONG> _waits{ 0 };
+	std::atomic<ULONGLONG> _waitTime{ 0 };
+	std::atomic<ULONGLONG> _reconnects{ 0 };
+
+	void AddWait(MFTIME duration) { _waits++; _waitTime += duration; }
+
+	static bool IsSuccess(DWORD statusCode) { return statusCode >= 200 && statusCode < 300; }
+
+	// how a response that was read to the end went: one with an error status or without a single frame failed,
+	// and reopening it at once would just spin on the server
+	static HRESULT ResponseResult(DWORD statusCode, bool frameReceived);
+	// snapshot mode: how long to hold the next request so polling doesn't outrun the frame rate; 0 for streams,
+	// whose next request goes out as soon as one ends with frames
+	static DWORD PollDelay(const MjpegEndpoint& endpoint, MFTIME requestStart);
+
+public:
+	static constexpr DWORD ReadSize = 64 * 1024;
+
+	struct Stats
+	{
+		ULONGLONG waits;
+		ULONGLONG waitTimeMs;
+		ULONGLONG reconnects;
+	};
+
+	virtual ~MjpegTransport() = default;
+	virtual HRESULT Start(const MjpegEndpoint& endpoint, MjpegTransportSink* sink) = 0;
+	// Cancels a pending reconnect delay right away rather than waiting it out
+	virtual void Stop() = 0;
+
+	Stats GetStats() const { return { _waits.load(), _waitTime.load() / 10000, _reconnects.load() }; }
+
+	// WinHTTP, blocking or asynchronous, on Windows (WinHttpTransport.cpp); sockets elsewhere (PosixSocketTransport.cpp)
+	static std::unique_ptr<MjpegTransport> Create(bool async);
+};
@@ -0,0 +1,98 @@
+#include "pch.h"
+#include "PixelFormats.h"
+
+static HRESULT CopyRGB32(const BYTE* input, ULONG inputSize, LONG inputStride, UINT width, UINT height, BYTE* output, ULONG outputSize, LONG outputStride, YuvMatrix, YuvRange)
+{
+	RETURN_HR_IF_NULL(E_INVALIDARG, input);
+	RETURN_HR_IF_NULL(E_INVALIDARG, output);
+	if (!width || !height)
+		return S_OK;
+
+	RETURN_HR_IF(E_INVALIDARG, inputStride < 0 || (ULONGLONG)inputStride < (ULONGLONG)width * 4);
+	RETURN_HR_IF(E_INVALIDARG, outputStride < 0 || (ULONGLONG)outputStride < (ULONGLONG)width * 4);
+	RETURN_HR_IF(E_UNEXPECTED, (ULONGLONG)inputStride * (height - 1) + (ULONGLONG)width * 4 > inputSize);
+	RETURN_HR_IF(E_UNEXPECTED, (ULONGLONG)outputStride * (height - 1) + (ULONGLONG)width * 4 > outputSize);
+	for (UINT y = 0; y < height; y++)
+	{
+		memcpy(output + (size_t)y * outputStride, input + (size_t)y * inputStride, (size_t)width * 4);
+	}
+	return S_OK;
+}
+
+const PixelFormat PixelFormat::Formats[PixelFormat::Count] =
+{
+	{ MFVideoFormat_RGB32, L"RGB32", 1, { { 0, 0, 0, 4, 0x00000000 } }, CopyRGB32 },
+	{ MFVideoFormat_NV12, L"NV12", 2, { { 0, 0, 0, 1, 0x10101010 }, { 1, 1, 0, 2, 0x80808080 } }, RGB32ToNV12 },
+	{ MFVideoFormat_YUY2, L"YUY2", 1, { { 1, 0, 0, 4, 0x80108010 } }, RGB32ToYUY2 },
+	{ MFVideoFormat_I420, L"I420", 3, { { 0, 0, 0, 1, 0x10101010 }, { 1, 1, 1, 1, 0x80808080 }, { 1, 1, 1, 1, 0x80808080 } }, RGB32ToI420 },
+};
+
+const PixelFormat* PixelFormat::Find(REFGUID subtype)
+{
+	for (auto& format : Formats)
+	{
+		if (format.subtype == subtype)
+			return &format;
+	}
+	return nullptr;
+}
+
+UINT PixelFormat::BitsPerPixel() const
+{
+	UINT bits = 0;
+	for (UINT i = 0; i < planeCount; i++)
+	{
+		bits += (planes[i].sampleBytes * 8u) >> (planes[i].xShift + planes[i].yShift);
+	}
+	return bits;
+}
+
+ULONGLONG PixelFormat::ImageSize(UINT height, LONG pitch) const
+{
+	ULONGLONG size = 0;
+	for (UINT i = 0; i < planeCount; i++)
+	{
+		size += (ULONGLONG)planes[i].Pitch(pitch) * planes[i].Rows(height);
+	}
+	return size;
+}
+
+void PixelFormat::Fill(BYTE* image, LONG pitch, UINT height) const
+{
+	for (UINT i = 0; i < planeCount; i++)
+	{
+		auto& plane = planes[i];
+		const size_t size = (size_t)plane.Pitch(pitch) * plane.Rows(height);
+		if (plane.black == (plane.black & 0xFF) * 0x01010101u)
+		{
+			memset(image, plane.black & 0xFF, size);
+		}
+		else
+		{
+			// pitches are even, and multiples of 4 for the packed formats
+			for (size_t offset = 0; offset + 4 <= size; offset += 4)
+			{
+				memcpy(image + offset, &plane.black, 4);
+			}
+		}
+		image += size;
+	}
+}
+
+void PixelFormat::Copy(const BYTE* source, LONG sourcePitch, BYTE* destination, LONG destinationPitch, UINT width, UINT height) const
+{
+	for (UINT i = 0; i < planeCount; i++)
+	{
+		auto& plane = planes[i];
+		const LONG from = plane.Pitch(sourcePitch);
+		const LONG to = plane.Pitch(destinationPitch);
+		const UINT rows = plane.Rows(height);
+		const UINT rowBytes = plane.RowBytes(width);
+		for (UINT y = 0; y < rows; y++)
+		{
+			memcpy(destination + (size_t)y * to, source + (size_t)y * from, rowBytes);
+		}
+		source += (size_t)from * rows;
+		destination += (size_t)to * rows;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ColorConversion.h"
+
+// Where a plane is in a sample buffer. Planes follow each other, each at the buffer's pitch shifted right by
+// pitchShift; a sample of sampleBytes bytes covers 2^xShift pixels of a row, and a row 2^yShift rows of the image.
+struct PixelPlane
+{
+	BYTE xShift;
+	BYTE yShift;
+	BYTE pitchShift;
+	BYTE sampleBytes;
+	UINT32 black; // 4 bytes repeated over the plane, video range black for YUV
+
+	UINT RowBytes(UINT width) const { return ((width + (1u << xShift) - 1) >> xShift) * sampleBytes; }
+	UINT Rows(UINT height) const { return (height + (1u << yShift) - 1) >> yShift; }
+	LONG Pitch(LONG pitch) const { return pitch >> pitchShift; }
+};
+
+// An uncompressed output format: how its sample buffers are laid out, and the conversion from the BGRA pictures
+// the decoder and the scaler produce. Generate, the spinner and the media types look formats up here instead of
+// testing subtypes.
+struct PixelFormat
+{
+	typedef HRESULT(*ConvertFn)(const BYTE* input, ULONG inputSize, LONG inputStride, UINT width, UINT height, BYTE* output, ULONG outputSize, LONG outputStride, YuvMatrix matrix, YuvRange range);
+
+	const GUID& subtype;
+	const wchar_t* name;
+	UINT planeCount;
+	PixelPlane planes[3];
+	ConvertFn fromRGB32;
+
+	static constexpr UINT Count = 4;
+	// RGB32, NV12, YUY2 and I420, in the order the media types list them
+	static const PixelFormat Formats[Count];
+	// nullptr for formats the CPU path doesn't write (MJPG)
+	static const PixelFormat* Find(REFGUID subtype);
+
+	UINT DefaultStride(UINT width) const { return planes[0].RowBytes(width); }
+	UINT BitsPerPixel() const;
+	// Bytes of an image in a buffer with that pitch
+	ULONGLONG ImageSize(UINT height, LONG pitch) const;
+	// Black over the whole image
+	void Fill(BYTE* image, LONG pitch, UINT height) const;
+	// Copies an image between buffers of different pitches, plane by plane
+	void Copy(const BYTE* source, LONG sourcePitch, BYTE* destination, LONG destinationPitch, UINT width, UINT height) const;
+};
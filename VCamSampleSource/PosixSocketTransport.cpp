@@ -0,0 +1,492 @@
+#include "pch.h"
+#include "PosixSocketTransport.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+static const HRESULT BadResponse = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+static std::string Trim(const std::string& text)
+{
+	auto begin = text.find_first_not_of(" \t");
+	if (begin == std::string::npos)
+		return std::string();
+
+	return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+}
+
+// outside Windows, the one transport
+std::unique_ptr<MjpegTransport> MjpegTransport::Create(bool /*async*/)
+{
+	return std::make_unique<PosixSocketTransport>();
+}
+
+HRESULT PosixSocketTransport::Start(const MjpegEndpoint& endpoint, MjpegTransportSink* sink)
+{
+	RETURN_HR_IF_NULL(E_POINTER, sink);
+	RETURN_HR_IF(E_UNEXPECTED, _thread.joinable());
+	RETURN_HR_IF(E_NOTIMPL, endpoint.https);
+
+	// host names and paths are ASCII, percent-encoded where needed
+	auto narrow = [](const std::wstring& text, std::string& result)
+	{
+		result.clear();
+		for (auto c : text)
+		{
+			if (c <= L' ' || c >= 0x7F)
+				return false;
+			result += (char)c;
+		}
+		return !result.empty();
+	};
+	std::string path;
+	RETURN_HR_IF(E_INVALIDARG, !narrow(endpoint.host, _host) || !narrow(endpoint.path, path));
+
+	_request = "GET " + path + " HTTP/1.1\r\nHost: " + _host + (endpoint.port != 80 ? ":" + std::to_string(endpoint.port) : std::string()) +
+		"\r\nUser-Agent: WinCamHTTP/1.0\r\nAccept: */*\r\n\r\n";
+	_endpoint = endpoint;
+	_sink = sink;
+	RETURN_HR_IF(E_FAIL, pipe2(_wake, O_CLOEXEC));
+	try
+	{
+		_thread = std::thread([this]() { Loop(); });
+		WINTRACE(L"MJPEG: socket transport thread started");
+		return S_OK;
+	}
+	catch (...)
+	{
+		WINTRACE(L"MJPEG: failed to start socket transport thread");
+		return E_FAIL;
+	}
+}
+
+void PosixSocketTransport::Stop()
+{
+	if (_thread.joinable())
+	{
+		const char stop = 0;
+		(void)!write(_wake[1], &stop, 1);
+		_thread.join();
+	}
+
+	Close();
+	for (auto& fd : _wake)
+	{
+		if (fd != -1)
+		{
+			close(fd);
+			fd = -1;
+		}
+	}
+}
+
+HRESULT PosixSocketTransport::Wait(short events)
+{
+	pollfd fds[2] = { { _socket, events, 0 }, { _wake[0], POLLIN, 0 } };
+	auto start = MFGetSystemTime();
+	int ready;
+	do
+	{
+		ready = poll(fds, 2, -1);
+	} while (ready < 0 && errno == EINTR);
+	if (events & POLLIN)
+	{
+		AddWait(MFGetSystemTime() - start);
+	}
+
+	RETURN_HR_IF(E_FAIL, ready < 0);
+	RETURN_HR_IF(E_ABORT, fds[1].revents);
+	return S_OK; // readable, writable or failed: the call that follows tells
+}
+
+bool PosixSocketTransport::WaitStop(DWORD ms)
+{
+	pollfd fd{ _wake[0], POLLIN, 0 };
+	auto start = MFGetSystemTime();
+	int ready;
+	do
+	{
+		ready = poll(&fd, 1, (int)ms);
+	} while (ready < 0 && errno == EINTR);
+	AddWait(MFGetSystemTime() - start);
+	return ready > 0;
+}
+
+HRESULT PosixSocketTransport::Connect()
+{
+	addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* addresses = nullptr;
+	auto error = getaddrinfo(_host.c_str(), std::to_string(_endpoint.port).c_str(), &hints, &addresses);
+	if (error)
+	{
+		WINTRACE(L"MJPEG: getaddrinfo failed %d host:%S", error, _host.c_str());
+		return E_FAIL;
+	}
+	std::unique_ptr<addrinfo, decltype(&freeaddrinfo)> list(addresses, freeaddrinfo);
+
+	for (auto address = addresses; address; address = address->ai_next)
+	{
+		_socket = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+		if (_socket == -1)
+			continue;
+
+		error = connect(_socket, address->ai_addr, address->ai_addrlen) ? errno : 0;
+		if (error == EINPROGRESS)
+		{
+			RETURN_IF_FAILED(Wait(POLLOUT));
+			socklen_t size = sizeof(error);
+			if (getsockopt(_socket, SOL_SOCKET, SO_ERROR, &error, &size))
+			{
+				error = errno;
+			}
+		}
+
+		if (!error)
+			return S_OK;
+
+		Close();
+	}
+	WINTRACE(L"MJPEG: connect failed %d host:%S port:%u", error, _host.c_str(), _endpoint.port);
+	return E_FAIL;
+}
+
+void PosixSocketTransport::Close()
+{
+	if (_socket != -1)
+	{
+		close(_socket);
+		_socket = -1;
+	}
+	_responding = false;
+	_input.clear();
+	_inputPos = 0;
+}
+
+HRESULT PosixSocketTransport::Send(const std::string& text)
+{
+	for (size_t sent = 0; sent < text.size();)
+	{
+		auto written = send(_socket, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+		if (written >= 0)
+		{
+			sent += written;
+		}
+		else if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			RETURN_IF_FAILED(Wait(POLLOUT));
+		}
+		else if (errno != EINTR)
+		{
+			return E_FAIL;
+		}
+	}
+	return S_OK;
+}
+
+HRESULT PosixSocketTransport::Fill()
+{
+	if (_inputPos == _input.size())
+	{
+		_input.clear();
+		_inputPos = 0;
+	}
+
+	const size_t size = 16 * 1024;
+	for (;;)
+	{
+		RETURN_IF_FAILED(Wait(POLLIN));
+		const size_t used = _input.size();
+		_input.resize(used + size);
+		auto received = recv(_socket, _input.data() + used, size, 0);
+		_input.resize(used + std::max<ssize_t>(received, 0));
+		if (received > 0)
+			return S_OK;
+		if (received == 0)
+			return S_FALSE;
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			return E_FAIL;
+	}
+}
+
+HRESULT PosixSocketTransport::ReadLine(std::string& line)
+{
+	for (;;)
+	{
+		auto begin = _input.begin() + _inputPos;
+		auto end = std::find(begin, _input.end(), (BYTE)'\n');
+		if (end != _input.end())
+		{
+			line.assign(begin, end);
+			_inputPos = end + 1 - _input.begin();
+			if (!line.empty() && line.back() == '\r')
+			{
+				line.pop_back();
+			}
+			return S_OK;
+		}
+
+		RETURN_HR_IF(BadResponse, _input.size() - _inputPos > MaxLineSize);
+		auto hr = Fill();
+		if (hr != S_OK)
+			return hr;
+	}
+}
+
+HRESULT PosixSocketTransport::ReadHeaders()
+{
+	// S_FALSE when the server closed the connection before the status line, as it may with a kept-alive one
+	std::string line;
+	auto hr = ReadLine(line);
+	if (hr != S_OK)
+		return hr;
+
+	int major = 0, minor = 0;
+	unsigned int status = 0;
+	RETURN_HR_IF(BadResponse, sscanf(line.c_str(), "HTTP/%d.%d %u", &major, &minor, &status) != 3);
+	_statusCode = status;
+	_keepAlive = major > 1 || (major == 1 && minor >= 1);
+	_chunked = false;
+	_firstChunk = true;
+	_remaining = -1;
+
+	std::string contentType;
+	size_t headersSize = line.size();
+	for (;;)
+	{
+		hr = ReadLine(line);
+		RETURN_IF_FAILED(hr);
+		RETURN_HR_IF(BadResponse, hr != S_OK);
+		headersSize += line.size();
+		RETURN_HR_IF(BadResponse, headersSize > MaxHeadersSize);
+		if (line.empty())
+			break;
+
+		auto colon = line.find(':');
+		if (colon == std::string::npos)
+			continue;
+
+		auto name = line.substr(0, colon);
+		auto value = Trim(line.substr(colon + 1));
+		if (!strcasecmp(name.c_str(), "Content-Type"))
+		{
+			contentType = value;
+		}
+		else if (!strcasecmp(name.c_str(), "Content-Length"))
+		{
+			char* end = nullptr;
+			_remaining = strtoll(value.c_str(), &end, 10);
+			RETURN_HR_IF(BadResponse, value.empty() || *end || _remaining < 0);
+		}
+		else if (!strcasecmp(name.c_str(), "Transfer-Encoding"))
+		{
+			_chunked = strcasestr(value.c_str(), "chunked") != nullptr;
+		}
+		else if (!strcasecmp(name.c_str(), "Connection"))
+		{
+			if (!strcasecmp(value.c_str(), "close"))
+			{
+				_keepAlive = false;
+			}
+			else if (!strcasecmp(value.c_str(), "keep-alive"))
+			{
+				_keepAlive = true;
+			}
+		}
+	}
+
+	if (_chunked)
+	{
+		_remaining = 0; // of the chunk not yet started
+	}
+	else if (_remaining < 0)
+	{
+		_keepAlive = false; // the body ends with the connection
+	}
+
+	// the backoff only starts over once the response delivers a frame, see ReadBody
+	_frameReceived = false;
+	WINTRACE(L"MJPEG: response received. HTTP %u", _statusCode);
+	_sink->OnResponse(_statusCode, contentType);
+	return S_OK;
+}
+
+HRESULT PosixSocketTransport::OpenResponse()
+{
+	if (_responding)
+		return S_OK;
+
+	for (;;)
+	{
+		const bool reused = _socket != -1;
+		if (!reused)
+		{
+			RETURN_IF_FAILED(Connect());
+		}
+
+		WINTRACE(L"MJPEG: sending request to %S:%u", _host.c_str(), _endpoint.port);
+		_requestStart = MFGetSystemTime();
+		auto hr = Send(_request);
+		if (SUCCEEDED(hr))
+		{
+			hr = ReadHeaders();
+		}
+		if (hr == S_OK)
+			break;
+
+		// a kept-alive connection may have been closed by the server meanwhile: once more on a new one
+		Close();
+		if (hr == E_ABORT || !reused)
+			return hr == S_FALSE ? BadResponse : hr;
+	}
+
+	_responding = true;
+	return S_OK;
+}
+
+HRESULT PosixSocketTransport::ReadBody(size_t size)
+{
+	// bytes that came with the headers or a chunk size line first, then straight into the sink's buffer
+	DWORD received = 0;
+	const size_t buffered = _input.size() - _inputPos;
+	if (buffered)
+	{
+		received = (DWORD)std::min(buffered, size);
+		memcpy(_sink->GetReadBuffer(received), _input.data() + _inputPos, received);
+		_inputPos += received;
+	}
+	else
+	{
+		for (;;)
+		{
+			RETURN_IF_FAILED(Wait(POLLIN));
+			auto count = recv(_socket, _sink->GetReadBuffer((DWORD)size), size, 0);
+			if (count > 0)
+			{
+				received = (DWORD)count;
+				break;
+			}
+			if (count == 0)
+				return S_FALSE;
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				return E_FAIL;
+		}
+	}
+
+	if (_remaining > 0)
+	{
+		_remaining -= received;
+	}
+	if (_sink->OnData(received) && IsSuccess(_statusCode))
+	{
+		_frameReceived = true;
+		_backoff.Reset();
+	}
+	return S_OK;
+}
+
+HRESULT PosixSocketTransport::Read()
+{
+	// one read into the sink; S_FALSE once the response ended
+	if (_chunked)
+	{
+		if (!_remaining)
+		{
+			std::string line;
+			if (!_firstChunk)
+			{
+				// the CRLF closing the previous chunk's data
+				auto hr = ReadLine(line);
+				RETURN_IF_FAILED(hr);
+				RETURN_HR_IF(BadResponse, hr != S_OK || !line.empty());
+			}
+			_firstChunk = false;
+
+			auto hr = ReadLine(line);
+			RETURN_IF_FAILED(hr);
+			RETURN_HR_IF(BadResponse, hr != S_OK || line.empty() || !isxdigit((unsigned char)line[0]));
+			_remaining = (LONGLONG)strtoull(line.c_str(), nullptr, 16); // chunk extensions after ';' are ignored
+			if (!_remaining)
+			{
+				// last chunk, then trailers up to an empty line
+				do
+				{
+					hr = ReadLine(line);
+					RETURN_IF_FAILED(hr);
+					RETURN_HR_IF(BadResponse, hr != S_OK);
+				} while (!line.empty());
+				return S_FALSE;
+			}
+		}
+
+		auto hr = ReadBody((size_t)std::min<LONGLONG>(_remaining, ReadSize));
+		RETURN_HR_IF(BadResponse, hr == S_FALSE); // closed inside a chunk
+		return hr;
+	}
+
+	if (!_remaining)
+		return S_FALSE;
+
+	auto hr = ReadBody(_remaining > 0 ? (size_t)std::min<LONGLONG>(_remaining, ReadSize) : ReadSize);
+	if (hr == S_FALSE)
+	{
+		RETURN_HR_IF(BadResponse, _remaining > 0); // closed before Content-Length
+		_keepAlive = false;
+	}
+	return hr;
+}
+
+void PosixSocketTransport::Loop()
+{
+	WINTRACE(L"MJPEG: socket reader loop starting for %S:%u", _host.c_str(), _endpoint.port);
+	for (;;)
+	{
+		auto hr = OpenResponse();
+		if (SUCCEEDED(hr))
+		{
+			hr = Read();
+		}
+		if (hr == E_ABORT)
+			break;
+
+		if (hr == S_FALSE)
+		{
+			// the response was read to the end: reopen it at once, over the same connection if it's kept alive,
+			// unless it failed, then Loop backs off
+			_responding = false;
+			hr = ResponseResult(_statusCode, _frameReceived);
+			if (SUCCEEDED(hr))
+			{
+				_reconnects++;
+				if (!_keepAlive)
+				{
+					Close();
+				}
+
+				auto delay = PollDelay(_endpoint, _requestStart);
+				if (delay && WaitStop(delay))
+					break;
+				continue;
+			}
+			WINTRACE(L"MJPEG: response ended without a frame (HTTP %u), backing off", _statusCode);
+		}
+
+		if (FAILED(hr))
+		{
+			_sink->OnError(hr);
+			Close();
+			_reconnects++;
+
+			// back off, but leave as soon as Stop is called
+			auto delay = _backoff.Next();
+			WINTRACE(L"MJPEG: reconnecting in %u ms", delay);
+			if (WaitStop(delay))
+				break;
+		}
+	}
+	WINTRACE(L"MJPEG: socket reader loop stopped.");
+}
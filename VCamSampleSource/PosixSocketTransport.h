@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <vector>
+#include "MjpegTransport.h"
+
+// HTTP over plain BSD sockets with blocking reads on a dedicated thread per stream, the counterpart of
+// WinHttpSyncTransport outside Windows, where the tests run it against a loopback server. It isn't part of the
+// Visual Studio project. Responses are read to their Content-Length, to the last chunk, or until the server closes;
+// the first two leave the connection open for the next request. No TLS: https endpoints fail to start.
+// The thread only ever blocks in poll, on the socket and on a pipe Stop writes to.
+class PosixSocketTransport : public MjpegTransport
+{
+	static constexpr size_t MaxLineSize = 8 * 1024;
+	static constexpr size_t MaxHeadersSize = 64 * 1024;
+
+	MjpegEndpoint _endpoint;
+	std::string _host;
+	std::string _request;
+	MjpegTransportSink* _sink = nullptr;
+	std::thread _thread;
+	int _wake[2] = { -1, -1 }; // Stop writes to [1], which ends any wait
+	int _socket = -1;
+	ReconnectBackoff _backoff;
+
+	// the response being read
+	bool _responding = false;
+	MFTIME _requestStart = 0;
+	DWORD _statusCode = 0;
+	bool _frameReceived = false;
+	bool _keepAlive = false;
+	bool _chunked = false;
+	bool _firstChunk = true;
+	LONGLONG _remaining = -1; // body bytes left, or in the current chunk when chunked; -1 reads until closed
+
+	// bytes received past what was parsed, handed to the sink before reading more
+	std::vector<BYTE> _input;
+	size_t _inputPos = 0;
+
+	HRESULT Wait(short events);
+	bool WaitStop(DWORD ms);
+	HRESULT Connect();
+	void Close();
+	HRESULT Send(const std::string& text);
+	HRESULT Fill();
+	HRESULT ReadLine(std::string& line);
+	HRESULT ReadHeaders();
+	HRESULT OpenResponse();
+	HRESULT ReadBody(size_t size);
+	HRESULT Read();
+	void Loop();
+
+public:
+	~PosixSocketTransport() { Stop(); }
+
+	HRESULT Start(const MjpegEndpoint& endpoint, MjpegTransportSink* sink) override;
+	void Stop() override;
+};
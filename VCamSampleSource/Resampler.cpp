@@ -0,0 +1,580 @@
+#include "pch.h"
+#include "Resampler.h"
+#include "SlicePool.h"
+#include "CpuFeatures.h"
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+#if defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+static const int WeightBits = 14;
+static const int WeightOne = 1 << WeightBits;
+static const int WeightRound = 1 << (WeightBits - 1);
+static const size_t MaxCachedAxes = 32; // a handful of size pairs are in use at any time
+
+// Each destination pixel is a weighted sum of taps consecutive source pixels, from its start
+struct ResampleAxis
+{
+	UINT taps = 0;
+	std::vector<UINT> starts;
+	std::vector<INT16> weights; // taps per destination pixel
+	std::vector<int> pairs;     // the same weights two by two as the vector loops multiply them, (taps + 1) / 2 per pixel
+};
+
+static double FilterRadius(ResampleFilter filter)
+{
+	switch (filter)
+	{
+	case ResampleFilter::Bicubic:
+		return 2;
+	case ResampleFilter::Lanczos3:
+		return 3;
+	default:
+		return 1;
+	}
+}
+
+static double FilterWeight(ResampleFilter filter, double x)
+{
+	x = fabs(x);
+	switch (filter)
+	{
+	case ResampleFilter::Bicubic:
+		// Catmull-Rom, a = -0.5
+		if (x < 1)
+			return (1.5 * x - 2.5) * x * x + 1;
+		if (x < 2)
+			return ((-0.5 * x + 2.5) * x - 4) * x + 2;
+		return 0;
+
+	case ResampleFilter::Lanczos3:
+	{
+		if (x < 1e-8)
+			return 1;
+		if (x >= 3)
+			return 0;
+		const double px = 3.14159265358979323846 * x;
+		return 3 * sin(px) * sin(px / 3) / (px * px);
+	}
+
+	default:
+		return x < 1 ? 1 - x : 0;
+	}
+}
+
+static std::shared_ptr<const ResampleAxis> BuildAxis(UINT src, UINT dst, ResampleFilter filter)
+{
+	const double scale = (double)src / dst;
+	const double stretch = std::max(1.0, scale); // shrinking widens the filter so it covers every source pixel
+	const double support = FilterRadius(filter) * stretch;
+
+	// weights of each destination pixel over [first, first + count), pixels past the edges repeat the edge ones
+	std::vector<UINT> firsts(dst);
+	std::vector<UINT> counts(dst);
+	std::vector<double> weights;
+	const auto window = (size_t)ceil(support) * 2 + 2;
+	weights.resize(window * dst);
+	UINT taps = 1;
+	for (UINT i = 0; i < dst; i++)
+	{
+		const double center = (i + 0.5) * scale;
+		const int left = (int)floor(center - support);
+		const int right = (int)ceil(center + support);
+		const int first = std::clamp(left, 0, (int)src - 1);
+		const int last = std::clamp(right, 0, (int)src - 1);
+		auto w = weights.data() + window * i;
+		for (int j = left; j <= right; j++)
+		{
+			w[std::clamp(j, 0, (int)src - 1) - first] += FilterWeight(filter, (j + 0.5 - center) / stretch);
+		}
+
+		// drop zero weights on both ends, the triangle filter has one at each
+		int begin = 0, end = last - first;
+		while (begin < end && w[begin] == 0)
+		{
+			begin++;
+		}
+		while (end > begin && w[end] == 0)
+		{
+			end--;
+		}
+		firsts[i] = first + begin;
+		counts[i] = end - begin + 1;
+		if (begin)
+		{
+			memmove(w, w + begin, counts[i] * sizeof(double));
+		}
+		taps = std::max(taps, counts[i]);
+	}
+
+	// same tap count everywhere so the loops have no per-pixel bounds; windows shift left at the right edge
+	auto axis = std::make_shared<ResampleAxis>();
+	axis->taps = taps;
+	axis->starts.resize(dst);
+	axis->weights.assign((size_t)dst * taps, 0);
+	const UINT pairCount = (taps + 1) / 2;
+	axis->pairs.resize((size_t)dst * pairCount);
+	for (UINT i = 0; i < dst; i++)
+	{
+		const auto start = std::min(firsts[i], src - taps);
+		const auto offset = firsts[i] - start;
+		const auto w = weights.data() + window * i;
+		double sum = 0;
+		for (UINT t = 0; t < counts[i]; t++)
+		{
+			sum += w[t];
+		}
+
+		auto q = axis->weights.data() + (size_t)i * taps;
+		int total = 0;
+		UINT largest = offset;
+		for (UINT t = 0; t < counts[i]; t++)
+		{
+			q[offset + t] = (INT16)lround(sum ? w[t] / sum * WeightOne : (t == 0 ? WeightOne : 0));
+			total += q[offset + t];
+			if (q[offset + t] > q[largest])
+			{
+				largest = offset + t;
+			}
+		}
+		q[largest] += (INT16)(WeightOne - total); // weights add up to exactly one, flat areas stay flat
+
+		axis->starts[i] = start;
+		for (UINT p = 0; p < pairCount; p++)
+		{
+			const auto lo = (UINT16)q[p * 2];
+			const auto hi = p * 2 + 1 < taps ? (UINT16)q[p * 2 + 1] : 0;
+			axis->pairs[(size_t)i * pairCount + p] = (int)(lo | ((UINT)hi << 16));
+		}
+	}
+	return axis;
+}
+
+static std::shared_ptr<const ResampleAxis> GetAxis(UINT src, UINT dst, ResampleFilter filter)
+{
+	static std::mutex lock;
+	static std::map<std::tuple<UINT, UINT, ResampleFilter>, std::shared_ptr<const ResampleAxis>> cache;
+
+	std::lock_guard<std::mutex> guard(lock);
+	const auto key = std::make_tuple(src, dst, filter);
+	auto it = cache.find(key);
+	if (it != cache.end())
+		return it->second;
+
+	if (cache.size() >= MaxCachedAxes)
+	{
+		cache.clear();
+	}
+	auto axis = BuildAxis(src, dst, filter);
+	cache.emplace(key, axis);
+	WINTRACE(L"Resampler: %u -> %u filter:%u taps:%u", src, dst, (UINT)filter, axis->taps);
+	return axis;
+}
+
+static inline BYTE Clamp(int value)
+{
+	return (BYTE)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+// Horizontal pass over one row, from destination pixel from on
+static void HorizontalScalar(const BYTE* src, BYTE* dst, UINT from, UINT width, UINT channels, const ResampleAxis& axis)
+{
+	for (UINT x = from; x < width; x++)
+	{
+		auto p = src + (size_t)axis.starts[x] * channels;
+		auto w = axis.weights.data() + (size_t)x * axis.taps;
+		for (UINT c = 0; c < channels; c++)
+		{
+			int sum = WeightRound;
+			for (UINT t = 0; t < axis.taps; t++)
+			{
+				sum += w[t] * p[t * channels + c];
+			}
+			dst[x * channels + c] = Clamp(sum >> WeightBits);
+		}
+	}
+}
+
+// Vertical pass over one destination row of bytes, rows being the first of its source rows, from byte from on
+static void VerticalScalar(const BYTE* rows, size_t stride, const ResampleAxis& axis, UINT y, BYTE* dst, UINT from, UINT bytes)
+{
+	auto w = axis.weights.data() + (size_t)y * axis.taps;
+	for (UINT i = from; i < bytes; i++)
+	{
+		int sum = WeightRound;
+		for (UINT t = 0; t < axis.taps; t++)
+		{
+			sum += w[t] * rows[t * stride + i];
+		}
+		dst[i] = Clamp(sum >> WeightBits);
+	}
+}
+
+// Vector versions do as much of the row as they can and return where the scalar code should take over
+typedef UINT(*HorizontalFn)(const BYTE* src, BYTE* dst, UINT width, const ResampleAxis& axis);
+typedef UINT(*VerticalFn)(const BYTE* rows, size_t stride, const ResampleAxis& axis, UINT y, BYTE* dst, UINT bytes);
+
+static UINT HorizontalNone(const BYTE*, BYTE*, UINT, const ResampleAxis&)
+{
+	return 0;
+}
+
+static UINT VerticalNone(const BYTE*, size_t, const ResampleAxis&, UINT, BYTE*, UINT)
+{
+	return 0;
+}
+
+#if defined(_M_X64) || defined(_M_IX86)
+static inline int Load16(const BYTE* p)
+{
+	UINT16 value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline int Load32(const BYTE* p)
+{
+	int value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline void Store32(BYTE* p, int value)
+{
+	memcpy(p, &value, sizeof(value));
+}
+
+static UINT HorizontalYSse41(const BYTE* src, BYTE* dst, UINT width, const ResampleAxis& axis)
+{
+	// four destination pixels at a time, each 32-bit lane holding one pixel's next two source bytes as 16-bit
+	// values for its weight pair
+	const auto round = _mm_set1_epi32(WeightRound);
+	const UINT pairCount = (axis.taps + 1) / 2;
+	UINT x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		const BYTE* p[4];
+		const int* w[4];
+		for (UINT i = 0; i < 4; i++)
+		{
+			p[i] = src + axis.starts[x + i];
+			w[i] = axis.pairs.data() + (size_t)(x + i) * pairCount;
+		}
+
+		auto sum = round;
+		UINT t = 0;
+		for (; t + 2 <= axis.taps; t += 2)
+		{
+			auto pixels = _mm_cvtepu8_epi16(_mm_setr_epi32(Load16(p[0] + t) | (Load16(p[1] + t) << 16), Load16(p[2] + t) | (Load16(p[3] + t) << 16), 0, 0));
+			auto weights = _mm_setr_epi32(w[0][t / 2], w[1][t / 2], w[2][t / 2], w[3][t / 2]);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(pixels, weights));
+		}
+		if (t < axis.taps)
+		{
+			// the last pair's second weight is 0, only read the one byte
+			auto pixels = _mm_setr_epi32(p[0][t], p[1][t], p[2][t], p[3][t]);
+			auto weights = _mm_setr_epi32(w[0][t / 2], w[1][t / 2], w[2][t / 2], w[3][t / 2]);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(pixels, weights));
+		}
+
+		auto words = _mm_packs_epi32(_mm_srai_epi32(sum, WeightBits), _mm_setzero_si128());
+		Store32(dst + x, _mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+	}
+	return x;
+}
+
+static UINT HorizontalUVSse41(const BYTE* src, BYTE* dst, UINT width, const ResampleAxis& axis)
+{
+	// two destination pixels at a time: a pixel's next two source pixels U0 V0 U1 V1 to 16-bit U0 U1 V0 V1, in
+	// the low half for the first pixel and the high half for the second
+	const auto interleave = _mm_setr_epi8(0, -1, 2, -1, 1, -1, 3, -1, 8, -1, 10, -1, 9, -1, 11, -1);
+	const auto round = _mm_set1_epi32(WeightRound);
+	const UINT pairCount = (axis.taps + 1) / 2;
+	UINT x = 0;
+	for (; x + 2 <= width; x += 2)
+	{
+		auto p0 = src + (size_t)axis.starts[x] * 2;
+		auto p1 = src + (size_t)axis.starts[x + 1] * 2;
+		auto w0 = axis.pairs.data() + (size_t)x * pairCount;
+		auto w1 = w0 + pairCount;
+		auto sum = round;
+		UINT t = 0;
+		for (; t + 2 <= axis.taps; t += 2)
+		{
+			auto pixels = _mm_shuffle_epi8(_mm_setr_epi32(Load32(p0 + t * 2), 0, Load32(p1 + t * 2), 0), interleave);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(pixels, _mm_setr_epi32(w0[t / 2], w0[t / 2], w1[t / 2], w1[t / 2])));
+		}
+		if (t < axis.taps)
+		{
+			// the last pair's second weight is 0, only read the one pixel
+			auto pixels = _mm_shuffle_epi8(_mm_setr_epi32(Load16(p0 + t * 2), 0, Load16(p1 + t * 2), 0), interleave);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(pixels, _mm_setr_epi32(w0[t / 2], w0[t / 2], w1[t / 2], w1[t / 2])));
+		}
+
+		auto words = _mm_packs_epi32(_mm_srai_epi32(sum, WeightBits), _mm_setzero_si128());
+		Store32(dst + (size_t)x * 2, _mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+	}
+	return x;
+}
+
+static UINT HorizontalBgraSse41(const BYTE* src, BYTE* dst, UINT width, const ResampleAxis& axis)
+{
+	// two neighbouring pixels B0 G0 R0 A0 B1 G1 R1 A1 to 16-bit B0 B1 G0 G1 R0 R1 A0 A1, ready for a weight pair
+	const auto interleave = _mm_setr_epi8(0, -1, 4, -1, 1, -1, 5, -1, 2, -1, 6, -1, 3, -1, 7, -1);
+	const auto round = _mm_set1_epi32(WeightRound);
+	const UINT pairCount = (axis.taps + 1) / 2;
+	for (UINT x = 0; x < width; x++)
+	{
+		auto p = src + (size_t)axis.starts[x] * 4;
+		auto w = axis.pairs.data() + (size_t)x * pairCount;
+		auto sum = round;
+		UINT t = 0;
+		for (; t + 2 <= axis.taps; t += 2)
+		{
+			auto pixels = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)(p + t * 4)), interleave);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(pixels, _mm_set1_epi32(w[t / 2])));
+		}
+		if (t < axis.taps)
+		{
+			// the last pair's second weight is 0, only read the one pixel
+			auto pixels = _mm_shuffle_epi8(_mm_cvtsi32_si128(*(const int*)(p + t * 4)), interleave);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(pixels, _mm_set1_epi32(w[t / 2])));
+		}
+
+		auto words = _mm_packs_epi32(_mm_srai_epi32(sum, WeightBits), _mm_setzero_si128());
+		*(int*)(dst + (size_t)x * 4) = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+	}
+	return width;
+}
+
+static UINT VerticalSse41(const BYTE* rows, size_t stride, const ResampleAxis& axis, UINT y, BYTE* dst, UINT bytes)
+{
+	const auto zero = _mm_setzero_si128();
+	const auto round = _mm_set1_epi32(WeightRound);
+	const auto w = axis.pairs.data() + (size_t)y * ((axis.taps + 1) / 2);
+	UINT i = 0;
+	for (; i + 16 <= bytes; i += 16)
+	{
+		auto s0 = round, s1 = round, s2 = round, s3 = round;
+		for (UINT t = 0; t < axis.taps; t += 2)
+		{
+			// bytes of two rows interleaved as 16-bit a0 b0 a1 b1 .., madd applies the weight pair
+			auto a = _mm_loadu_si128((const __m128i*)(rows + t * stride + i));
+			auto b = t + 1 < axis.taps ? _mm_loadu_si128((const __m128i*)(rows + (t + 1) * stride + i)) : zero;
+			auto weights = _mm_set1_epi32(w[t / 2]);
+			auto alo = _mm_unpacklo_epi8(a, zero);
+			auto ahi = _mm_unpackhi_epi8(a, zero);
+			auto blo = _mm_unpacklo_epi8(b, zero);
+			auto bhi = _mm_unpackhi_epi8(b, zero);
+			s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi16(alo, blo), weights));
+			s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi16(alo, blo), weights));
+			s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi16(ahi, bhi), weights));
+			s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi16(ahi, bhi), weights));
+		}
+
+		auto lo = _mm_packs_epi32(_mm_srai_epi32(s0, WeightBits), _mm_srai_epi32(s1, WeightBits));
+		auto hi = _mm_packs_epi32(_mm_srai_epi32(s2, WeightBits), _mm_srai_epi32(s3, WeightBits));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+	return i;
+}
+
+static UINT VerticalAvx2(const BYTE* rows, size_t stride, const ResampleAxis& axis, UINT y, BYTE* dst, UINT bytes)
+{
+	// same as SSE4.1 per 128-bit lane; unpacking and packing both stay within lanes, so bytes come out in order
+	const auto zero = _mm256_setzero_si256();
+	const auto round = _mm256_set1_epi32(WeightRound);
+	const auto w = axis.pairs.data() + (size_t)y * ((axis.taps + 1) / 2);
+	UINT i = 0;
+	for (; i + 32 <= bytes; i += 32)
+	{
+		auto s0 = round, s1 = round, s2 = round, s3 = round;
+		for (UINT t = 0; t < axis.taps; t += 2)
+		{
+			auto a = _mm256_loadu_si256((const __m256i*)(rows + t * stride + i));
+			auto b = t + 1 < axis.taps ? _mm256_loadu_si256((const __m256i*)(rows + (t + 1) * stride + i)) : zero;
+			auto weights = _mm256_set1_epi32(w[t / 2]);
+			auto alo = _mm256_unpacklo_epi8(a, zero);
+			auto ahi = _mm256_unpackhi_epi8(a, zero);
+			auto blo = _mm256_unpacklo_epi8(b, zero);
+			auto bhi = _mm256_unpackhi_epi8(b, zero);
+			s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_unpacklo_epi16(alo, blo), weights));
+			s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_unpackhi_epi16(alo, blo), weights));
+			s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(_mm256_unpacklo_epi16(ahi, bhi), weights));
+			s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(_mm256_unpackhi_epi16(ahi, bhi), weights));
+		}
+
+		auto lo = _mm256_packs_epi32(_mm256_srai_epi32(s0, WeightBits), _mm256_srai_epi32(s1, WeightBits));
+		auto hi = _mm256_packs_epi32(_mm256_srai_epi32(s2, WeightBits), _mm256_srai_epi32(s3, WeightBits));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(lo, hi));
+	}
+	return i + VerticalSse41(rows + i, stride, axis, y, dst + i, bytes - i);
+}
+#endif
+
+// Inner loops of one instruction set level; the horizontal ones gather pixels from all over the row, where AVX2
+// wouldn't do better than SSE4.1
+struct ResampleKernels
+{
+	const char* name = "scalar";
+	HorizontalFn horizontal[4] = { HorizontalNone, HorizontalNone, HorizontalNone, HorizontalNone }; // by channels - 1
+	VerticalFn vertical = VerticalNone;
+
+	ResampleKernels(bool sse41, bool avx2)
+	{
+#if defined(_M_X64) || defined(_M_IX86)
+		if (sse41)
+		{
+			name = "SSE4.1";
+			horizontal[0] = HorizontalYSse41;
+			horizontal[1] = HorizontalUVSse41;
+			horizontal[3] = HorizontalBgraSse41;
+			vertical = VerticalSse41;
+		}
+
+		if (sse41 && avx2)
+		{
+			name = "AVX2";
+			vertical = VerticalAvx2;
+		}
+#else
+		(void)sse41;
+		(void)avx2;
+#endif
+	}
+};
+
+// Levels this CPU runs, the best last
+static const std::vector<ResampleKernels>& KernelLevels()
+{
+	static const std::vector<ResampleKernels> levels = []()
+	{
+		std::vector<ResampleKernels> levels{ ResampleKernels(false, false) };
+		const auto& cpu = CpuFeatures::Get();
+		if (cpu.sse41)
+		{
+			levels.emplace_back(true, false);
+			if (cpu.avx2)
+			{
+				levels.emplace_back(true, true);
+			}
+		}
+		return levels;
+	}();
+	return levels;
+}
+
+const char* Resampler::Kernel()
+{
+	return KernelLevels().back().name;
+}
+
+std::vector<const char*> Resampler::Kernels()
+{
+	std::vector<const char*> names;
+	for (auto& level : KernelLevels())
+	{
+		names.push_back(level.name);
+	}
+	return names;
+}
+
+bool Resampler::SetKernel(const char* name)
+{
+	for (auto& level : KernelLevels())
+	{
+		if (!strcmp(level.name, name))
+		{
+			_kernels = &level;
+			return true;
+		}
+	}
+	return false;
+}
+
+HRESULT Resampler::ScalePlane(const BYTE* src, UINT srcWidth, UINT srcHeight, LONG srcStride, BYTE* dst, UINT dstWidth, UINT dstHeight, LONG dstStride, UINT channels)
+{
+	const UINT rowBytes = dstWidth * channels;
+	const auto& kernels = _kernels ? *_kernels : KernelLevels().back();
+	if (srcWidth == dstWidth && srcHeight == dstHeight)
+	{
+		for (UINT y = 0; y < dstHeight; y++)
+		{
+			memcpy(dst + (size_t)y * dstStride, src + (size_t)y * srcStride, rowBytes);
+		}
+		return S_OK;
+	}
+
+	// horizontal pass first, it makes the vertical one work on the narrower rows when shrinking; straight to the
+	// destination when the height doesn't change
+	const BYTE* rows = src;
+	size_t rowsStride = srcStride;
+	if (srcWidth != dstWidth)
+	{
+		auto horizontal = GetAxis(srcWidth, dstWidth, _filter);
+		BYTE* target = dst;
+		size_t targetStride = dstStride;
+		if (srcHeight != dstHeight)
+		{
+			RETURN_HR_IF(E_OUTOFMEMORY, !_intermediate.Resize((size_t)rowBytes * srcHeight));
+			target = _intermediate.Data();
+			targetStride = rowBytes;
+		}
+
+		SlicePool::Instance().Run(srcHeight, 1, [&](UINT first, UINT last)
+		{
+			for (UINT y = first; y < last; y++)
+			{
+				auto s = src + (size_t)y * srcStride;
+				auto d = target + y * targetStride;
+				UINT x = kernels.horizontal[channels - 1](s, d, dstWidth, *horizontal);
+				HorizontalScalar(s, d, x, dstWidth, channels, *horizontal);
+			}
+		});
+		rows = target;
+		rowsStride = targetStride;
+	}
+
+	if (srcHeight != dstHeight)
+	{
+		auto vertical = GetAxis(srcHeight, dstHeight, _filter);
+		SlicePool::Instance().Run(dstHeight, 1, [&](UINT first, UINT last)
+		{
+			for (UINT y = first; y < last; y++)
+			{
+				auto r = rows + vertical->starts[y] * rowsStride;
+				auto d = dst + (size_t)y * dstStride;
+				auto i = kernels.vertical(r, rowsStride, *vertical, y, d, rowBytes);
+				VerticalScalar(r, rowsStride, *vertical, y, d, i, rowBytes);
+			}
+		});
+	}
+	return S_OK;
+}
+
+HRESULT Resampler::ScaleBGRA(const BYTE* src, UINT srcWidth, UINT srcHeight, LONG srcStride, BYTE* dst, UINT dstWidth, UINT dstHeight, LONG dstStride)
+{
+	RETURN_HR_IF_NULL(E_INVALIDARG, src);
+	RETURN_HR_IF_NULL(E_INVALIDARG, dst);
+	RETURN_HR_IF(E_INVALIDARG, !srcWidth || !srcHeight || !dstWidth || !dstHeight);
+	RETURN_HR_IF(E_INVALIDARG, srcStride < 0 || (ULONGLONG)srcStride < (ULONGLONG)srcWidth * 4);
+	RETURN_HR_IF(E_INVALIDARG, dstStride < 0 || (ULONGLONG)dstStride < (ULONGLONG)dstWidth * 4);
+	return ScalePlane(src, srcWidth, srcHeight, srcStride, dst, dstWidth, dstHeight, dstStride, 4);
+}
+
+HRESULT Resampler::ScaleNV12(const BYTE* srcY, const BYTE* srcUV, UINT srcWidth, UINT srcHeight, LONG srcStride, BYTE* dstY, BYTE* dstUV, UINT dstWidth, UINT dstHeight, LONG dstStride)
+{
+	RETURN_HR_IF_NULL(E_INVALIDARG, srcY);
+	RETURN_HR_IF_NULL(E_INVALIDARG, srcUV);
+	RETURN_HR_IF_NULL(E_INVALIDARG, dstY);
+	RETURN_HR_IF_NULL(E_INVALIDARG, dstUV);
+	RETURN_HR_IF(E_INVALIDARG, !srcWidth || !srcHeight || !dstWidth || !dstHeight);
+	RETURN_HR_IF(E_INVALIDARG, srcStride < 0 || (ULONG)srcStride < ((srcWidth + 1) & ~1));
+	RETURN_HR_IF(E_INVALIDARG, dstStride < 0 || (ULONG)dstStride < ((dstWidth + 1) & ~1));
+
+	RETURN_IF_FAILED(ScalePlane(srcY, srcWidth, srcHeight, srcStride, dstY, dstWidth, dstHeight, dstStride, 1));
+	return ScalePlane(srcUV, (srcWidth + 1) / 2, (srcHeight + 1) / 2, srcStride, dstUV, (dstWidth + 1) / 2, (dstHeight + 1) / 2, dstStride, 2);
+}
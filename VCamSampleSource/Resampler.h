@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "FrameBufferPool.h"
+
+enum class ResampleFilter
+{
+	Bilinear = 0,
+	Bicubic = 1,   // Catmull-Rom
+	Lanczos3 = 2,
+};
+
+struct ResampleAxis;
+struct ResampleKernels;
+
+// Separable resampler for 8-bit BGRA and NV12 images: a horizontal pass into an intermediate image, then a
+// vertical pass. When shrinking, the filter is widened to cover every source pixel, so large ratios average
+// rather than skip pixels. Filter tables (14-bit fixed point weights per destination pixel) are computed once
+// per source size, destination size and filter, and shared by every resampler.
+// Inner loops use AVX2 or SSE4.1 when the CPU has them with the same integer arithmetic as the scalar code, and
+// both passes run in bands on the SlicePool, so the output doesn't depend on the CPU or the thread count.
+class Resampler
+{
+	ResampleFilter _filter = ResampleFilter::Bilinear;
+	const ResampleKernels* _kernels = nullptr; // the best ones
+	FrameBuffer _intermediate; // horizontally scaled rows
+
+	HRESULT ScalePlane(const BYTE* src, UINT srcWidth, UINT srcHeight, LONG srcStride, BYTE* dst, UINT dstWidth, UINT dstHeight, LONG dstStride, UINT channels);
+
+public:
+	ResampleFilter Filter() const { return _filter; }
+	void SetFilter(ResampleFilter filter) { _filter = filter; }
+
+	HRESULT ScaleBGRA(const BYTE* src, UINT srcWidth, UINT srcHeight, LONG srcStride, BYTE* dst, UINT dstWidth, UINT dstHeight, LONG dstStride);
+	// Each image is a Y plane and an interleaved UV plane at the same stride
+	HRESULT ScaleNV12(const BYTE* srcY, const BYTE* srcUV, UINT srcWidth, UINT srcHeight, LONG srcStride, BYTE* dstY, BYTE* dstUV, UINT dstWidth, UINT dstHeight, LONG dstStride);
+
+	// Name of the inner loops picked for this CPU
+	static const char* Kernel();
+	// Names of the inner loops this CPU can run, scalar first and Kernel() last. They all compute the same output,
+	// picking another one is for tests and benchmarks; false if name isn't one of them.
+	static std::vector<const char*> Kernels();
+	bool SetKernel(const char* name);
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+
+// When and which of the camera's JPEGs a picture is, carried from the transport thread to the sample
+struct FrameTiming
+{
+	MFTIME captured = 0;  // capture time, on MFGetSystemTime's clock
+	ULONGLONG index = 0;  // 1 for the first JPEG read from the camera, then 2 ...; 0 for no picture (placeholder)
+};
+
+// Maps the server's part timestamps (X-Timestamp) to this machine's clock. The offset between the clocks is the
+// smallest arrival delay seen: followed at once when it drops and slowly when it grows, so network jitter doesn't
+// reach the capture times but the clocks may drift apart. Without a server timestamp the arrival time is used.
+class CaptureClock
+{
+	LONGLONG _offset = 0;
+	bool _synced = false;
+
+public:
+	static constexpr LONGLONG MaxSkew = 10000000; // 1 s more at once isn't delay, the server clock jumped
+
+	// arrival: when the JPEG's last bytes came in; server: its timestamp in 100 ns units, 0 for none
+	MFTIME Captured(MFTIME arrival, LONGLONG server)
+	{
+		if (!server)
+			return arrival;
+
+		const auto offset = arrival - server;
+		if (!_synced || offset < _offset || offset - _offset > MaxSkew)
+		{
+			_offset = offset;
+			_synced = true;
+		}
+		else
+		{
+			_offset += (offset - _offset) / 64;
+		}
+		return server + _offset;
+	}
+
+	void Reset() { _synced = false; }
+};
+
+// Sample times: the capture time of the picture a sample carries. A picture sent again is stamped with the time of
+// the request less the last picture's latency, so repeats keep the pace of the requests (the frame rate) without
+// running into the next picture's capture time; placeholders with the time of the request. Always after the
+// previous sample. A sample following dropped camera frames, or repeating a picture, is a discontinuity.
+class SampleClock
+{
+	MFTIME _last = 0;
+	MFTIME _latency = 0;   // from capture to request, of the last new picture
+	ULONGLONG _index = 0;  // picture of the previous sample
+	bool _started = false;
+
+public:
+	struct Stamp
+	{
+		MFTIME time;
+		bool discontinuity;
+	};
+
+	Stamp Next(MFTIME now, const FrameTiming& frame)
+	{
+		Stamp stamp{ now, false };
+		if (frame.index && frame.index == _index)
+		{
+			stamp.time = now - _latency;
+			stamp.discontinuity = true;
+		}
+		else if (frame.index)
+		{
+			stamp.time = frame.captured;
+			stamp.discontinuity = _index && frame.index != _index + 1;
+			_latency = (std::max)(now - frame.captured, (MFTIME)0);
+		}
+
+		if (_started && stamp.time <= _last)
+		{
+			stamp.time = _last + 1;
+		}
+		_last = stamp.time;
+		_index = frame.index;
+		_started = true;
+		return stamp;
+	}
+
+	void Reset()
+	{
+		_latency = 0;
+		_index = 0;
+		_started = false;
+	}
+};
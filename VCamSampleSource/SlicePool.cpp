@@ -0,0 +1,150 @@
+#include "pch.h"
+#include "SlicePool.h"
+
+SlicePool& SlicePool::Instance()
+{
+	static SlicePool instance;
+	return instance;
+}
+
+UINT SlicePool::WorkerCount()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return (UINT)_workers.size();
+}
+
+SlicePool::Stats SlicePool::GetStats()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return _stats;
+}
+
+void SlicePool::Acquire()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	if (_users++ || !_workers.empty())
+		return;
+
+	// the thread calling Run is one of the threads working on its job
+	auto count = _workerCount ? _workerCount : std::max<UINT>(1, std::thread::hardware_concurrency()) - 1;
+	auto generation = _generation;
+	for (UINT i = 0; i < count; i++)
+	{
+		_workers.emplace_back([this, generation]() { Worker(generation); });
+	}
+	WINTRACE(L"SlicePool: started %u workers", count);
+}
+
+void SlicePool::SetWorkerCount(UINT count)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	_workerCount = count;
+}
+
+void SlicePool::Release()
+{
+	std::vector<std::thread> workers;
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		if (!_users || --_users)
+			return;
+
+		// an Acquire racing with the join below starts a fresh set of workers; jobs still running finish on
+		// their calling threads
+		_generation++;
+		workers = std::move(_workers);
+	}
+
+	if (!workers.empty())
+	{
+		_work.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+		WINTRACE(L"SlicePool: workers stopped");
+	}
+}
+
+void SlicePool::Run(UINT rows, UINT alignment, const std::function<void(UINT first, UINT last)>& body)
+{
+	if (!rows)
+		return;
+
+	alignment = std::max<UINT>(1, alignment);
+	std::unique_lock<std::mutex> lock(_lock);
+	const auto threads = (UINT)_workers.size() + 1;
+
+	// a few bands per thread, so threads that join late still find work
+	auto bandRows = std::max(MinBandRows, (rows + threads * 4 - 1) / (threads * 4));
+	bandRows = (bandRows + alignment - 1) / alignment * alignment;
+	const auto bands = (rows + bandRows - 1) / bandRows;
+	_stats.jobs++;
+	if (threads == 1 || bands < 2)
+	{
+		_stats.bands++;
+		lock.unlock();
+		body(0, rows);
+		return;
+	}
+
+	Job job;
+	job.body = &body;
+	job.rows = rows;
+	job.bandRows = bandRows;
+	job.bands = bands;
+	_jobs.push_back(&job);
+	_work.notify_all();
+
+	while (RunBand(&job, lock, false))
+	{
+	}
+	_done.wait(lock, [&job]() { return job.completed == job.bands; });
+}
+
+bool SlicePool::RunBand(Job* job, std::unique_lock<std::mutex>& lock, bool stolen)
+{
+	if (job->next >= job->bands)
+		return false;
+
+	const auto band = job->next++;
+	if (job->next == job->bands)
+	{
+		_jobs.remove(job);
+	}
+	_stats.bands++;
+	if (stolen)
+	{
+		_stats.stolenBands++;
+	}
+
+	const auto first = band * job->bandRows;
+	const auto last = std::min(job->rows, first + job->bandRows);
+	auto body = job->body;
+	lock.unlock();
+	(*body)(first, last);
+	lock.lock();
+
+	// the job lives on its caller's stack, it must not be touched once its last band is reported
+	if (++job->completed == job->bands)
+	{
+		_done.notify_all();
+	}
+	return true;
+}
+
+void SlicePool::Worker(UINT generation)
+{
+	std::unique_lock<std::mutex> lock(_lock);
+	while (true)
+	{
+		_work.wait(lock, [this, generation]() { return _generation != generation || !_jobs.empty(); });
+		if (_generation != generation)
+			break;
+
+		// rotate the jobs so concurrent cameras progress evenly
+		auto job = _jobs.front();
+		_jobs.splice(_jobs.end(), _jobs, _jobs.begin());
+		RunBand(job, lock, true);
+	}
+}
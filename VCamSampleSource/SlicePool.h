@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Process-wide pool splitting per-frame pixel work (conversion, scaling) into horizontal bands.
+// The thread calling Run works on its own bands too, and pool workers take bands from whichever running job
+// still has some, so several cameras converting at once share the cores and a camera whose bands are slow
+// (or whose workers are busy elsewhere) still finishes on its own thread. Bands only split the rows, each
+// band computes exactly what the single-threaded loop would, so the output is identical.
+// Workers start with the first user and are joined when the last one releases the pool; without users Run
+// just calls body on the calling thread.
+class SlicePool
+{
+public:
+	static constexpr UINT MinBandRows = 32;  // below that, handing a band over costs more than running it
+
+	struct Stats
+	{
+		ULONGLONG jobs;
+		ULONGLONG bands;
+		ULONGLONG stolenBands;  // bands run by pool workers rather than the calling thread
+	};
+
+	static SlicePool& Instance();
+
+	void Acquire();
+	void Release();
+	// Number of workers the next first Acquire starts, 0 (the default) for one per core but the calling thread's.
+	// For benchmarks and tests; workers already running are kept until the last user releases the pool.
+	void SetWorkerCount(UINT count);
+
+	// Calls body(first, last) over [0, rows) in bands starting on multiples of alignment, returns when all are done
+	void Run(UINT rows, UINT alignment, const std::function<void(UINT first, UINT last)>& body);
+	Stats GetStats();
+	UINT WorkerCount();
+
+private:
+	struct Job
+	{
+		const std::function<void(UINT, UINT)>* body = nullptr;
+		UINT rows = 0;
+		UINT bandRows = 0;
+		UINT bands = 0;
+		UINT next = 0;      // next band to hand out
+		UINT completed = 0;
+	};
+
+	std::mutex _lock;
+	std::condition_variable _work;  // _jobs has an entry or _generation changed
+	std::condition_variable _done;  // a band completed
+	std::list<Job*> _jobs;          // jobs with bands left to hand out
+	std::vector<std::thread> _workers;
+	UINT _users = 0;
+	UINT _workerCount = 0;          // 0 for one per core but the calling thread's
+	UINT _generation = 0;           // bumped when the last user leaves, tells the current workers to exit
+	Stats _stats{};
+
+	// Hands out the next band of a job and runs it; false if the job had none left. Called and returns with _lock held.
+	bool RunBand(Job* job, std::unique_lock<std::mutex>& lock, bool stolen);
+	void Worker(UINT generation);
+};
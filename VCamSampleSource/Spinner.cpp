@@ -0,0 +1,158 @@
+#include "pch.h"
+#include "Spinner.h"
+#include <cmath>
+
+static const size_t MaxBackgrounds = 16; // more than the samples in flight
+
+// Draws the ticks of a phase in a BGRA image, centered on cx, cy
+static void DrawTicks(BYTE* pixels, UINT width, UINT height, float cx, float cy, float radius, int stroke, UINT phase)
+{
+	auto putPixel = [&](int x, int y, BYTE r, BYTE g, BYTE b, BYTE a)
+	{
+		if (x < 0 || y < 0 || x >= (int)width || y >= (int)height) return;
+		size_t idx = (size_t)y * ((size_t)width * 4) + (size_t)x * 4;
+		pixels[idx + 0] = b;
+		pixels[idx + 1] = g;
+		pixels[idx + 2] = r;
+		pixels[idx + 3] = a;
+	};
+
+	auto drawLineThick = [&](float x0, float y0, float x1, float y1, int thickness, BYTE r, BYTE g, BYTE b, BYTE a)
+	{
+		// Simple DDA with normal offsets for thickness
+		float dx = x1 - x0, dy = y1 - y0;
+		float steps = fabsf(dx) > fabsf(dy) ? fabsf(dx) : fabsf(dy);
+		if (steps < 1.0f) steps = 1.0f;
+		float sx = dx / steps, sy = dy / steps;
+		for (int i = 0; i <= (int)steps; ++i)
+		{
+			float x = x0 + sx * i;
+			float y = y0 + sy * i;
+			// normal vector
+			float nx = -sy, ny = sx;
+			float nl = sqrtf(nx * nx + ny * ny);
+			if (nl > 0.0f) { nx /= nl; ny /= nl; }
+			for (int t = -thickness; t <= thickness; ++t)
+			{
+				int px = (int)lroundf(x + nx * t);
+				int py = (int)lroundf(y + ny * t);
+				putPixel(px, py, r, g, b, a);
+			}
+		}
+	};
+
+	const float tickLen = radius * 0.35f;
+	const float r0 = radius - tickLen;
+	const float r1 = radius;
+	const int N = (int)Spinner::Phases;
+	const float twoPi = 6.28318530718f;
+	const float base = (twoPi * phase) / N;
+	for (int i = 0; i < N; ++i)
+	{
+		float a = base + (twoPi * i) / N;
+		float fade = powf(0.75f, (float)((N - 1) - i));
+		BYTE v = (BYTE)std::clamp<int>((int)(fade * 255.0f), 40, 255);
+		float x0 = cx + r0 * cosf(a);
+		float y0 = cy + r0 * sinf(a);
+		float x1 = cx + r1 * cosf(a);
+		float y1 = cy + r1 * sinf(a);
+		drawLineThick(x0, y0, x1, y1, stroke, v, v, v, 255);
+	}
+}
+
+HRESULT Spinner::Prepare(UINT width, UINT height, const PixelFormat& format)
+{
+	RETURN_HR_IF(E_INVALIDARG, !width || !height);
+	if (width == _width && height == _height && &format == _format && !_phases.Empty())
+		return S_OK;
+
+	_width = width;
+	_height = height;
+	_format = &format;
+	_backgrounds.clear();
+	auto hr = Render();
+	if (FAILED(hr))
+	{
+		_phases.Reset();
+	}
+	return hr;
+}
+
+HRESULT Spinner::Render()
+{
+	const float radius = (float)((std::min)(_width, _height) * 0.25f);
+	const int stroke = (int)std::max<UINT>(2u, (std::min)(_width, _height) / 120);
+
+	// ticks reach the radius plus the stroke, and a pixel of rounding
+	const LONG half = (LONG)ceilf(radius) + stroke + 2;
+	const LONG cx = (LONG)(_width / 2);
+	const LONG cy = (LONG)(_height / 2);
+	_dirty.left = std::max<LONG>(0, cx - half) & ~1;
+	_dirty.top = std::max<LONG>(0, cy - half) & ~1;
+	_dirty.right = std::min<LONG>((LONG)_width, (cx + half + 2) & ~1);
+	_dirty.bottom = std::min<LONG>((LONG)_height, (cy + half + 2) & ~1);
+	const UINT w = _dirty.right - _dirty.left;
+	const UINT h = _dirty.bottom - _dirty.top;
+
+	const size_t bgraSize = (size_t)w * 4 * h;
+	_phasePitch = (LONG)_format->DefaultStride(w);
+	_phaseSize = (size_t)_format->ImageSize(h, _phasePitch);
+	RETURN_HR_IF(E_OUTOFMEMORY, !_phases.Resize(_phaseSize * Phases));
+	auto bgra = FrameBufferPool::Instance().Get(bgraSize);
+	RETURN_HR_IF(E_OUTOFMEMORY, bgra.Empty());
+
+	for (UINT phase = 0; phase < Phases; phase++)
+	{
+		memset(bgra.Data(), 0, bgraSize);
+		DrawTicks(bgra.Data(), w, h, _width * 0.5f - _dirty.left, _height * 0.5f - _dirty.top, radius, stroke, phase);
+
+		auto image = _phases.Data() + _phaseSize * phase;
+		RETURN_IF_FAILED(_format->fromRGB32(bgra.Data(), (ULONG)bgraSize, (LONG)(w * 4), w, h, image, (ULONG)_phaseSize, _phasePitch, YuvMatrix::BT601, YuvRange::Limited));
+	}
+
+	WINTRACE(L"Spinner: rendered %u phases %ux%u %s, dirty %ux%u", Phases, _width, _height, _format->name, w, h);
+	return S_OK;
+}
+
+HRESULT Spinner::Write(MFTIME time, BYTE* scanline, LONG pitch, DWORD length)
+{
+	RETURN_HR_IF(E_UNEXPECTED, _phases.Empty());
+	RETURN_HR_IF_NULL(E_POINTER, scanline);
+	RETURN_HR_IF(E_INVALIDARG, pitch < (LONG)_format->DefaultStride(_width) || length < _format->ImageSize(_height, pitch));
+
+	// black background, unless this buffer already has it
+	auto buffer = std::make_pair(scanline, pitch);
+	if (std::find(_backgrounds.begin(), _backgrounds.end(), buffer) == _backgrounds.end())
+	{
+		_format->Fill(scanline, pitch, _height);
+		if (_backgrounds.size() >= MaxBackgrounds)
+		{
+			_backgrounds.clear();
+		}
+		_backgrounds.push_back(buffer);
+	}
+
+	const UINT phase = (UINT)((time / 10000) % PeriodMs) * Phases / PeriodMs;
+	const BYTE* image = _phases.Data() + _phaseSize * phase;
+	const UINT w = _dirty.right - _dirty.left;
+	const UINT h = _dirty.bottom - _dirty.top;
+
+	// the dirty rectangle's edges are even, they fall on whole samples of every plane
+	BYTE* plane = scanline;
+	for (UINT i = 0; i < _format->planeCount; i++)
+	{
+		auto& layout = _format->planes[i];
+		const LONG from = layout.Pitch(_phasePitch);
+		const LONG to = layout.Pitch(pitch);
+		const UINT rows = layout.Rows(h);
+		const UINT rowBytes = layout.RowBytes(w);
+		auto destination = plane + (size_t)(_dirty.top >> layout.yShift) * to + layout.RowBytes(_dirty.left);
+		for (UINT y = 0; y < rows; y++)
+		{
+			memcpy(destination + (size_t)y * to, image + (size_t)y * from, rowBytes);
+		}
+		image += (size_t)from * rows;
+		plane += (size_t)to * layout.Rows(_height);
+	}
+	return S_OK;
+}
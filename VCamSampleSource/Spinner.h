@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include "FrameBufferPool.h"
+#include "PixelFormats.h"
+
+// "Waiting for the camera" placeholder for the CPU path: 12 fading ticks turning once every 1.2 s, one phase per
+// tick position. The ticks stay inside a square around the center (the dirty rectangle) and everything else is
+// black, so each phase is rasterized and converted to the output format once per size, as that square only.
+// Output buffers already holding the black background only get the square copied in.
+// Buffers are known by their (scanline, pitch) only, so that holds as long as nothing but the spinner writes to the
+// buffers it has seen: the owner must call Reset before anything else does, or when the buffers may be new memory at
+// the same addresses. FrameGenerator resets on stream start (new allocator) and on the first camera frame.
+class Spinner
+{
+	UINT _width = 0;
+	UINT _height = 0;
+	const PixelFormat* _format = nullptr;
+	RECT _dirty{};        // where the ticks are, edges on even pixels
+	size_t _phaseSize = 0;
+	LONG _phasePitch = 0;
+	FrameBuffer _phases;  // Phases images of the dirty rectangle in the output format, one after the other
+	std::vector<std::pair<BYTE*, LONG>> _backgrounds; // output buffers (scanline, pitch) holding the background, see Reset
+
+	HRESULT Render();
+
+public:
+	static constexpr UINT Phases = 12;
+	static constexpr UINT PeriodMs = 1200;
+
+	// Renders the phases for a size and output format unless they're ready
+	HRESULT Prepare(UINT width, UINT height, const PixelFormat& format);
+	// Writes the phase for time (100 ns units) into an output image
+	HRESULT Write(MFTIME time, BYTE* scanline, LONG pitch, DWORD length);
+	// Frees the phases and forgets the output buffers; required before the buffers get something else than the
+	// spinner, since a buffer it has seen is assumed to still hold the background
+	void Reset()
+	{
+		_phases.Reset();
+		_backgrounds.clear();
+	}
+};
@@ -0,0 +1,125 @@
+#include "pch.h"
+#include "TurboJpegDecoder.h"
+#include "MjpegSplitter.h"
+
+#if defined(WINCAMHTTP_TURBOJPEG)
+#include <memory>
+#include <vector>
+#include <turbojpeg.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "turbojpeg")
+#endif
+
+void* TurboJpegDecoder::Handle()
+{
+	struct HandleDeleter
+	{
+		void operator()(void* handle) const { tjDestroy(handle); }
+	};
+
+	static thread_local std::unique_ptr<void, HandleDeleter> handle;
+	if (!handle)
+	{
+		handle.reset(tjInitDecompress());
+	}
+	return handle.get();
+}
+
+HRESULT TurboJpegDecoder::DecodeFrame(const BYTE* jpeg, size_t size, UINT targetWidth, UINT targetHeight, FrameBuffer& bgra, UINT* width, UINT* height, UINT* stride)
+{
+	if (MjpegSplitter::HasExif(jpeg, size))
+		return S_FALSE;
+
+	auto handle = Handle();
+	RETURN_HR_IF_NULL(E_OUTOFMEMORY, handle);
+
+	int w = 0, h = 0, subsampling = 0, colorspace = 0;
+	if (tjDecompressHeader3(handle, jpeg, (unsigned long)size, &w, &h, &subsampling, &colorspace))
+	{
+		WINTRACE(L"TurboJPEG: header failed: %S", tjGetErrorStr2(handle));
+		return WINCODEC_ERR_BADHEADER;
+	}
+
+	// smallest of the 1/2, 1/4, 1/8 scales still covering the target; tjDecompress2 picks the scale from the
+	// requested size
+	if (targetWidth && targetHeight)
+	{
+		for (int denom = 8; denom > 1; denom /= 2)
+		{
+			tjscalingfactor factor{ 1, denom };
+			if ((UINT)TJSCALED(w, factor) >= targetWidth && (UINT)TJSCALED(h, factor) >= targetHeight)
+			{
+				w = TJSCALED(w, factor);
+				h = TJSCALED(h, factor);
+				break;
+			}
+		}
+	}
+
+	RETURN_HR_IF(E_OUTOFMEMORY, !bgra.Resize((size_t)w * 4 * h));
+	if (tjDecompress2(handle, jpeg, (unsigned long)size, bgra.Data(), w, w * 4, h, TJPF_BGRA, TJFLAG_FASTDCT) &&
+		tjGetErrorCode(handle) != TJERR_WARNING) // warnings are for recoverable corruption, the picture is usable
+	{
+		WINTRACE(L"TurboJPEG: decompress failed: %S", tjGetErrorStr2(handle));
+		return WINCODEC_ERR_BADIMAGE;
+	}
+
+	*width = w;
+	*height = h;
+	*stride = w * 4;
+	return S_OK;
+}
+
+HRESULT TurboJpegDecoder::DecodeFrameNV12(const BYTE* jpeg, size_t size, UINT width, UINT height, FrameBuffer& nv12)
+{
+	if (MjpegSplitter::HasExif(jpeg, size))
+		return S_FALSE;
+
+	auto handle = Handle();
+	RETURN_HR_IF_NULL(E_OUTOFMEMORY, handle);
+
+	int w = 0, h = 0, subsampling = 0, colorspace = 0;
+	if (tjDecompressHeader3(handle, jpeg, (unsigned long)size, &w, &h, &subsampling, &colorspace))
+		return WINCODEC_ERR_BADHEADER;
+
+	if (subsampling != TJSAMP_420 || colorspace != TJCS_YCbCr)
+		return S_FALSE;
+
+	bool scaled = false;
+	for (int denom = 1; denom <= 8; denom *= 2)
+	{
+		tjscalingfactor factor{ 1, denom };
+		if ((UINT)TJSCALED(w, factor) == width && (UINT)TJSCALED(h, factor) == height)
+		{
+			scaled = true;
+			break;
+		}
+	}
+	if (!scaled)
+		return S_FALSE;
+
+	// turbo writes planar Cb and Cr, interleave them afterwards
+	static thread_local std::vector<BYTE> chroma;
+	const UINT cw = width / 2, ch = height / 2;
+	chroma.resize((size_t)cw * ch * 2);
+	RETURN_HR_IF(E_OUTOFMEMORY, !nv12.Resize((size_t)width * height * 3 / 2));
+	unsigned char* planes[3] = { nv12.Data(), chroma.data(), chroma.data() + (size_t)cw * ch };
+	int strides[3] = { (int)width, (int)cw, (int)cw };
+	if (tjDecompressToYUVPlanes(handle, jpeg, (unsigned long)size, planes, (int)width, strides, (int)height, TJFLAG_FASTDCT) &&
+		tjGetErrorCode(handle) != TJERR_WARNING)
+	{
+		WINTRACE(L"TurboJPEG: YUV decompress failed: %S", tjGetErrorStr2(handle));
+		return WINCODEC_ERR_BADIMAGE;
+	}
+
+	auto uv = nv12.Data() + (size_t)width * height;
+	const BYTE* cb = planes[1];
+	const BYTE* cr = planes[2];
+	for (size_t i = 0; i < (size_t)cw * ch; i++)
+	{
+		uv[i * 2] = cb[i];
+		uv[i * 2 + 1] = cr[i];
+	}
+	return S_OK;
+}
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "JpegDecoder.h"
+
+// JpegDecoder on libjpeg-turbo's TurboJPEG API, built with WINCAMHTTP_TURBOJPEG defined; it has no Windows
+// dependency, so the tests benchmark it on Linux too. Turbo doesn't apply EXIF orientation: those JPEGs (rare in
+// camera streams) are left to the fallback, which counts them.
+class TurboJpegDecoder : public JpegDecoder
+{
+	// a TurboJPEG handle, which can't be shared between threads
+	static void* Handle();
+
+protected:
+	HRESULT DecodeFrame(const BYTE* jpeg, size_t size, UINT targetWidth, UINT targetHeight, FrameBuffer& bgra, UINT* width, UINT* height, UINT* stride) override;
+	HRESULT DecodeFrameNV12(const BYTE* jpeg, size_t size, UINT width, UINT height, FrameBuffer& nv12) override;
+
+public:
+	explicit TurboJpegDecoder(JpegDecoder* fallback) : JpegDecoder(fallback) {}
+	const wchar_t* Name() const override { return L"TurboJPEG"; }
+};
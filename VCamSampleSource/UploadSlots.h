@@ -0,0 +1,59 @@
+#pragma once
+
+// Bookkeeping for the GPU path's upload bitmaps: decoded frames go into two bitmaps in turn, so an upload never
+// targets the bitmap the GPU may still be drawing the previous sample from. A bitmap is created when the frame size
+// changes and updated in place otherwise, and a frame that's already uploaded is drawn again as is.
+// Only tracks sizes and frame sequences, the bitmaps themselves belong to the caller.
+class UploadSlots
+{
+public:
+	static constexpr UINT Count = 2;
+
+	struct Plan
+	{
+		UINT slot;
+		bool create; // (re)create the slot's bitmap at the frame's size
+		bool upload; // copy the frame into it
+	};
+
+	// Where to draw a frame from, and what to do to the slot before
+	Plan Next(UINT width, UINT height, ULONGLONG sequence)
+	{
+		auto& current = _slots[_current];
+		if (current.sequence == sequence && current.width == width && current.height == height)
+			return { _current, false, false };
+
+		const UINT slot = (_current + 1) % Count;
+		auto& next = _slots[slot];
+		Plan plan{ slot, next.width != width || next.height != height, true };
+		next.width = width;
+		next.height = height;
+		next.sequence = sequence;
+		_current = slot;
+		return plan;
+	}
+
+	// Creating or uploading the slot failed, it holds nothing
+	void Invalidate(UINT slot) { _slots[slot] = Slot(); }
+
+	// The bitmaps are gone (new render target)
+	void Reset()
+	{
+		for (auto& slot : _slots)
+		{
+			slot = Slot();
+		}
+		_current = 0;
+	}
+
+private:
+	struct Slot
+	{
+		UINT width = 0;
+		UINT height = 0;
+		ULONGLONG sequence = 0; // frame in the bitmap, 0 for none
+	};
+
+	Slot _slots[Count];
+	UINT _current = 0; // slot last drawn from
+};
@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "VideoModes.h"
+
+static const UINT MaxDimension = 8192;
+static const UINT MaxRate = 240;
+static const UINT LadderHeights[] = { 2160, 1440, 1080, 720, 540, 360 };
+static const UINT DefaultRates[] = { 30, 60, 24, 15 };
+
+// the 4:2:0 formats need even sizes
+static bool IsValid(ULONGLONG width, ULONGLONG height)
+{
+	return width && height && width <= MaxDimension && height <= MaxDimension && !(width & 1) && !(height & 1);
+}
+
+static bool Contains(const std::vector<VideoModes::Size>& sizes, UINT width, UINT height)
+{
+	return std::any_of(sizes.begin(), sizes.end(), [&](const VideoModes::Size& size)
+	{
+		return size.width == width && size.height == height;
+	});
+}
+
+VideoModes VideoModes::Default(UINT width, UINT height)
+{
+	VideoModes modes;
+	// an odd configured size loses its last row or column
+	width &= ~1;
+	height &= ~1;
+	if (!IsValid(width, height))
+	{
+		WINTRACE(L"VideoModes: no valid configured size, using 1920x1080");
+		width = 1920;
+		height = 1080;
+	}
+	modes.sizes.push_back({ width, height });
+	for (auto h : LadderHeights)
+	{
+		if (h >= height)
+			continue;
+
+		// same aspect ratio, even width
+		auto w = (UINT)(((ULONGLONG)h * width + height) / (height * 2) * 2);
+		if (w && !Contains(modes.sizes, w, h))
+		{
+			modes.sizes.push_back({ w, h });
+		}
+	}
+	modes.rates.assign(std::begin(DefaultRates), std::end(DefaultRates));
+	return modes;
+}
+
+std::vector<VideoModes::Size> VideoModes::ParseSizes(const wchar_t* text)
+{
+	std::vector<Size> sizes;
+	if (!text)
+		return sizes;
+
+	auto p = text;
+	while (*p)
+	{
+		wchar_t* end;
+		auto width = wcstoul(p, &end, 10);
+		unsigned long height = 0; // as wcstoul returns it: values out of range stay out of range
+		if (end != p && (*end == L'x' || *end == L'X'))
+		{
+			p = end + 1;
+			height = wcstoul(p, &end, 10);
+		}
+
+		if (IsValid(width, height) && !Contains(sizes, (UINT)width, (UINT)height))
+		{
+			sizes.push_back({ (UINT)width, (UINT)height });
+		}
+		else
+		{
+			WINTRACE(L"VideoModes: skipping size in '%s'", text);
+		}
+
+		// next entry
+		p = end;
+		while (*p && *p != L',')
+		{
+			p++;
+		}
+		if (*p)
+		{
+			p++;
+		}
+	}
+	return sizes;
+}
+
+std::vector<UINT> VideoModes::ParseRates(const wchar_t* text)
+{
+	std::vector<UINT> rates;
+	if (!text)
+		return rates;
+
+	auto p = text;
+	while (*p)
+	{
+		wchar_t* end;
+		auto rate = wcstoul(p, &end, 10);
+		if (rate && rate <= MaxRate && std::find(rates.begin(), rates.end(), rate) == rates.end())
+		{
+			rates.push_back(rate);
+		}
+		else
+		{
+			WINTRACE(L"VideoModes: skipping frame rate in '%s'", text);
+		}
+
+		p = end;
+		while (*p && *p != L',')
+		{
+			p++;
+		}
+		if (*p)
+		{
+			p++;
+		}
+	}
+	return rates;
+}
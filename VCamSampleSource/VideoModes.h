@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+// Frame sizes and rates a stream advertises: every size at every rate, in each of the PixelFormats, plus MJPG at the
+// first size. The first size and rate make the default type. Clients pick the mode they want and the source scales
+// to it once, rather than every client scaling down a 1080p30 stream itself.
+struct VideoModes
+{
+	struct Size
+	{
+		UINT width;
+		UINT height;
+	};
+
+	std::vector<Size> sizes;
+	std::vector<UINT> rates; // frames per second
+
+	// The configured size, rounded down to even (1920x1080 if that's empty or over 8192), then the usual smaller
+	// heights (2160 down to 360) at its aspect ratio, even widths; 30, 60, 24 and 15 fps
+	static VideoModes Default(UINT width, UINT height);
+
+	// "1920x1080,1280x720": even sizes up to 8192x8192, in that order, others skipped
+	static std::vector<Size> ParseSizes(const wchar_t* text);
+	// "30,15": rates from 1 to 240, in that order, others skipped
+	static std::vector<UINT> ParseRates(const wchar_t* text);
+};
@@ -0,0 +1,225 @@
+#include "pch.h"
+#include "WicDecodeContext.h"
+#include "MjpegSplitter.h"
+
+std::atomic<ULONGLONG> WicDecodeContext::_contexts{ 0 };
+std::atomic<ULONGLONG> WicDecodeContext::_frames{ 0 };
+std::atomic<ULONGLONG> WicDecodeContext::_objects{ 0 };
+std::atomic<ULONGLONG> WicDecodeContext::_scaledFrames{ 0 };
+std::atomic<ULONGLONG> WicDecodeContext::_planarFrames{ 0 };
+
+static thread_local std::unique_ptr<WicDecodeContext> _threadContext;
+
+HRESULT WicDecodeContext::ForCurrentThread(WicDecodeContext** context)
+{
+	RETURN_HR_IF_NULL(E_POINTER, context);
+	*context = nullptr;
+	if (!_threadContext)
+	{
+		auto created = std::make_unique<WicDecodeContext>();
+		RETURN_IF_FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_ALL, IID_PPV_ARGS(&created->_factory)));
+		_threadContext = std::move(created);
+		_contexts++;
+		WINTRACE(L"WicDecodeContext: created for thread %u", GetCurrentThreadId());
+	}
+
+	*context = _threadContext.get();
+	return S_OK;
+}
+
+void WicDecodeContext::ReleaseForCurrentThread()
+{
+	_threadContext.reset();
+}
+
+HRESULT WicDecodeContext::ReadOrientation(IWICBitmapFrameDecode* frame, UINT16* orientation)
+{
+	*orientation = 1; // default top-left
+	wil::com_ptr_nothrow<IWICMetadataQueryReader> meta;
+	RETURN_IF_FAILED(frame->GetMetadataQueryReader(&meta));
+	_objects++;
+
+	// EXIF orientation is property 274
+	PROPVARIANT v{}; PropVariantInit(&v);
+	if (SUCCEEDED(meta->GetMetadataByName(L"/app1/ifd/exif/{ushort=274}", &v)) && v.vt == VT_UI2)
+	{
+		*orientation = v.uiVal;
+	}
+	PropVariantClear(&v);
+	return S_OK;
+}
+
+HRESULT WicDecodeContext::OpenFrame(const BYTE* jpeg, size_t size, IWICBitmapFrameDecode** result, WICBitmapTransformOptions* orientation)
+{
+	RETURN_HR_IF_NULL(E_POINTER, result);
+	RETURN_HR_IF_NULL(E_POINTER, orientation);
+	*result = nullptr;
+	RETURN_HR_IF(E_INVALIDARG, !jpeg || size < 4 || size > MAXDWORD);
+	_frames++;
+
+	wil::com_ptr_nothrow<IWICStream> stream;
+	RETURN_IF_FAILED(_factory->CreateStream(&stream));
+	RETURN_IF_FAILED(stream->InitializeFromMemory(const_cast<BYTE*>(jpeg), static_cast<DWORD>(size)));
+	_objects++;
+
+	wil::com_ptr_nothrow<IWICBitmapDecoder> decoder;
+	RETURN_IF_FAILED(_factory->CreateDecoder(GUID_ContainerFormatJpeg, nullptr, &decoder));
+	RETURN_IF_FAILED(decoder->Initialize(stream.get(), WICDecodeMetadataCacheOnDemand));
+	_objects++;
+
+	wil::com_ptr_nothrow<IWICBitmapFrameDecode> frame;
+	RETURN_IF_FAILED(decoder->GetFrame(0, &frame));
+	_objects++;
+
+	UINT16 exif = 1;
+	if (MjpegSplitter::HasExif(jpeg, size))
+	{
+		(void)ReadOrientation(frame.get(), &exif);
+	}
+
+	switch (exif)
+	{
+	case 3: *orientation = WICBitmapTransformRotate180; break;
+	case 6: *orientation = WICBitmapTransformRotate90; break;   // 90 CW
+	case 8: *orientation = WICBitmapTransformRotate270; break;  // 270 CW
+	default: *orientation = WICBitmapTransformRotate0; break;
+	}
+
+	*result = frame.detach();
+	return S_OK;
+}
+
+HRESULT WicDecodeContext::Convert(IWICBitmapFrameDecode* frame, WICBitmapTransformOptions orientation, IWICBitmapSource** source)
+{
+	RETURN_HR_IF_NULL(E_POINTER, frame);
+	RETURN_HR_IF_NULL(E_POINTER, source);
+	*source = nullptr;
+
+	wil::com_ptr_nothrow<IWICBitmapSource> src = frame;
+	auto xform = orientation;
+	if (xform != WICBitmapTransformRotate0)
+	{
+		wil::com_ptr_nothrow<IWICBitmapFlipRotator> rot;
+		RETURN_IF_FAILED(_factory->CreateBitmapFlipRotator(&rot));
+		RETURN_IF_FAILED(rot->Initialize(src.get(), xform));
+		_objects++;
+		src = rot.get();
+	}
+
+	wil::com_ptr_nothrow<IWICFormatConverter> converter;
+	RETURN_IF_FAILED(_factory->CreateFormatConverter(&converter));
+	HRESULT convhr = converter->Initialize(src.get(), GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, nullptr, 0.0f, WICBitmapPaletteTypeCustom);
+	if (FAILED(convhr)) { WINTRACE(L"MJPEG: WIC format converter Initialize failed 0x%08X", convhr); return convhr; }
+	_objects++;
+
+	*source = converter.detach();
+	return S_OK;
+}
+
+HRESULT WicDecodeContext::DecodeScaled(IWICBitmapFrameDecode* frame, UINT targetWidth, UINT targetHeight, FrameBuffer& bgra, UINT* width, UINT* height, UINT* stride)
+{
+	RETURN_HR_IF_NULL(E_POINTER, frame);
+
+	// the JPEG decoder can run its IDCT at 1/2, 1/4 or 1/8 of the size, for a fraction of the work
+	wil::com_ptr_nothrow<IWICBitmapSourceTransform> transform;
+	if (FAILED(frame->QueryInterface(IID_PPV_ARGS(&transform))))
+		return S_FALSE;
+
+	UINT w = 0, h = 0;
+	RETURN_IF_FAILED(frame->GetSize(&w, &h));
+
+	// smallest scale still covering the target, the final resize only ever shrinks
+	UINT scale = 1;
+	for (UINT s = 8; s > 1; s /= 2)
+	{
+		if ((w + s - 1) / s >= targetWidth && (h + s - 1) / s >= targetHeight)
+		{
+			scale = s;
+			break;
+		}
+	}
+	if (scale == 1)
+		return S_FALSE;
+
+	UINT sw = (w + scale - 1) / scale;
+	UINT sh = (h + scale - 1) / scale;
+	RETURN_IF_FAILED(transform->GetClosestSize(&sw, &sh));
+	if (sw >= w || sh >= h)
+		return S_FALSE;
+
+	WICPixelFormatGUID format = GUID_WICPixelFormat32bppBGRA;
+	RETURN_IF_FAILED(transform->GetClosestPixelFormat(&format));
+	UINT bpp;
+	if (format == GUID_WICPixelFormat32bppBGRA || format == GUID_WICPixelFormat32bppPBGRA || format == GUID_WICPixelFormat32bppBGR)
+	{
+		bpp = 4;
+	}
+	else if (format == GUID_WICPixelFormat24bppBGR)
+	{
+		bpp = 3;
+	}
+	else if (format == GUID_WICPixelFormat8bppGray)
+	{
+		bpp = 1;
+	}
+	else
+		return S_FALSE; // CMYK and friends, leave them to the format converter
+
+	// rows are laid out at the final 32bpp stride and expanded in place, back to front
+	const UINT outStride = sw * 4;
+	RETURN_HR_IF(E_OUTOFMEMORY, !bgra.Resize((size_t)outStride * sh));
+	RETURN_IF_FAILED(transform->CopyPixels(nullptr, sw, sh, &format, WICBitmapTransformRotate0, outStride, (UINT)bgra.Size(), bgra.Data()));
+	if (bpp != 4 || format == GUID_WICPixelFormat32bppBGR)
+	{
+		for (UINT y = 0; y < sh; y++)
+		{
+			auto row = bgra.Data() + (size_t)y * outStride;
+			for (UINT x = sw; x-- > 0;)
+			{
+				auto src = row + (size_t)x * bpp;
+				auto dst = row + (size_t)x * 4;
+				BYTE b = src[0];
+				BYTE g = bpp == 1 ? b : src[1];
+				BYTE r = bpp == 1 ? b : src[2];
+				dst[0] = b;
+				dst[1] = g;
+				dst[2] = r;
+				dst[3] = 0xFF;
+			}
+		}
+	}
+
+	_scaledFrames++;
+	*width = sw;
+	*height = sh;
+	*stride = outStride;
+	return S_OK;
+}
+
+HRESULT WicDecodeContext::DecodePlanar(IWICBitmapFrameDecode* frame, UINT width, UINT height, FrameBuffer& nv12)
+{
+	RETURN_HR_IF_NULL(E_POINTER, frame);
+	wil::com_ptr_nothrow<IWICPlanarBitmapSourceTransform> planar;
+	if (FAILED(frame->QueryInterface(IID_PPV_ARGS(&planar))))
+		return S_FALSE;
+
+	// Y plus interleaved CbCr is NV12 already
+	UINT w = width, h = height;
+	WICPixelFormatGUID formats[2] = { GUID_WICPixelFormat8bppY, GUID_WICPixelFormat16bppCbCr };
+	WICBitmapPlaneDescription planes[2]{};
+	BOOL supported = FALSE;
+	RETURN_IF_FAILED(planar->DoesSupportTransform(&w, &h, WICBitmapTransformRotate0, WICPlanarOptionsDefault, formats, planes, 2, &supported));
+	if (!supported || w != width || h != height || planes[1].Width != width / 2 || planes[1].Height != height / 2)
+		return S_FALSE;
+
+	const size_t lumaSize = (size_t)width * height;
+	RETURN_HR_IF(E_OUTOFMEMORY, !nv12.Resize(lumaSize * 3 / 2));
+	WICBitmapPlane buffers[2] =
+	{
+		{ GUID_WICPixelFormat8bppY, nv12.Data(), width, (UINT)lumaSize },
+		{ GUID_WICPixelFormat16bppCbCr, nv12.Data() + lumaSize, width, (UINT)(lumaSize / 2) },
+	};
+	RETURN_IF_FAILED(planar->CopyPixels(nullptr, width, height, WICBitmapTransformRotate0, WICPlanarOptionsDefault, buffers, 2));
+	_planarFrames++;
+	return S_OK;
+}
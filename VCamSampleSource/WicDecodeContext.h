@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include "FrameBufferPool.h"
+
+// WIC objects for JPEG decoding, one set per decoding thread.
+// The imaging factory is created once per thread and the JPEG decoder is instantiated directly rather than
+// through CreateDecoderFromStream, which probes every registered codec. Stream, decoder and format converter
+// are single-use in WIC (they can only be initialized once), so those are still created per frame; the EXIF
+// metadata reader and the flip-rotator are only created when the JPEG carries an EXIF segment and needs
+// rotating. When the target is smaller than the JPEG, the decoder's own IDCT scaling does most of the
+// downscale. Counters track how many COM objects each frame costs.
+class WicDecodeContext
+{
+	wil::com_ptr_nothrow<IWICImagingFactory> _factory;
+
+	static std::atomic<ULONGLONG> _contexts;
+	static std::atomic<ULONGLONG> _frames;
+	static std::atomic<ULONGLONG> _objects;
+	static std::atomic<ULONGLONG> _scaledFrames;
+	static std::atomic<ULONGLONG> _planarFrames;
+
+	HRESULT ReadOrientation(IWICBitmapFrameDecode* frame, UINT16* orientation);
+
+public:
+	struct Stats
+	{
+		ULONGLONG contexts;  // threads that created a context (one factory each)
+		ULONGLONG frames;
+		ULONGLONG objects;   // COM objects created for frames, excluding the factory
+		ULONGLONG scaledFrames; // decoded with IDCT scaling
+		ULONGLONG planarFrames; // decoded to YCbCr planes
+	};
+
+	// Returns the calling thread's context, creating it on first use; COM must be initialized on the thread
+	static HRESULT ForCurrentThread(WicDecodeContext** context);
+	// Releases the calling thread's context, call before CoUninitialize
+	static void ReleaseForCurrentThread();
+	static Stats GetStats() { return { _contexts.load(), _frames.load(), _objects.load(), _scaledFrames.load(), _planarFrames.load() }; }
+
+	IWICImagingFactory* Factory() const { return _factory.get(); }
+
+	// Opens a JPEG held in memory, orientation is the rotation its EXIF orientation asks for.
+	// The memory must stay valid until the frame is released; pixels are decoded when they are copied.
+	HRESULT OpenFrame(const BYTE* jpeg, size_t size, IWICBitmapFrameDecode** frame, WICBitmapTransformOptions* orientation);
+	// Full size, upright, 32bppPBGRA view of the frame
+	HRESULT Convert(IWICBitmapFrameDecode* frame, WICBitmapTransformOptions orientation, IWICBitmapSource** source);
+	// Decodes with the JPEG's IDCT scaling to the smallest 1/2, 1/4 or 1/8 size that still covers the target,
+	// as opaque 32bpp BGRA. Returns S_FALSE, leaving bgra alone, when no such scale exists.
+	HRESULT DecodeScaled(IWICBitmapFrameDecode* frame, UINT targetWidth, UINT targetHeight, FrameBuffer& bgra, UINT* width, UINT* height, UINT* stride);
+	// Copies the decoder's own 4:2:0 planes as NV12 layout (full range, stride = width) at exactly width x height.
+	// Returns S_FALSE when the JPEG isn't 4:2:0 or no IDCT scale gives that size.
+	HRESULT DecodePlanar(IWICBitmapFrameDecode* frame, UINT width, UINT height, FrameBuffer& nv12);
+};
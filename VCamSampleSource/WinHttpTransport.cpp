@@ -0,0 +1,509 @@
+#include "pch.h"
+#include "Tools.h"
+#include "WinHttpTransport.h"
+
+static const wchar_t* UserAgent = L"WinCamHTTP/1.0";
+
+static std::string QueryContentType(HINTERNET request)
+{
+	WCHAR contentType[512]{};
+	DWORD size = sizeof(contentType);
+	if (!WinHttpQueryHeaders(request, WINHTTP_QUERY_CONTENT_TYPE, WINHTTP_HEADER_NAME_BY_INDEX, contentType, &size, WINHTTP_NO_HEADER_INDEX))
+		return std::string();
+
+	return to_string(contentType);
+}
+
+static DWORD QueryStatusCode(HINTERNET request)
+{
+	DWORD statusCode = 0;
+	DWORD size = sizeof(statusCode);
+	if (!WinHttpQueryHeaders(request, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX, &statusCode, &size, WINHTTP_NO_HEADER_INDEX))
+		return 0;
+
+	return statusCode;
+}
+
+std::unique_ptr<MjpegTransport> MjpegTransport::Create(bool async)
+{
+	if (async)
+		return std::make_unique<WinHttpAsyncTransport>();
+
+	return std::make_unique<WinHttpSyncTransport>();
+}
+
+// --- blocking transport ---
+
+HRESULT WinHttpSyncTransport::Start(const MjpegEndpoint& endpoint, MjpegTransportSink* sink)
+{
+	RETURN_HR_IF_NULL(E_POINTER, sink);
+	RETURN_HR_IF(E_UNEXPECTED, _thread.joinable());
+	_endpoint = endpoint;
+	_sink = sink;
+	RETURN_IF_FAILED(_stop.create(wil::EventOptions::ManualReset));
+	try
+	{
+		_thread = std::thread([this]() { Loop(); });
+		WINTRACE(L"MJPEG: sync transport thread started");
+		return S_OK;
+	}
+	catch (...)
+	{
+		WINTRACE(L"MJPEG: failed to start sync transport thread");
+		return E_FAIL;
+	}
+}
+
+void WinHttpSyncTransport::Stop()
+{
+	if (_thread.joinable())
+	{
+		_stop.SetEvent();
+		_thread.join();
+	}
+
+	CloseRequest();
+	if (_hConnect) { WinHttpCloseHandle(_hConnect); _hConnect = nullptr; }
+	if (_hSession) { WinHttpCloseHandle(_hSession); _hSession = nullptr; }
+}
+
+void WinHttpSyncTransport::CloseRequest()
+{
+	if (_hRequest) { WinHttpCloseHandle(_hRequest); _hRequest = nullptr; }
+}
+
+HRESULT WinHttpSyncTransport::EnsureRequest()
+{
+	if (_hRequest)
+		return S_OK;
+
+	if (!_hSession)
+	{
+		_hSession = WinHttpOpen(UserAgent, WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+		if (!_hSession) { auto err = HRESULT_FROM_WIN32(GetLastError()); WINTRACE(L"WinHttpOpen failed 0x%08X", err); return err; }
+	}
+	if (!_hConnect)
+	{
+		_hConnect = WinHttpConnect(_hSession, _endpoint.host.c_str(), _endpoint.port, 0);
+		if (!_hConnect) { auto err = HRESULT_FROM_WIN32(GetLastError()); WINTRACE(L"WinHttpConnect failed 0x%08X host:%s port:%u", err, _endpoint.host.c_str(), _endpoint.port); return err; }
+	}
+
+	DWORD flags = _endpoint.https ? WINHTTP_FLAG_SECURE : 0;
+	_hRequest = WinHttpOpenRequest(_hConnect, L"GET", _endpoint.path.c_str(), nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
+	if (!_hRequest) { auto err = HRESULT_FROM_WIN32(GetLastError()); WINTRACE(L"WinHttpOpenRequest failed 0x%08X", err); return err; }
+	WINTRACE(L"MJPEG: sending request to %s:%u%s", _endpoint.host.c_str(), _endpoint.port, _endpoint.path.c_str());
+	_requestStart = MFGetSystemTime();
+	if (!WinHttpSendRequest(_hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0, WINHTTP_NO_REQUEST_DATA, 0, 0, 0))
+	{
+		auto le = GetLastError(); auto err = HRESULT_FROM_WIN32(le);
+		WINTRACE(L"WinHttpSendRequest failed 0x%08X (%u)", err, le);
+		CloseRequest();
+		return err;
+	}
+	if (!WinHttpReceiveResponse(_hRequest, nullptr))
+	{
+		auto le = GetLastError(); auto err = HRESULT_FROM_WIN32(le);
+		WINTRACE(L"WinHttpReceiveResponse failed 0x%08X (%u)", err, le);
+		CloseRequest();
+		return err;
+	}
+
+	// the backoff only starts over once the response delivers a frame, see Read
+	_statusCode = QueryStatusCode(_hRequest);
+	_frameReceived = false;
+	WINTRACE(L"MJPEG: response received. HTTP %u", _statusCode);
+	_sink->OnResponse(_statusCode, QueryContentType(_hRequest));
+	return S_OK;
+}
+
+HRESULT WinHttpSyncTransport::Read()
+{
+	// this is where the thread waits for the camera
+	DWORD dwSize = 0;
+	auto start = MFGetSystemTime();
+	auto ok = WinHttpQueryDataAvailable(_hRequest, &dwSize);
+	AddWait(MFGetSystemTime() - start);
+	if (!ok)
+	{
+		auto err = HRESULT_FROM_WIN32(GetLastError());
+		WINTRACE(L"MJPEG: WinHttpQueryDataAvailable failed 0x%08X", err);
+		return err;
+	}
+
+	if (dwSize == 0)
+	{
+		// Connection closed (or snapshot complete); reopen request to continue, unless it failed: then Loop backs off
+		auto hr = ResponseResult(_statusCode, _frameReceived);
+		if (FAILED(hr))
+		{
+			WINTRACE(L"MJPEG: response ended without a frame (HTTP %u), backing off", _statusCode);
+			return hr;
+		}
+
+		// the response was read to the end, so closing the request hands the connection back for reuse
+		WINTRACE(L"MJPEG: data available size=0, reopening request");
+		_reconnects++;
+		CloseRequest();
+
+		auto delay = PollDelay(_endpoint, _requestStart);
+		if (delay)
+		{
+			start = MFGetSystemTime();
+			_stop.wait(delay);
+			AddWait(MFGetSystemTime() - start);
+		}
+		return S_OK;
+	}
+
+	// read straight into the sink's buffer
+	dwSize = std::min<DWORD>(dwSize, ReadSize);
+	auto dest = _sink->GetReadBuffer(dwSize);
+	DWORD dwRead = 0;
+	if (!WinHttpReadData(_hRequest, dest, dwSize, &dwRead))
+	{
+		auto err = HRESULT_FROM_WIN32(GetLastError());
+		WINTRACE(L"MJPEG: WinHttpReadData failed 0x%08X", err);
+		return err;
+	}
+	if (_sink->OnData(dwRead) && IsSuccess(_statusCode))
+	{
+		_frameReceived = true;
+		_backoff.Reset();
+	}
+	return S_OK;
+}
+
+void WinHttpSyncTransport::Loop()
+{
+	// Initialize COM on the reader thread for WIC usage
+	HRESULT cohr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	bool needUninit = (cohr == S_OK);
+	WINTRACE(L"MJPEG: sync reader loop starting for %s:%u%s", _endpoint.host.c_str(), _endpoint.port, _endpoint.path.c_str());
+	while (!_stop.is_signaled())
+	{
+		auto hr = EnsureRequest();
+		if (SUCCEEDED(hr))
+		{
+			hr = Read();
+		}
+
+		if (FAILED(hr))
+		{
+			_sink->OnError(hr);
+			CloseRequest();
+			_reconnects++;
+
+			// back off, but leave as soon as Stop is called
+			auto delay = _backoff.Next();
+			WINTRACE(L"MJPEG: reconnecting in %u ms", delay);
+			auto start = MFGetSystemTime();
+			auto stopped = _stop.wait(delay);
+			AddWait(MFGetSystemTime() - start);
+			if (stopped)
+				break;
+		}
+	}
+	WINTRACE(L"MJPEG: sync reader loop stopped.");
+	if (needUninit)
+	{
+		CoUninitialize();
+	}
+}
+
+// --- asynchronous transport ---
+
+HRESULT WinHttpAsyncTransport::Start(const MjpegEndpoint& endpoint, MjpegTransportSink* sink)
+{
+	RETURN_HR_IF_NULL(E_POINTER, sink);
+	RETURN_HR_IF(E_UNEXPECTED, _hSession != nullptr);
+	_endpoint = endpoint;
+	_sink = sink;
+	_stopping = false;
+
+	RETURN_IF_FAILED(_idle.create(wil::EventOptions::ManualReset | wil::EventOptions::Signaled));
+	_reconnectTimer = CreateThreadpoolTimer(ReconnectCallback, this, nullptr);
+	RETURN_LAST_ERROR_IF_NULL(_reconnectTimer);
+	_readWork = CreateThreadpoolWork(ReadCallback, this, nullptr);
+	RETURN_LAST_ERROR_IF_NULL(_readWork);
+
+	_hSession = WinHttpOpen(UserAgent, WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, WINHTTP_FLAG_ASYNC);
+	if (!_hSession) { auto err = HRESULT_FROM_WIN32(GetLastError()); WINTRACE(L"WinHttpOpen(async) failed 0x%08X", err); return err; }
+
+	// child handles inherit the callback
+	if (WinHttpSetStatusCallback(_hSession, StatusCallback, WINHTTP_CALLBACK_FLAG_ALL_COMPLETIONS | WINHTTP_CALLBACK_FLAG_HANDLES, 0) == WINHTTP_INVALID_STATUS_CALLBACK)
+	{
+		auto err = HRESULT_FROM_WIN32(GetLastError());
+		WINTRACE(L"WinHttpSetStatusCallback failed 0x%08X", err);
+		return err;
+	}
+
+	_hConnect = WinHttpConnect(_hSession, _endpoint.host.c_str(), _endpoint.port, 0);
+	if (!_hConnect) { auto err = HRESULT_FROM_WIN32(GetLastError()); WINTRACE(L"WinHttpConnect failed 0x%08X host:%s port:%u", err, _endpoint.host.c_str(), _endpoint.port); return err; }
+
+	WINTRACE(L"MJPEG: async transport starting for %s:%u%s", _endpoint.host.c_str(), _endpoint.port, _endpoint.path.c_str());
+	Connect();
+	return S_OK;
+}
+
+void WinHttpAsyncTransport::Stop()
+{
+	HINTERNET request = nullptr;
+	{
+		winrt::slim_lock_guard lock(_lock);
+		_stopping = true;
+		request = _hRequest;
+		_hRequest = nullptr;
+	}
+
+	// closing cancels any pending operation, WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING comes last and sets _idle
+	if (request)
+	{
+		WinHttpCloseHandle(request);
+	}
+
+	if (_reconnectTimer)
+	{
+		SetThreadpoolTimer(_reconnectTimer, nullptr, 0, 0);
+		WaitForThreadpoolTimerCallbacks(_reconnectTimer, TRUE);
+		CloseThreadpoolTimer(_reconnectTimer);
+		_reconnectTimer = nullptr;
+	}
+
+	if (_readWork)
+	{
+		WaitForThreadpoolWorkCallbacks(_readWork, TRUE);
+		CloseThreadpoolWork(_readWork);
+		_readWork = nullptr;
+	}
+
+	if (_idle)
+	{
+		_idle.wait();
+	}
+
+	if (_hConnect) { WinHttpCloseHandle(_hConnect); _hConnect = nullptr; }
+	if (_hSession)
+	{
+		WinHttpSetStatusCallback(_hSession, nullptr, WINHTTP_CALLBACK_FLAG_ALL_NOTIFICATIONS, 0);
+		WinHttpCloseHandle(_hSession);
+		_hSession = nullptr;
+	}
+}
+
+void WinHttpAsyncTransport::ScheduleReconnect(DWORD delayMs)
+{
+	_reconnectScheduled = MFGetSystemTime();
+	// relative due time in 100ns units
+	ULARGE_INTEGER due{};
+	due.QuadPart = (ULONGLONG)(-((LONGLONG)delayMs * 10000));
+	FILETIME ft{};
+	ft.dwLowDateTime = due.LowPart;
+	ft.dwHighDateTime = due.HighPart;
+	SetThreadpoolTimer(_reconnectTimer, &ft, 0, 0);
+}
+
+void WinHttpAsyncTransport::Connect()
+{
+	HINTERNET request = nullptr;
+	{
+		winrt::slim_lock_guard lock(_lock);
+		if (_stopping)
+			return;
+
+		DWORD flags = _endpoint.https ? WINHTTP_FLAG_SECURE : 0;
+		request = WinHttpOpenRequest(_hConnect, L"GET", _endpoint.path.c_str(), nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
+		if (!request)
+		{
+			WINTRACE(L"WinHttpOpenRequest failed 0x%08X", HRESULT_FROM_WIN32(GetLastError()));
+			ScheduleReconnect(_backoff.Next());
+			return;
+		}
+
+		DWORD_PTR context = (DWORD_PTR)this;
+		WinHttpSetOption(request, WINHTTP_OPTION_CONTEXT_VALUE, &context, sizeof(context));
+		_hRequest = request;
+		_requestStart = MFGetSystemTime();
+		_statusCode = 0;
+		_frameReceived = false;
+		_idle.ResetEvent();
+	}
+
+	WINTRACE(L"MJPEG: sending async request to %s:%u%s", _endpoint.host.c_str(), _endpoint.port, _endpoint.path.c_str());
+	if (!WinHttpSendRequest(request, WINHTTP_NO_ADDITIONAL_HEADERS, 0, WINHTTP_NO_REQUEST_DATA, 0, 0, (DWORD_PTR)this))
+	{
+		Fail(request, HRESULT_FROM_WIN32(GetLastError()));
+	}
+}
+
+void WinHttpAsyncTransport::Read(HINTERNET request)
+{
+	{
+		winrt::slim_lock_guard lock(_lock);
+		if (_stopping || request != _hRequest)
+			return;
+	}
+
+	// with an async handle the read always completes through WINHTTP_CALLBACK_STATUS_READ_COMPLETE
+	auto dest = _sink->GetReadBuffer(ReadSize);
+	if (!WinHttpReadData(request, dest, ReadSize, nullptr))
+	{
+		Fail(request, HRESULT_FROM_WIN32(GetLastError()));
+	}
+}
+
+void WinHttpAsyncTransport::Fail(HINTERNET request, HRESULT hr)
+{
+	{
+		winrt::slim_lock_guard lock(_lock);
+		if (_stopping)
+			return;
+	}
+
+	WINTRACE(L"MJPEG: async request failed 0x%08X", hr);
+	_sink->OnError(hr);
+	CloseRequest(request, true);
+}
+
+void WinHttpAsyncTransport::CloseRequest(HINTERNET request, bool failed)
+{
+	{
+		winrt::slim_lock_guard lock(_lock);
+		if (request != _hRequest)
+			return; // already closed by Stop
+
+		_hRequest = nullptr;
+		_reconnectDelayMs = failed ? _backoff.Next() : PollDelay(_endpoint, _requestStart);
+	}
+	_reconnects++;
+	WinHttpCloseHandle(request);
+}
+
+void CALLBACK WinHttpAsyncTransport::StatusCallback(HINTERNET handle, DWORD_PTR context, DWORD status, LPVOID info, DWORD infoLength)
+{
+	// only request handles carry a context
+	if (!context)
+		return;
+
+	reinterpret_cast<WinHttpAsyncTransport*>(context)->OnStatus(handle, status, info, infoLength);
+}
+
+void CALLBACK WinHttpAsyncTransport::ReconnectCallback(PTP_CALLBACK_INSTANCE /*instance*/, PVOID context, PTP_TIMER /*timer*/)
+{
+	auto self = reinterpret_cast<WinHttpAsyncTransport*>(context);
+	MFTIME scheduled;
+	{
+		winrt::slim_lock_guard lock(self->_lock);
+		scheduled = self->_reconnectScheduled;
+	}
+	self->AddWait(MFGetSystemTime() - scheduled);
+	self->Connect();
+}
+
+void CALLBACK WinHttpAsyncTransport::ReadCallback(PTP_CALLBACK_INSTANCE /*instance*/, PVOID context, PTP_WORK /*work*/)
+{
+	auto self = reinterpret_cast<WinHttpAsyncTransport*>(context);
+	HINTERNET request = nullptr;
+	{
+		winrt::slim_lock_guard lock(self->_lock);
+		request = self->_hRequest;
+	}
+
+	if (request)
+	{
+		self->Read(request);
+	}
+}
+
+void WinHttpAsyncTransport::OnStatus(HINTERNET request, DWORD status, LPVOID info, DWORD infoLength)
+{
+	// a read that completes inline calls us back from inside WinHttpReadData, so count the nesting and
+	// continue on the threadpool once it gets deep instead of growing the stack with every buffered chunk
+	static thread_local int depth = 0;
+
+	switch (status)
+	{
+	case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
+		if (!WinHttpReceiveResponse(request, nullptr))
+		{
+			Fail(request, HRESULT_FROM_WIN32(GetLastError()));
+		}
+		break;
+
+	case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE:
+	{
+		// the backoff only starts over once the response delivers a frame
+		auto statusCode = QueryStatusCode(request);
+		WINTRACE(L"MJPEG: async response received. HTTP %u", statusCode);
+		{
+			winrt::slim_lock_guard lock(_lock);
+			_statusCode = statusCode;
+			_frameReceived = false;
+		}
+		_sink->OnResponse(statusCode, QueryContentType(request));
+		Read(request);
+		break;
+	}
+
+	case WINHTTP_CALLBACK_STATUS_READ_COMPLETE:
+		if (!infoLength)
+		{
+			// end of response, reopen right away (or at the next poll time for snapshots)
+			// while the frame just received is still decoding on the scheduler; back off if it failed
+			HRESULT hr;
+			{
+				winrt::slim_lock_guard lock(_lock);
+				hr = ResponseResult(_statusCode, _frameReceived);
+			}
+
+			if (FAILED(hr))
+			{
+				WINTRACE(L"MJPEG: async response ended without a frame, backing off");
+				Fail(request, hr);
+				break;
+			}
+
+			WINTRACE(L"MJPEG: async response ended, reopening request");
+			CloseRequest(request, false);
+			break;
+		}
+
+		if (_sink->OnData(infoLength))
+		{
+			winrt::slim_lock_guard lock(_lock);
+			if (IsSuccess(_statusCode))
+			{
+				_frameReceived = true;
+				_backoff.Reset();
+			}
+		}
+		if (depth >= 4)
+		{
+			SubmitThreadpoolWork(_readWork);
+			break;
+		}
+
+		depth++;
+		Read(request);
+		depth--;
+		break;
+
+	case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR:
+	{
+		auto result = (WINHTTP_ASYNC_RESULT*)info;
+		Fail(request, HRESULT_FROM_WIN32(result ? result->dwError : ERROR_WINHTTP_INTERNAL_ERROR));
+		break;
+	}
+
+	case WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING:
+	{
+		// last notification for this request
+		winrt::slim_lock_guard lock(_lock);
+		if (!_stopping)
+		{
+			ScheduleReconnect(_reconnectDelayMs);
+		}
+		_idle.SetEvent();
+		break;
+	}
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <thread>
+#include <winhttp.h>
+#include "MjpegTransport.h"
+
+// Blocking WinHTTP reads on a dedicated thread per stream. The thread only ever blocks in WinHTTP waiting
+// for data, or on the stop event during a reconnect backoff.
+class WinHttpSyncTransport : public MjpegTransport
+{
+	MjpegEndpoint _endpoint;
+	MjpegTransportSink* _sink = nullptr;
+	HINTERNET _hSession = nullptr;
+	HINTERNET _hConnect = nullptr;
+	HINTERNET _hRequest = nullptr;
+	MFTIME _requestStart = 0;
+	DWORD _statusCode = 0;       // of the current response
+	bool _frameReceived = false; // the current response delivered a frame
+	std::thread _thread;
+	wil::unique_event_nothrow _stop;
+	ReconnectBackoff _backoff;
+
+	HRESULT EnsureRequest();
+	HRESULT Read();
+	void CloseRequest();
+	void Loop();
+
+public:
+	~WinHttpSyncTransport() { Stop(); }
+
+	HRESULT Start(const MjpegEndpoint& endpoint, MjpegTransportSink* sink) override;
+	void Stop() override;
+};
+
+// WinHTTP in asynchronous mode: no thread of our own, every step completes on a WinHTTP callback and
+// the next one is issued from there. One request is alive at a time; when it ends or fails it is closed
+// and a threadpool timer opens the next one.
+class WinHttpAsyncTransport : public MjpegTransport
+{
+	MjpegEndpoint _endpoint;
+	MjpegTransportSink* _sink = nullptr;
+	HINTERNET _hSession = nullptr;
+	HINTERNET _hConnect = nullptr;
+	HINTERNET _hRequest = nullptr;  // request alive, guarded by _lock
+	winrt::slim_mutex _lock;
+	bool _stopping = false;
+	DWORD _reconnectDelayMs = 0;    // delay before the next request once the current one is closed
+	MFTIME _reconnectScheduled = 0;
+	MFTIME _requestStart = 0;
+	DWORD _statusCode = 0;          // of the current response, guarded by _lock
+	bool _frameReceived = false;    // the current response delivered a frame, guarded by _lock
+	ReconnectBackoff _backoff;      // guarded by _lock
+	wil::unique_event_nothrow _idle; // set when no request handle is alive
+	PTP_TIMER _reconnectTimer = nullptr;
+	PTP_WORK _readWork = nullptr;
+
+	static void CALLBACK StatusCallback(HINTERNET handle, DWORD_PTR context, DWORD status, LPVOID info, DWORD infoLength);
+	static void CALLBACK ReconnectCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer);
+	static void CALLBACK ReadCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WORK work);
+
+	void OnStatus(HINTERNET request, DWORD status, LPVOID info, DWORD infoLength);
+	void Connect();
+	void Read(HINTERNET request);
+	void Fail(HINTERNET request, HRESULT hr);
+	void CloseRequest(HINTERNET request, bool failed);
+	void ScheduleReconnect(DWORD delayMs);
+
+public:
+	~WinHttpAsyncTransport() { Stop(); }
+
+	HRESULT Start(const MjpegEndpoint& endpoint, MjpegTransportSink* sink) override;
+	void Stop() override;
+};
@@ -1,6 +1,11 @@
 #ifndef PCH_H
 #define PCH_H
 
+#ifdef PORTABLE_TESTS
+// the platform independent sources are also built on their own for the unit tests, see Tests/CMakeLists.txt at the repository root
+#include "PortablePch.h"
+#else
 #include "framework.h"
+#endif
 
 #endif //PCH_H